@@ -0,0 +1,199 @@
+#include "DatabaseWorker.h"
+#include "util/util.h" // For logging
+
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <exception>
+#include <vector>
+
+namespace nucare {
+
+namespace {
+// A batch whose transaction can't start or commit (busy past the timeout, I/O error) is rolled back
+// and run again, its jobs only fail after the last attempt
+const int COMMIT_ATTEMPTS           = 3;
+const unsigned long COMMIT_RETRY_MS = 200;
+} // namespace
+
+DatabaseWorker::DatabaseWorker(const QString& name, Access access, QObject *parent)
+    : QObject(parent), Component(name), m_connectionName("NDT_DB_" + name), m_access(access), m_pending(0)
+{
+}
+
+DatabaseWorker::~DatabaseWorker()
+{
+    if (m_database.isOpen()) {
+        logW() << "Worker deleted while its connection is open";
+    }
+}
+
+bool DatabaseWorker::open(const QString& path, const std::function<void(QSqlDatabase&)>& configure)
+{
+    m_database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    m_database.setDatabaseName(path);
+    // The other connections may hold the lock for a moment, wait instead of failing the batch
+    m_database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+    if (!m_database.open()) {
+        logE() << "Failed to open connection:" << m_database.lastError().text();
+        return false;
+    }
+    if (configure) configure(m_database);
+    m_statements.setDatabase(m_database);
+
+    logI() << "Connection opened at" << path;
+    return true;
+}
+
+void DatabaseWorker::close()
+{
+    drain();
+
+    if (!m_database.isValid()) return;
+    m_statements.setDatabase(QSqlDatabase()); // Finalizes the cached statements
+    m_database.close();
+    m_database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(m_connectionName);
+    logI() << "Connection closed.";
+}
+
+std::shared_future<qlonglong> DatabaseWorker::enqueue(Job job, QObject* context, Callback done, Callback committed)
+{
+    Request req;
+    req.job        = std::move(job);
+    req.context    = context;
+    req.hasContext = context != nullptr;
+    req.done       = std::move(done);
+    req.committed  = std::move(committed);
+    auto future    = req.result.get_future().share();
+
+    m_pending.fetch_add(1, std::memory_order_release);
+
+    bool schedule;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(std::move(req));
+        schedule    = !m_scheduled;
+        m_scheduled = true;
+    }
+
+    if (schedule) {
+        QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::QueuedConnection);
+    }
+    return future;
+}
+
+void DatabaseWorker::flush()
+{
+    if (QThread::currentThread() == thread()) {
+        drain();
+    } else if (pending() > 0) {
+        QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::BlockingQueuedConnection);
+    }
+}
+
+bool DatabaseWorker::execute(const char* sql)
+{
+    auto query = m_statements.prepare(sql);
+    if (!query->exec()) {
+        logE() << sql << "failed:" << query->lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseWorker::runBatch(std::deque<Request>& batch, std::vector<qlonglong>& ids)
+{
+    // IMMEDIATE takes the write lock up front: contention fails here, before any job ran, and the
+    // batch is retried. A deferred BEGIN would fail the first INSERT of a job instead
+    if (!execute(m_access == Write ? "BEGIN IMMEDIATE" : "BEGIN")) return false;
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        // Each job in its own savepoint, a failed one is undone alone and the rest of the batch commits
+        if (!execute("SAVEPOINT job")) {
+            execute("ROLLBACK");
+            return false;
+        }
+
+        qlonglong id = -1;
+        try {
+            id = batch[i].job(m_statements);
+        } catch (const std::exception& e) {
+            logE() << "Job failed:" << e.what();
+        }
+
+        if (id < 0 && !execute("ROLLBACK TO job")) {
+            execute("ROLLBACK");
+            return false;
+        }
+        if (!execute("RELEASE job")) {
+            execute("ROLLBACK");
+            return false;
+        }
+        ids[i] = id;
+    }
+
+    if (!execute("COMMIT")) {
+        logE() << "Committing" << batch.size() << "jobs failed";
+        execute("ROLLBACK");
+        return false;
+    }
+
+    logD() << "Committed" << batch.size() << "jobs";
+    return true;
+}
+
+void DatabaseWorker::drain()
+{
+    std::vector<qlonglong> ids;
+
+    while (true) {
+        std::deque<Request> batch;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            batch.swap(m_queue);
+            if (batch.empty()) {
+                m_scheduled = false;
+                return;
+            }
+        }
+
+        const bool isOpen = m_database.isOpen();
+        if (!isOpen) {
+            logE() << "Dropping" << batch.size() << "jobs, the connection is not open";
+        }
+
+        ids.assign(batch.size(), -1);
+        for (int attempt = 1; isOpen && attempt <= COMMIT_ATTEMPTS; attempt++) {
+            if (runBatch(batch, ids)) break;
+
+            ids.assign(batch.size(), -1);
+            if (attempt < COMMIT_ATTEMPTS) {
+                logW() << "Retrying" << batch.size() << "jobs, attempt" << attempt + 1 << "of" << COMMIT_ATTEMPTS;
+                QThread::msleep(COMMIT_RETRY_MS * attempt);
+            } else {
+                logE() << "Giving up on" << batch.size() << "jobs after" << COMMIT_ATTEMPTS << "attempts";
+            }
+        }
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            Request& req       = batch[i];
+            const qlonglong id = ids[i];
+            if (req.committed) req.committed(id);
+            req.result.set_value(id);
+
+            if (req.done) {
+                if (!req.hasContext) {
+                    req.done(id);
+                } else if (req.context) {
+                    auto done = std::move(req.done);
+                    QMetaObject::invokeMethod(req.context, [done, id]() { done(id); }, Qt::QueuedConnection);
+                }
+            }
+            m_pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+} // namespace nucare
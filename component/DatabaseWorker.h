@@ -0,0 +1,93 @@
+#ifndef DATABASEWORKER_H
+#define DATABASEWORKER_H
+
+#include "component/component.h"
+#include "component/SqlStatementCache.h"
+#include <QObject>
+#include <QPointer>
+#include <QSqlDatabase>
+#include <QString>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+
+namespace nucare {
+
+/**
+ * Background connection of DatabaseManager, used for the write-behind queue and for prefetching
+ * reads. Lives on its own thread with its own SQLite connection, jobs are queued from any thread and
+ * run in order. Everything queued while a batch runs goes into the next one, so a burst of writes
+ * costs one transaction and one fsync.
+ */
+class DatabaseWorker : public QObject, public Component
+{
+    Q_OBJECT
+public:
+    // Runs on the worker thread inside the batch transaction, returns the new row id (or a count), -1 on
+    // failure. The writes of a failed job are rolled back, the other jobs of the batch still commit
+    typedef std::function<qlonglong(SqlStatementCache&)> Job;
+    typedef std::function<void(qlonglong)> Callback;
+
+    // Write batches take the database write lock when they start, Read ones only a snapshot
+    enum Access { Write, Read };
+
+    // name is the log tag and names the connection
+    explicit DatabaseWorker(const QString& name, Access access = Write, QObject *parent = nullptr);
+    ~DatabaseWorker();
+
+    // Must be called on the worker thread, configure runs on the new connection
+    bool open(const QString& path, const std::function<void(QSqlDatabase&)>& configure);
+    void close();
+
+    /**
+     * Queue a job, safe from any thread.
+     * @param context done runs on the thread of context and is skipped if context is deleted first,
+     *                without a context it runs on the worker thread
+     * @param done Optional, called with the row id (-1 on failure) after the batch is committed
+     * @param committed Optional, same as done but always on the worker thread, in queue order and
+     *                  before the future is ready
+     */
+    std::shared_future<qlonglong> enqueue(Job job, QObject* context = nullptr, Callback done = Callback(),
+                                          Callback committed = Callback());
+
+    // Block until every job queued before has been committed
+    void flush();
+
+    // Jobs queued and not committed yet
+    int pending() const { return m_pending.load(std::memory_order_acquire); }
+
+private:
+    struct Request {
+        Job job;
+        std::promise<qlonglong> result;
+        QPointer<QObject> context;
+        bool hasContext = false;
+        Callback done;
+        Callback committed;
+    };
+
+    QSqlDatabase m_database;
+    SqlStatementCache m_statements;
+    QString m_connectionName;
+    Access m_access;
+
+    mutable std::mutex m_mutex;
+    std::deque<Request> m_queue;
+    bool m_scheduled = false;
+    std::atomic<int> m_pending;
+
+    // Write everything queued so far, one transaction per batch
+    void drain();
+    // Run sql on the connection, logs the error
+    bool execute(const char* sql);
+    // Run the jobs of batch in one transaction, a failed job (-1 or throwing) is rolled back alone.
+    // False if the transaction couldn't start or commit, nothing of the batch is written then
+    bool runBatch(std::deque<Request>& batch, std::vector<qlonglong>& ids);
+};
+
+} // namespace nucare
+
+#endif // DATABASEWORKER_H
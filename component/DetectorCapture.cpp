@@ -0,0 +1,86 @@
+#include "DetectorCapture.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace nucare {
+namespace capture {
+
+namespace {
+constexpr int HEADER_SIZE = sizeof(MAGIC) + sizeof(quint16);
+constexpr int RECORD_HEADER_SIZE = sizeof(quint64) + sizeof(quint32);
+} // namespace
+
+bool Writer::open(const QString& path)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    char header[HEADER_SIZE];
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    qToLittleEndian<quint16>(VERSION, header + sizeof(MAGIC));
+    m_file.write(header, sizeof(header));
+
+    m_clock.start();
+    return true;
+}
+
+void Writer::close()
+{
+    if (m_file.isOpen()) {
+        m_file.flush();
+        m_file.close();
+    }
+}
+
+void Writer::write(const char* data, qint64 size)
+{
+    if (!m_file.isOpen() || size <= 0) return;
+
+    char header[RECORD_HEADER_SIZE];
+    qToLittleEndian<quint64>(m_clock.nsecsElapsed() / 1000, header);
+    qToLittleEndian<quint32>(size, header + sizeof(quint64));
+    m_file.write(header, sizeof(header));
+    m_file.write(data, size);
+}
+
+bool Reader::open(const QString& path)
+{
+    m_error.clear();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    char header[HEADER_SIZE];
+    if (m_file.read(header, sizeof(header)) != sizeof(header) || memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+        m_error = "Not a detector capture file";
+        m_file.close();
+        return false;
+    }
+
+    auto version = qFromLittleEndian<quint16>(header + sizeof(MAGIC));
+    if (version != VERSION) {
+        m_error = QString("Unsupported capture version %1").arg(version);
+        m_file.close();
+        return false;
+    }
+
+    return true;
+}
+
+bool Reader::next(Record& record)
+{
+    char header[RECORD_HEADER_SIZE];
+    if (m_file.read(header, sizeof(header)) != sizeof(header)) return false;
+
+    record.timestampUs = qFromLittleEndian<quint64>(header);
+    auto size          = qFromLittleEndian<quint32>(header + sizeof(quint64));
+    record.data.resize(size);
+    return m_file.read(record.data.data(), size) == size;
+}
+
+} // namespace capture
+} // namespace nucare
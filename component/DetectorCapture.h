@@ -0,0 +1,67 @@
+#ifndef DETECTORCAPTURE_H
+#define DETECTORCAPTURE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+namespace nucare {
+
+/**
+ * Raw serial stream capture file.
+ *
+ * Layout, all integers little endian:
+ *   header  : "NDTCAP" magic, uint16 version
+ *   record* : uint64 microseconds since capture start, uint32 length, length bytes
+ */
+namespace capture {
+
+constexpr char MAGIC[6] = {'N', 'D', 'T', 'C', 'A', 'P'};
+constexpr quint16 VERSION = 1;
+
+class Writer
+{
+public:
+    Writer() = default;
+    ~Writer() { close(); }
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString errorString() const { return m_file.errorString(); }
+
+    void write(const char* data, qint64 size);
+
+private:
+    QFile m_file;
+    QElapsedTimer m_clock;
+};
+
+class Reader
+{
+public:
+    struct Record {
+        quint64 timestampUs = 0;
+        QByteArray data;
+    };
+
+    Reader() = default;
+
+    bool open(const QString& path);
+    void close() { m_file.close(); }
+    bool isOpen() const { return m_file.isOpen(); }
+    QString errorString() const { return m_error.isEmpty() ? m_file.errorString() : m_error; }
+
+    // Read the next record, false at the end of the file or on a truncated record
+    bool next(Record& record);
+
+private:
+    QFile m_file;
+    QString m_error;
+};
+
+} // namespace capture
+} // namespace nucare
+
+#endif // DETECTORCAPTURE_H
@@ -0,0 +1,475 @@
+#include "DetectorIoWorker.h"
+#include "DetectorProtocol.h"
+#include "PackageFramer.h"
+#include "util/util.h" // For logging
+#include "util/SpectrumKernels.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+using namespace std;
+
+namespace nucare {
+
+namespace {
+
+void detector_raw_package_convert(const Package::Payload* pkg, DetectorPackage* ret) {
+    auto payload = reinterpret_cast<const Package::Payload*>(pkg);
+
+    //read realtime
+    ret->realtime = be64toh(payload->realtime << 16) * 0.00002;
+    double msTime = 1;
+    if(ret->realtime > 1) msTime = ret->realtime;
+
+    // Spectrum: byte-swap, scale and clamp in a single vectorized pass, keeping the integer counts too
+    auto channels = reinterpret_cast<const char*>(payload) + offsetof(Package::Payload, spectrum);
+    uint64_t rawSum = 0;
+    ret->spc->updateTotal(kernel::decodeBe16Counts(channels, ret->spc->data(), ret->counts->data(), rawSum,
+                                                   ret->spc->getSize(), msTime, 15000));
+    ret->counts->updateTotal(rawSum);
+
+    ret->neutron = be16toh(payload->neutron);
+    ret->hasNeutron = payload->neutronGmFlag >> 7;
+    ret->hasGM = payload->neutronGmFlag & 0x40;
+
+    ret->pileup = be16toh(payload->pileup);
+    ret->spc->setFillCps(ret->pileup);
+    ret->counts->setFillCps(ret->pileup);
+    ret->detectorInfo = be16toh(payload->detectorCode);
+    ret->hvDac = be16toh(payload->hvDac);
+    ret->gc = be16toh(payload->gc);
+    // GM
+    ret->gm = be16toh(payload->gm);
+
+    ret->temperatureRaw = be16toh(payload->tempOutside);
+//    ret->temperature = (temp * 2.0 / 4096.0 - 0.5) * 100;
+    ret->temperature = (ret->temperatureRaw * 330) / 4096  - 60;
+}
+
+} // namespace
+
+DetectorIoWorker::DetectorIoWorker(QObject *parent)
+    : QObject(parent), Component("DETECTOR_IO"), m_serialPort(new QSerialPort(this)), m_responseTimer(this),
+      m_retryCount(0), m_commandState(Idle), m_notifyPending(false),
+      m_packagePool(8, [](DetectorPackage& pkg) { pkg = DetectorPackage(); }),
+      m_spectrumPool(8, [](HwSpectrum& spc) { spc.reset(); }),
+      m_countPool(8, [](HwCountSpectrum& spc) { spc.reset(); }), m_reportedHighWater(0), m_replayTimer(this)
+{
+    memset(m_packageBuffer, 0, sizeof(m_packageBuffer));
+    // Connect serial port signals
+    connect(m_serialPort, &QSerialPort::readyRead, this, &DetectorIoWorker::readData);
+    connect(m_serialPort, &QSerialPort::errorOccurred, this, &DetectorIoWorker::handleError);
+
+    // Connect timer signal
+    connect(&m_responseTimer, &QTimer::timeout, this, &DetectorIoWorker::handleTimeout);
+    m_responseTimer.setSingleShot(true); // Timer for response timeouts
+
+    connect(&m_replayTimer, &QTimer::timeout, this, &DetectorIoWorker::feedReplay);
+    m_replayTimer.setSingleShot(true);
+
+    logI() << "Spectrum decode kernel:" << kernel::activeIsa();
+}
+
+DetectorIoWorker::~DetectorIoWorker()
+{
+    closeSerialPort();
+}
+
+void DetectorIoWorker::open(const QString& portName)
+{
+    int baudRate = 230400; // TODO: Load from settings
+
+    if (openSerialPort(portName, baudRate)) {
+        logI() << "Serial port" << portName << "opened successfully.";
+        clearSerialBuffer(); // Clear buffer on successful open
+    } else {
+        logE() << "Failed to open serial port" << portName << ":" << m_serialPort->errorString();
+        emit errorOccurred(m_serialPort->errorString());
+    }
+}
+
+void DetectorIoWorker::clearSerialBuffer()
+{
+    if (m_serialPort->isOpen()) {
+        m_serialPort->clear();
+        logI() << "Serial buffer cleared.";
+    }
+}
+
+void DetectorIoWorker::start()
+{
+    startCommandFlow();
+}
+
+void DetectorIoWorker::stop()
+{
+    if (m_replaying) {
+        m_replaying = false;
+        m_replayTimer.stop();
+        m_replay.close();
+    }
+    closeSerialPort();
+    m_responseTimer.stop();
+    m_commandState = Idle;
+    m_readBuffer.clear();
+    m_retryCount = 0;
+}
+
+bool DetectorIoWorker::openSerialPort(const QString &portName, int baudRate)
+{
+    if (m_serialPort->isOpen()) {
+        m_serialPort->close();
+    }
+    m_serialPort->setPortName(portName);
+    m_serialPort->setBaudRate(baudRate);
+    m_serialPort->setDataBits(QSerialPort::Data8);
+    m_serialPort->setParity(QSerialPort::NoParity);
+    m_serialPort->setStopBits(QSerialPort::OneStop);
+    m_serialPort->setFlowControl(QSerialPort::NoFlowControl);
+
+    return m_serialPort->open(QIODevice::ReadWrite);
+}
+
+void DetectorIoWorker::closeSerialPort()
+{
+    if (m_serialPort->isOpen()) {
+        m_serialPort->close();
+        logI() << "Serial port closed.";
+    }
+}
+
+void DetectorIoWorker::sendCommand(const QByteArray &command)
+{
+    if (m_replaying) {
+        // The replayed stream already contains the device responses
+        m_currentCommand = command;
+        return;
+    }
+
+    if (m_serialPort->isOpen()) {
+        nativeSend(command);
+        m_currentCommand = command;
+        m_readBuffer.clear(); // Clear buffer for new response
+        m_responseTimer.start(1000); // Start timeout timer (1 second)
+    } else {
+        logE() << "Cannot send command, serial port not open.";
+        emit errorOccurred("Cannot send command, serial port not open.");
+    }
+}
+
+void DetectorIoWorker::nativeSend(const QByteArray &command)
+{
+    if (m_serialPort->isOpen()) {
+        m_serialPort->write(command);
+        logD() << "Sent command:" << command;
+    }
+}
+
+void DetectorIoWorker::readData()
+{
+    // Read straight into the ring, processing after each chunk to make room for the next one
+    while (m_serialPort->bytesAvailable() > 0) {
+        size_t len = 0;
+        char* dst  = m_readBuffer.writeRegion(len);
+        if (len == 0) {
+            logW() << "Read buffer overflow, dropping" << m_readBuffer.size() << "bytes.";
+            m_readBuffer.clear();
+            continue;
+        }
+
+        auto n = m_serialPort->read(dst, len);
+        if (n <= 0) break;
+
+        m_readBuffer.commit(n);
+        m_capture.write(dst, n);
+        logD() << "Received data. Current buffer size:" << m_readBuffer.size();
+        processReceivedData();
+    }
+}
+
+void DetectorIoWorker::ingest(const char* data, size_t size)
+{
+    while (size > 0) {
+        size_t n = m_readBuffer.write(data, size);
+        if (n == 0) {
+            logW() << "Read buffer overflow, dropping" << m_readBuffer.size() << "bytes.";
+            m_readBuffer.clear();
+            continue;
+        }
+
+        data += n;
+        size -= n;
+        processReceivedData();
+    }
+}
+
+bool DetectorIoWorker::startCapture(const QString& path)
+{
+    if (!m_capture.open(path)) {
+        logE() << "Failed to open capture file" << path << ":" << m_capture.errorString();
+        emit errorOccurred(m_capture.errorString());
+        return false;
+    }
+
+    logI() << "Capturing serial stream to" << path;
+    return true;
+}
+
+void DetectorIoWorker::stopCapture()
+{
+    if (m_capture.isOpen()) {
+        m_capture.close();
+        logI() << "Serial stream capture stopped.";
+    }
+}
+
+void DetectorIoWorker::startReplay(const QString& path, bool realtime)
+{
+    stop();
+
+    if (!m_replay.open(path)) {
+        logE() << "Failed to open capture file" << path << ":" << m_replay.errorString();
+        emit errorOccurred(m_replay.errorString());
+        return;
+    }
+
+    if (!m_replay.next(m_replayRecord)) {
+        logW() << "Capture file" << path << "is empty.";
+        m_replay.close();
+        return;
+    }
+
+    logI() << "Replaying" << path << (realtime ? "at wall-clock speed." : "at maximum speed.");
+    m_replaying           = true;
+    m_replayRealtime      = realtime;
+    m_replayBaseUs        = m_replayRecord.timestampUs;
+    m_replayPushedAtStart = m_queue.pushedCount();
+    m_commandState        = WaitingForInfoResponse;
+    m_replayClock.start();
+    m_replayTimer.start(0);
+}
+
+void DetectorIoWorker::feedReplay()
+{
+    if (!m_replaying) return;
+
+    if (!m_replayRealtime && m_queue.depth() >= PackageQueue::capacity() / 2) {
+        // Let the consumer catch up, a max-speed replay must not drop packages
+        m_replayTimer.start(1);
+        return;
+    }
+
+    ingest(m_replayRecord.data.constData(), m_replayRecord.data.size());
+    if (!m_replay.next(m_replayRecord)) {
+        finishReplay();
+        return;
+    }
+
+    qint64 delayMs = 0;
+    if (m_replayRealtime) {
+        // Schedule against the replay start so rounding does not accumulate
+        delayMs = (qint64) ((m_replayRecord.timestampUs - m_replayBaseUs) / 1000) - m_replayClock.elapsed();
+    }
+    m_replayTimer.start(std::max<qint64>(delayMs, 0));
+}
+
+void DetectorIoWorker::finishReplay()
+{
+    auto elapsed  = m_replayClock.elapsed();
+    auto packages = m_queue.pushedCount() - m_replayPushedAtStart;
+    logI() << "Replay finished:" << packages << "packages decoded in" << elapsed << "ms.";
+
+    m_replaying = false;
+    m_replay.close();
+    m_commandState = Idle;
+    m_readBuffer.clear();
+    emit replayFinished(packages, elapsed);
+}
+
+void DetectorIoWorker::handleTimeout()
+{
+    logW() << "Response timeout for command:" << m_currentCommand;
+    m_retryCount++;
+    if (m_commandState == WaitingForStopResponse) {
+        // For Stop, timeout means success (no data expected)
+        logI() << "Stop command acknowledged by timeout (no data expected).";
+        m_retryCount = 0;
+        sendGetInfoCommand();
+        return;
+    }
+    if (m_retryCount < 3) {
+        logI() << "Retrying command:" << m_currentCommand << "(Attempt" << m_retryCount + 1 << "of 3)";
+        sendCommand(m_currentCommand); // Retry the command
+    } else if (m_commandState == WaitingForInfoResponse) {
+        logE() << "Failed after three times, load last detector info instead";
+        emit infoTimedOut();
+    } else {
+        logE() << "Command failed after 3 retries:" << m_currentCommand;
+        emit errorOccurred("Command failed after 3 retries.");
+        m_commandState = Idle; // Reset state
+        m_retryCount = 0;
+    }
+}
+
+void DetectorIoWorker::handleError(QSerialPort::SerialPortError error)
+{
+    if (error != QSerialPort::NoError) {
+        logE() << "Serial port error:" << m_serialPort->errorString();
+        emit errorOccurred(m_serialPort->errorString());
+    }
+}
+
+void DetectorIoWorker::processReceivedData()
+{
+    // Improved buffer processing: handle partial, multiple, and misaligned messages
+    while (true) {
+        switch (m_commandState) {
+            case WaitingForInfoResponse: {
+                size_t headerIndex = m_readBuffer.find(INFO_HEADER, sizeof(INFO_HEADER));
+                if (headerIndex == m_readBuffer.npos) {
+                    if (m_replaying && m_readBuffer.find(PACKAGE_HEADER, sizeof(PACKAGE_HEADER)) != m_readBuffer.npos) {
+                        // Capture was started after the handshake
+                        logW() << "No detector info in the capture, using the last known detector.";
+                        emit infoTimedOut();
+                        m_commandState = ReceivingPackage;
+                        continue;
+                    }
+                    break;
+                }
+                if (m_readBuffer.size() < headerIndex + sizeof(GcPackage::Payload)) break;
+                m_readBuffer.consume(headerIndex);
+                QByteArray payloadData(sizeof(GcPackage::Payload), Qt::Uninitialized);
+                m_readBuffer.read(payloadData.data(), payloadData.size());
+                emit infoReceived(payloadData);
+                m_responseTimer.stop();
+                m_retryCount = 0;
+                sendStartCommand();
+                continue;
+            }
+            case ReceivingPackage: {
+                framePackages(m_readBuffer, m_packageBuffer,
+                              [this](const char* frame) { return processPackageData(frame, sizeof(Package)); });
+                break;
+            }
+            case WaitingForStopResponse: {
+                // After sending Stop, we expect NO data. Timeout means success.
+                // If any data is received, log a warning and clear it, but do not treat as success.
+                if (!m_readBuffer.isEmpty()) {
+                    logW() << "Unexpected data received after sending Stop command. Clearing buffer.";
+                    m_readBuffer.clear();
+                }
+                // Do not trigger sendGetInfoCommand here; let the timeout handler advance the state.
+                break;
+            }
+            case WaitingForStartResponse: {
+                if (!m_readBuffer.isEmpty()) {
+                    logI() << "Response received after sending Start command. Entering ReceivingPackage state.";
+                    m_responseTimer.stop();
+                    m_retryCount = 0;
+                    m_commandState = ReceivingPackage;
+//                    m_readBuffer.clear();
+                    processReceivedData();  // If received data in start response, forward this buffer for next step
+                }
+                break;
+            }
+            case Idle: {
+                if (!m_readBuffer.isEmpty()) {
+                    logW() << "Received unexpected data in Idle state:" << m_readBuffer.size() << "bytes.";
+                    m_readBuffer.clear();
+                }
+                break;
+            }
+            case SendingStop:
+            case SendingGetInfo:
+            case SendingStart:
+                // Should not process data while just sending, wait for response state.
+                break;
+        }
+        // If we didn't continue, break the loop
+        break;
+    }
+}
+
+bool DetectorIoWorker::processPackageData(const char* data, size_t size)
+{
+    // Process the received package data (4166 bytes)
+    if (size != sizeof(Package::Bytes)) {
+        logW() << "Package data validation failed: Incorrect size (" << size << " bytes, expected" << sizeof(Package::Bytes) << ").";
+        return false;
+    }
+
+    auto rawPackage = reinterpret_cast<const Package::Payload*>(data);
+    // Use constexpr header/tail for fast check
+    bool headerOk = (memcmp(rawPackage->header, PACKAGE_HEADER, 4) == 0);
+    bool tailOk = (memcmp(rawPackage->tail + 18, PACKAGE_TAIL, 2) == 0);
+    if (!headerOk || !tailOk) {
+        logW() << "Package data validation failed: Incorrect header or tail.";
+        return false;
+    }
+
+    auto package = m_packagePool.acquire();
+    package->spc = m_spectrumPool.acquire();
+    package->counts = m_countPool.acquire();
+    detector_raw_package_convert(rawPackage, package.get());
+    publishPackage(std::move(package));
+    reportPoolUsage();
+    return true;
+}
+
+void DetectorIoWorker::reportPoolUsage()
+{
+    auto packages = m_packagePool.stats();
+    if (packages.highWater <= m_reportedHighWater) return;
+
+    m_reportedHighWater = packages.highWater;
+    auto spectra = m_spectrumPool.stats();
+    logI() << "Package pool high-water mark:" << packages.highWater << "(allocated" << packages.created
+           << "packages," << spectra.created << "spectra)";
+}
+
+void DetectorIoWorker::publishPackage(std::shared_ptr<DetectorPackage>&& package)
+{
+    if (!m_queue.tryPush(std::move(package))) {
+        logW() << "Package queue is full, dropped package. Total dropped:" << m_queue.droppedCount();
+    }
+
+    // Coalesce notifications, the consumer drains everything queued when it wakes up
+    if (!m_notifyPending.exchange(true, std::memory_order_acq_rel)) {
+        emit packagesAvailable();
+    }
+}
+
+void DetectorIoWorker::startCommandFlow()
+{
+    if (m_commandState == Idle) {
+        sendStopCommand();
+    } else {
+        logW() << "Command flow already in progress. Current state:" << m_commandState;
+    }
+}
+
+void DetectorIoWorker::sendStopCommand()
+{
+    logI() << "Sending Stop command (A4).";
+    m_commandState = SendingStop;
+    sendCommand("A4");
+    m_commandState = WaitingForStopResponse;
+}
+
+void DetectorIoWorker::sendGetInfoCommand()
+{
+    logI() << "Sending Get Info command (GS).";
+    m_commandState = SendingGetInfo;
+    sendCommand("GS");
+    m_commandState = WaitingForInfoResponse;
+}
+
+void DetectorIoWorker::sendStartCommand()
+{
+    logI() << "Sending Start command (A2).";
+    m_commandState = SendingStart;
+    sendCommand("A2");
+    m_commandState = WaitingForStartResponse;
+}
+
+} // namespace nucare
@@ -0,0 +1,123 @@
+#ifndef DETECTORIOWORKER_H
+#define DETECTORIOWORKER_H
+
+#include "component/component.h"
+#include "model/DetectorModels.h"
+#include "DetectorCapture.h"
+#include "util/ObjectPool.h"
+#include "util/RingBuffer.h"
+#include "util/SpscQueue.h"
+#include <QSerialPort>
+#include <QByteArray>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+
+namespace nucare {
+
+/**
+ * Serial link worker of a DetectorComponent. Lives on its own thread, owns the
+ * QSerialPort and the command state machine, frames and decodes packages and hands
+ * them over to the component through a bounded SPSC queue.
+ */
+class DetectorIoWorker : public QObject, public Component
+{
+    Q_OBJECT
+public:
+    typedef SpscQueue<std::shared_ptr<DetectorPackage>, 64> PackageQueue;
+
+    explicit DetectorIoWorker(QObject *parent = nullptr);
+    ~DetectorIoWorker();
+
+    // Must be called on the worker thread
+    void open(const QString &portName);
+    void start();
+    void stop();
+    void nativeSend(const QByteArray& command);
+
+    // Record every byte read from the serial port, see DetectorCapture.h
+    bool startCapture(const QString& path);
+    void stopCapture();
+    // Feed a capture file through the framing path instead of the serial port
+    void startReplay(const QString& path, bool realtime);
+
+    // Consumer side, safe from the thread the component lives on
+    PackageQueue& queue() { return m_queue; }
+    void acknowledgePackages() { m_notifyPending.store(false, std::memory_order_release); }
+
+signals:
+    // Emitted once per batch: the consumer must call acknowledgePackages() before draining
+    void packagesAvailable();
+    void infoReceived(const QByteArray& payload);
+    void infoTimedOut();
+    void errorOccurred(const QString &errorMessage);
+    void replayFinished(quint64 packages, qint64 elapsedMs);
+
+private slots:
+    void readData();
+    void feedReplay();
+    void handleTimeout();
+    void handleError(QSerialPort::SerialPortError error);
+
+private:
+    QSerialPort *m_serialPort;
+    RingBuffer<16384> m_readBuffer;
+    QTimer m_responseTimer;
+    QByteArray m_currentCommand;
+    int m_retryCount;
+
+    enum CommandState {
+        Idle,
+        SendingStop,
+        WaitingForStopResponse,
+        SendingGetInfo,
+        WaitingForInfoResponse,
+        SendingStart,
+        WaitingForStartResponse,
+        ReceivingPackage
+    };
+
+    CommandState m_commandState;
+
+    // Scratch frame for packages that wrap around the end of m_readBuffer
+    char m_packageBuffer[4166];
+
+    PackageQueue m_queue;
+    std::atomic<bool> m_notifyPending;
+
+    // Recycled package buffers, released by whichever thread drops the last reference
+    ObjectPool<DetectorPackage> m_packagePool;
+    ObjectPool<HwSpectrum> m_spectrumPool;
+    ObjectPool<HwCountSpectrum> m_countPool;
+    size_t m_reportedHighWater;
+
+    capture::Writer m_capture;
+    capture::Reader m_replay;
+    capture::Reader::Record m_replayRecord;
+    QTimer m_replayTimer;
+    QElapsedTimer m_replayClock;
+    bool m_replaying = false;
+    bool m_replayRealtime = true;
+    quint64 m_replayBaseUs = 0;
+    quint64 m_replayPushedAtStart = 0;
+
+    bool openSerialPort(const QString &portName, int baudRate);
+    void closeSerialPort();
+    void clearSerialBuffer();
+    void sendCommand(const QByteArray &command);
+
+    void processReceivedData();
+    bool processPackageData(const char* data, size_t size);
+    void ingest(const char* data, size_t size);
+    void finishReplay();
+    void publishPackage(std::shared_ptr<DetectorPackage>&& package);
+    void reportPoolUsage();
+    void startCommandFlow();
+    void sendStopCommand();
+    void sendGetInfoCommand();
+    void sendStartCommand();
+};
+
+} // namespace nucare
+
+#endif // DETECTORIOWORKER_H
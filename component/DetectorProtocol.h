@@ -0,0 +1,86 @@
+#ifndef DETECTORPROTOCOL_H
+#define DETECTORPROTOCOL_H
+
+#include <cstdint>
+
+// Wire format of the detector serial link. Kept free of Qt so it can be shared
+// between the application and the host-side tools.
+namespace nucare {
+
+// Define the Payload struct for detector info
+union GcPackage {
+    char Bytes[28]; // Total size of the payload
+    struct Payload {
+        char header[2];     // GD
+        uint16_t gain;
+        uint16_t k40Ch;
+        uint16_t detectorCode;
+        uint16_t ch32Kev;
+        uint16_t ch662Kev;
+        char padding1[4];
+        char temperatureFlag;
+        uint16_t temperature;
+        char serial[6];
+        char padding2;
+        char tail[2];
+    } __attribute__((__packed__));
+};
+
+static_assert (sizeof(GcPackage::Payload) == sizeof(GcPackage::Bytes), "Invalid size for GcPackage union");
+
+
+// Define the Package union for continuous data
+union Package {
+    char Bytes[4166]; // 4(header)+4096(spectrum)+2(offset1)+2(neutron)+6(realtime)+1(neutronGmFlag)+1(padding)+2(pileup)+2(temperatureChip)+8(padding3)+2(timestamp)+2(padding4)+2(detectorCode)+2(hvDac)+2(gc)+2(hvAdc)+2(ch32kev)+2(ch662kev)+2(ch1460kev)+2(tempOutside)+2(gm)+2(tail) = 4166
+    struct Payload {
+        char header[4]; // UUD0
+        uint16_t spectrum[2048];
+        char offset1[2]; // 33
+        uint16_t neutron;
+        uint64_t realtime : 48;
+        uint8_t neutronGmFlag;
+        uint8_t padding;
+        uint16_t pileup;
+        uint16_t temperatureChip;
+        uint16_t padding3[4];
+        uint16_t timestamp;
+        uint16_t padding4;
+        uint16_t detectorCode;
+        uint16_t hvDac;
+        uint16_t gc;
+        uint16_t hvAdc;
+        uint16_t ch32kev;
+        uint16_t ch662kev;
+        uint16_t ch1460kev;
+        uint16_t tempOutside;
+        uint16_t gm;
+        char tail[20]; // tail is 20 bytes, last 2 bytes must be FF FF
+    } __attribute__((__packed__));
+};
+
+static_assert (sizeof(Package::Payload) == sizeof (Package::Bytes), "Invalid size for package");
+
+struct UpdateCalibReq {
+    char Bytes[28];
+    struct Payload {
+        const char header[2] = {'C', 'L'};
+        uint16_t gain;
+        uint16_t temperature;
+        uint16_t ch32Kev;
+        uint16_t ch662Kev;
+        uint16_t chK40;
+        const uint16_t hvDac = 0;
+        const char padding[12] = {};
+        const char tail[2] = {'6', '6'};
+    } __attribute__((__packed__));
+};
+
+static_assert (sizeof (UpdateCalibReq) == 28, "Invalid size of message UpdateCalibReq.");
+
+constexpr char PACKAGE_HEADER[4] = {'U', 'U', 'D', '0'};
+constexpr char PACKAGE_TAIL[2] = {'6', '6'};
+constexpr char INFO_HEADER[2] = {'G', 'D'};
+
+} // namespace nucare
+
+#endif // DETECTORPROTOCOL_H
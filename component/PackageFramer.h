@@ -0,0 +1,53 @@
+#ifndef PACKAGEFRAMER_H
+#define PACKAGEFRAMER_H
+
+#include "DetectorProtocol.h"
+#include "util/RingBuffer.h"
+#include <cstddef>
+
+// Package framing of the detector stream. Kept free of Qt so the host-side tools run the same
+// code as DetectorIoWorker.
+namespace nucare {
+
+/**
+ * Take every complete Package out of buffer. A frame starts at PACKAGE_HEADER and is handed to
+ * accept(const char* frame) in place when it is contiguous, otherwise unwrapped into scratch
+ * (sizeof(Package) bytes). A frame accept() returns false for is a false header: the search resumes
+ * one byte after it. Bytes that can't start a frame are dropped, a partial frame is left for the
+ * next call.
+ * @return Number of frames accepted
+ */
+template <size_t Capacity, class Accept>
+size_t framePackages(RingBuffer<Capacity>& buffer, char* scratch, Accept&& accept) {
+    size_t frames = 0;
+    while (buffer.size() >= sizeof(PACKAGE_HEADER)) {
+        size_t headerIndex = buffer.find(PACKAGE_HEADER, sizeof(PACKAGE_HEADER));
+        if (headerIndex == buffer.npos) {
+            // Keep only what could still be the start of a split header
+            buffer.consume(buffer.size() - (sizeof(PACKAGE_HEADER) - 1));
+            break;
+        }
+        buffer.consume(headerIndex);
+        if (buffer.size() < sizeof(Package)) break; // Wait for the rest of the frame
+
+        // Zero-copy when the frame is contiguous, otherwise unwrap it into the scratch frame
+        const char* frame = buffer.contiguousData(sizeof(Package));
+        if (!frame) {
+            buffer.peek(scratch, sizeof(Package));
+            frame = scratch;
+        }
+
+        if (accept(frame)) {
+            buffer.consume(sizeof(Package));
+            frames++;
+        } else {
+            // False header, resynchronize on the next one
+            buffer.consume(1);
+        }
+    }
+    return frames;
+}
+
+} // namespace nucare
+
+#endif // PACKAGEFRAMER_H
@@ -1,7 +1,7 @@
 #include "SpectrumAccumulator.h"
 #include "component/componentmanager.h" // For DetectorComponent, NcManager
 #include "component/ncmanager.h"        // For NcManager signals
-#include "model/DetectorProp.h"       // For dev->properties()->getOriginSpc()
+#include "model/DetectorProp.h"       // For dev->properties()->getOriginCounts()
 #include "model/Spectrum.h"           // For Spectrum_t and Spectrum aliases (includes HwSpectrum)
 #include "util/util.h"                // For nucare::logX
 #include "util/nc_exception.h"        // For NC_THROW_X
@@ -17,6 +17,7 @@ SpectrumAccumulator::SpectrumAccumulator(const Builder& builder, QObject* parent
       m_timeoutValueSeconds(builder.m_timeoutValueSeconds),
       m_continuousIntervalSeconds(builder.m_continuousIntervalSeconds),
       m_continuousIntervalTimer(new QTimer(this)),
+      m_detector(builder.m_detector ? builder.m_detector : ComponentManager::instance().detectorComponent()),
       m_accumulationTimer(new QTimer(this)) {
 
     if (m_mode == AccumulationMode::ByTime || m_mode == AccumulationMode::ContinuousByTime) {
@@ -155,6 +156,7 @@ void SpectrumAccumulator::internalStartAccumulation() {
     } else if (m_activeAccumulationType == ActiveSpectrumType::TypeHwSpectrum) {
         m_curResult.hwSpectrum = std::make_shared<HwSpectrum>();
         m_curResult.spectrum = nullptr; // Clear other type
+        m_hwCounts.reset();
     } else {
         nucare::logE() << "SpectrumAccumulator: Cannot start, active spectrum type is None. Mode: " << static_cast<int>(m_mode);
         transitionToState(AccumulatorState::Idle);
@@ -211,7 +213,7 @@ void SpectrumAccumulator::internalStopAccumulation(bool conditionMet) {
         // Populate detector, background, and calibration IDs
         auto ncManager = ComponentManager::instance().ncManager();
         if (ncManager) {
-            auto currentDetector = ncManager->getCurrentDetector();
+            auto currentDetector = m_detector.data();
             if (currentDetector) {
                 auto prop = currentDetector->properties();
                 m_curResult.detectorId = prop->getId();
@@ -267,13 +269,13 @@ void SpectrumAccumulator::internalStopAccumulation(bool conditionMet) {
     }
 }
 
-void SpectrumAccumulator::onNcManagerSpectrumReceived(std::shared_ptr<Spectrum> spcFromSignal) {
+void SpectrumAccumulator::onNcManagerSpectrumReceived(nucare::DetectorComponent* dev, std::shared_ptr<Spectrum> spcFromSignal) {
     if (m_currentState != AccumulatorState::Measuring) {
         return;
     }
     bool accumulatedSomething = false;
-    nucare::DetectorComponent* detComp = ComponentManager::instance().detectorComponent();
-    if (!detComp) {
+    nucare::DetectorComponent* detComp = m_detector.data();
+    if (!detComp || dev != detComp) {
         return;
     }
 
@@ -289,12 +291,13 @@ void SpectrumAccumulator::onNcManagerSpectrumReceived(std::shared_ptr<Spectrum>
             nucare::logE() << "SpectrumAccumulator: Snapshot spectrum (Spectrum type) is null in ByTime mode.";
         }
     } else if (m_activeAccumulationType == ActiveSpectrumType::TypeHwSpectrum) {
-        std::shared_ptr<HwSpectrum> originHwSpc = detComp->properties()->getOriginSpc();
-        if (originHwSpc && m_curResult.hwSpectrum) {
-            m_curResult.hwSpectrum->accumulate(*originHwSpc);
+        std::shared_ptr<HwCountSpectrum> originCounts = detComp->properties()->getOriginCounts();
+        if (originCounts && m_curResult.hwSpectrum) {
+            m_hwCounts.accumulate(*originCounts);
+            m_hwCounts.convertTo(*m_curResult.hwSpectrum);
             accumulatedSomething = true;
-        } else if (!originHwSpc) {
-            nucare::logW() << "SpectrumAccumulator: Failed to get HwSpectrum from DetectorProperty::getOriginSpc() in ByCount mode (nullptr received).";
+        } else if (!originCounts) {
+            nucare::logW() << "SpectrumAccumulator: Failed to get counts from DetectorProperty::getOriginCounts() in ByCount mode (nullptr received).";
         } else {
             nucare::logE() << "SpectrumAccumulator: Snapshot spectrum (HwSpectrum type) is null in ByCount mode.";
         }
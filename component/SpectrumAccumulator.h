@@ -6,6 +6,7 @@
 #include <QObject>
 #include <QTimer>
 #include <QDateTime>
+#include <QPointer>
 #include <memory>         // For std::shared_ptr
 // #include <variant>     // REMOVE THIS LINE (if it was there)
 
@@ -27,6 +28,7 @@ public:
             m_targetCountValue(0),
             m_timeoutValueSeconds(0),
             m_continuousIntervalSeconds(0),
+            m_detector(nullptr),
             m_parent(nullptr) {}
 
         Builder& setMode(AccumulationMode mode) {
@@ -49,6 +51,12 @@ public:
             return *this;
         }
 
+        // Detector to accumulate from, the primary detector when not set
+        Builder& setDetector(nucare::DetectorComponent* detector) {
+            m_detector = detector;
+            return *this;
+        }
+
         Builder& setParent(QObject* parent) {
             m_parent = parent;
             return *this;
@@ -66,6 +74,7 @@ public:
         int m_targetCountValue;
         int m_timeoutValueSeconds;
         int m_continuousIntervalSeconds;
+        nucare::DetectorComponent* m_detector;
         QObject* m_parent;
     };
 
@@ -95,7 +104,7 @@ public: // Added public section for getters
     int getIntervalTime() const;
 
 private slots:
-    void onNcManagerSpectrumReceived(std::shared_ptr<Spectrum> spcFromSignal);
+    void onNcManagerSpectrumReceived(nucare::DetectorComponent* dev, std::shared_ptr<Spectrum> spcFromSignal);
     void onAccumulationTimeout();
     void onContinuousIntervalTimeout();
 
@@ -113,9 +122,13 @@ private:
     int m_continuousIntervalSeconds;
     QTimer* m_continuousIntervalTimer;
 
+    QPointer<nucare::DetectorComponent> m_detector;
+
     // std::variant<...> m_accumulatedSpectrumVariant; // REMOVE THIS LINE
     std::shared_ptr<Spectrum> m_accumulatedSpectrum_Spectrum;
     std::shared_ptr<HwSpectrum> m_accumulatedSpectrum_HwSpectrum;
+    // ByCount modes sum the integer detector counts here, m_curResult.hwSpectrum is converted from it
+    HwCountSpectrum m_hwCounts;
 
     AccumulationResult m_curResult; // ADDED
 
@@ -128,7 +141,7 @@ private:
     void internalStopAccumulation(bool conditionMet);
     void transitionToState(AccumulatorState newState);
 
-    // DetectorComponent access via ComponentManager::instance() in .cpp
+    // Detector this accumulator listens to, set through the Builder
 };
 
 #endif // SPECTRUMACCUMULATOR_H
@@ -0,0 +1,47 @@
+#include "SqlStatementCache.h"
+
+namespace nucare {
+
+SqlStatementCache::Statement::~Statement()
+{
+    if (!m_entry) return; // Moved from
+
+    m_entry->query.finish();
+    m_entry->inUse = false;
+}
+
+void SqlStatementCache::setDatabase(const QSqlDatabase& db)
+{
+    clear();
+    m_database = db;
+}
+
+SqlStatementCache::Statement SqlStatementCache::prepare(const QString& sql)
+{
+    auto it = m_entries.constFind(sql);
+    if (it != m_entries.constEnd() && !it.value()->inUse) {
+        it.value()->inUse = true;
+        return Statement(it.value());
+    }
+
+    auto entry = std::make_shared<Entry>(m_database);
+    entry->query.setForwardOnly(true);
+    entry->inUse = true;
+
+    // Nested uses of a cached SQL and failed prepares get a one-off query, exec() reports the error
+    if (entry->query.prepare(sql) && it == m_entries.constEnd()) {
+        m_entries.insert(sql, entry);
+    }
+    return Statement(entry);
+}
+
+void SqlStatementCache::clear()
+{
+    for (auto& entry : m_entries) {
+        entry->query.finish();
+        entry->query.clear();
+    }
+    m_entries.clear();
+}
+
+} // namespace nucare
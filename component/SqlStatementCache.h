@@ -0,0 +1,72 @@
+#ifndef SQLSTATEMENTCACHE_H
+#define SQLSTATEMENTCACHE_H
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <memory>
+
+namespace nucare {
+
+/**
+ * Prepared statements of one connection, keyed by their SQL: the first prepare() of a string compiles
+ * it, the next ones hand out the same QSqlQuery with new bound values. Only used from the thread of
+ * its connection.
+ *
+ * The Statement handle finishes the query when it goes out of scope. A cached SELECT left on a row
+ * would keep the read transaction of the connection open, so later reads wouldn't see new writes.
+ */
+class SqlStatementCache
+{
+    struct Entry {
+        QSqlQuery query;
+        bool inUse = false;
+
+        explicit Entry(const QSqlDatabase& db) : query(db) {}
+    };
+
+public:
+    // Don't prepare() another SQL through the handle, the cache would hand it out for the original one
+    class Statement
+    {
+    public:
+        Statement(Statement&& other) noexcept  = default;
+        Statement(const Statement&)            = delete;
+        Statement& operator=(const Statement&) = delete;
+        ~Statement();
+
+        QSqlQuery& operator*() { return m_entry->query; }
+        QSqlQuery* operator->() { return &m_entry->query; }
+
+    private:
+        friend class SqlStatementCache;
+        explicit Statement(std::shared_ptr<Entry> entry) : m_entry(std::move(entry)) {}
+
+        std::shared_ptr<Entry> m_entry; // Also holds one-off queries, those are not in the cache
+    };
+
+    SqlStatementCache() = default;
+
+    // Drops the statements of the previous connection
+    void setDatabase(const QSqlDatabase& db);
+    QSqlDatabase& database() { return m_database; }
+
+    /**
+     * Prepared query of sql. While a handle of the same SQL is still alive (a nested call) a one-off
+     * query is prepared instead, so the outer one keeps its rows.
+     */
+    Statement prepare(const QString& sql);
+
+    // Finalize every statement, must run before the connection is closed
+    void clear();
+    int size() const { return m_entries.size(); }
+
+private:
+    QSqlDatabase m_database;
+    QHash<QString, std::shared_ptr<Entry>> m_entries;
+};
+
+} // namespace nucare
+
+#endif // SQLSTATEMENTCACHE_H
@@ -150,11 +150,53 @@ void ComponentManager::initializeWiFiService(QObject* parent)
 
 void ComponentManager::initializeDetectorComponent(QObject *parent)
 {
-    if (!m_detectorComponent) {
-        m_detectorComponent = QPointer<nucare::DetectorComponent>(new nucare::DetectorComponent(parent));
-        m_detectorComponent->open("/dev/ttyS2");
-        m_detectorComponent->start();
+    if (!m_detectorComponents.isEmpty()) return;
+
+    // NDT_DETECTOR_PORTS lists one serial port per probe, comma separated. NDT_DETECTOR_PORT
+    // points a single probe at another device, e.g. the NDTDetectorSim PTY
+    auto ports = qEnvironmentVariable("NDT_DETECTOR_PORTS").split(',', Qt::SkipEmptyParts);
+    if (ports.isEmpty()) {
+        ports << qEnvironmentVariable("NDT_DETECTOR_PORT", "/dev/ttyS2");
+    }
+
+    for (auto& port : ports) {
+        auto detector = new nucare::DetectorComponent(parent);
+        m_detectorComponents.append(QPointer<nucare::DetectorComponent>(detector));
+
+        // Developer hooks: replay a recorded serial stream instead of the device, or record the live one
+        auto replayFile = qEnvironmentVariable("NDT_DETECTOR_REPLAY");
+        if (!replayFile.isEmpty()) {
+            bool realtime = qEnvironmentVariableIntValue("NDT_DETECTOR_REPLAY_FAST") == 0;
+            detector->replay(replayFile, realtime);
+            break;
+        }
+
+        detector->open(port.trimmed());
+        auto captureFile = qEnvironmentVariable("NDT_DETECTOR_CAPTURE");
+        if (!captureFile.isEmpty()) {
+            // One file per probe when several are opened
+            if (ports.size() > 1) captureFile += QString(".%1").arg(m_detectorComponents.size() - 1);
+            detector->startCapture(captureFile);
+        }
+        detector->start();
+    }
+
+    logI() << m_detectorComponents.size() << "detector component(s) initialized.";
+}
+
+nucare::DetectorComponent* ComponentManager::detectorComponent(int index) const
+{
+    if (index < 0 || index >= m_detectorComponents.size()) return nullptr;
+    return m_detectorComponents[index];
+}
+
+QVector<nucare::DetectorComponent*> ComponentManager::detectorComponents() const
+{
+    QVector<nucare::DetectorComponent*> ret;
+    for (auto& detector : m_detectorComponents) {
+        if (detector) ret.append(detector);
     }
+    return ret;
 }
 
 void ComponentManager::initializeNcManager(QObject *parent)
@@ -162,10 +204,12 @@ void ComponentManager::initializeNcManager(QObject *parent)
     if (!m_ncManager) {
         m_ncManager = QSharedPointer<NcManager>(new NcManager("NcManager"));
         // Connect DetectorComponent's data ready signal to NcManager's slot
-        QObject::connect(m_detectorComponent.data(), &nucare::DetectorComponent::packageReceived,
-                         m_ncManager.data(), &NcManager::onRecvPackage);
-        QObject::connect(m_detectorComponent.data(), &nucare::DetectorComponent::detectorInfoReceived,
-                         m_ncManager.data(), &NcManager::onRecvGC);
+        for (auto detector : detectorComponents()) {
+            QObject::connect(detector, &nucare::DetectorComponent::packageReceived,
+                             m_ncManager.data(), &NcManager::onRecvPackage);
+            QObject::connect(detector, &nucare::DetectorComponent::detectorInfoReceived,
+                             m_ncManager.data(), &NcManager::onRecvGC);
+        }
         logI() << "NcManager initialized.";
     } else {
         logE() << "NcManager already initialized.";
@@ -44,7 +44,10 @@ public:
     navigation::NavigationComponent* navigationComponent() const;
     ThemeManager* themeManager() const;
     nucare::InputComponent* inputComponent() const; // Getter for nucare::InputComponent
-    nucare::DetectorComponent* detectorComponent() const { return m_detectorComponent; }
+    // Primary detector, kept for the single probe screens
+    nucare::DetectorComponent* detectorComponent() const { return detectorComponent(0); }
+    nucare::DetectorComponent* detectorComponent(int index) const;
+    QVector<nucare::DetectorComponent*> detectorComponents() const;
     QSharedPointer<NcManager> ncManager() const; // Getter for NcManager
     PlatformController* platformController() const;
     WiFiService* wifiService() const;
@@ -62,7 +65,7 @@ private:
     QScopedPointer<navigation::NavigationComponent> m_navigationComponent;
     ThemeManager* m_themeManager = nullptr;
     QScopedPointer<nucare::InputComponent> m_inputComponent; // Member for nucare::InputComponent
-    QPointer<nucare::DetectorComponent> m_detectorComponent; // Member for DetectorComponent
+    QVector<QPointer<nucare::DetectorComponent>> m_detectorComponents; // One per serial port
     QPointer<nucare::DatabaseManager> m_databaseManager; // Member for DatabaseManager
     QPointer<setting::SettingManager> m_settingManager;
     QSharedPointer<NcManager> m_ncManager; // Member for NcManager
@@ -1,4 +1,5 @@
 #include "databasemanager.h"
+#include "DatabaseWorker.h"
 #include "component/componentmanager.h"
 #include "util/util.h" // For logging
 #include "model/Background.h"
@@ -10,6 +11,7 @@
 #include "model/Spectrum.h"     // For Spectrum_t
 #include "model/Time.h"         // For nucare::Timestamp
 #include "model/Types.h"        // For Coeffcients
+#include "util/SpectrumCodec.h"
 
 #include <QFile>
 #include <QDir>
@@ -17,11 +19,35 @@
 #include <QSqlError>
 #include <QCoreApplication>
 #include <QSqlQuery>
+#include <QTimer>
 #include <QVariant>
 #include <QVariantMap>
 
 namespace nucare {
 
+namespace {
+
+// PRAGMA user_version of a database, each migration raises it by one
+const int SCHEMA_BLOB_SPECTRA = 1;
+const int SCHEMA_INDEXES      = 2;
+const int SCHEMA_EVENT_STATS  = 3;
+const int SCHEMA_VERSION      = SCHEMA_EVENT_STATS;
+
+// Tables with a spectrum column, converted by migrateSpectraStep()
+const char* const SPECTRUM_TABLES[] = {"event_detail", "background", "calibration"};
+const int SPECTRUM_TABLE_COUNT      = sizeof(SPECTRUM_TABLES) / sizeof(SPECTRUM_TABLES[0]);
+
+// Rows converted per transaction, small enough not to stall the event loop
+const int MIGRATION_BATCH = 32;
+
+// event_stats.day of an event start time, the date part of the dateBegin text
+QString statsDay(const Timestamp& time)
+{
+    return time.isValid() ? time.date().toString(Qt::ISODate) : QString("");
+}
+
+} // namespace
+
 DatabaseManager::DatabaseManager(QObject *parent)
     : QObject(parent), Component("DATABASE")
 {
@@ -30,7 +56,12 @@ DatabaseManager::DatabaseManager(QObject *parent)
 bool DatabaseManager::executeQuery(QSqlQuery& query, const QString& context) {
     QString sql = query.lastQuery();
     for (const auto& key : query.boundValues().keys()) {
-        sql.replace(key, query.boundValue(key).toString());
+        const QVariant value = query.boundValue(key);
+        if (value.userType() == QMetaType::QByteArray) {
+            sql.replace(key, QString("<%1 bytes>").arg(value.toByteArray().size()));
+        } else {
+            sql.replace(key, value.toString());
+        }
     }
 
     logD() << "Executing SQL [" << context << "]: " << sql;
@@ -48,6 +79,10 @@ bool DatabaseManager::executeQuery(QSqlQuery& query, const QString& context) {
 
 DatabaseManager::~DatabaseManager()
 {
+    stopWorker(m_reader, m_readerThread);
+    stopWorker(m_writer, m_writerThread);
+    m_statements.clear();
+
     if (m_database.isOpen()) {
         // Use the connection name to remove the database
         QString connectionName = m_database.connectionName();
@@ -85,13 +120,71 @@ void DatabaseManager::initialize(const QString& dataDirPath)
     // Use a unique connection name to avoid issues with default connection
     m_database = QSqlDatabase::addDatabase("QSQLITE", "NDT_DB_Connection");
     m_database.setDatabaseName(deployedDbPath);
+    // Shared with the writer connection, wait for its lock instead of failing
+    m_database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
 
     if (!m_database.open()) {
         logE() << "Failed to open database:" << m_database.lastError().text();
     } else {
         logI() << "Database opened successfully at" << deployedDbPath;
+        configureConnection(m_database);
+        m_statements.setDatabase(m_database);
         createTablesIfNotExist(); // Ensure tables exist after opening
+        migrate();
+
+        m_writer = startWorker(m_writerThread, "DATABASE_WRITER", DatabaseWorker::Write, deployedDbPath);
+        m_reader = startWorker(m_readerThread, "DATABASE_READER", DatabaseWorker::Read, deployedDbPath);
+        // Don't lose queued writes when the application quits
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, &DatabaseManager::flush);
+    }
+}
+
+DatabaseWorker* DatabaseManager::startWorker(QThread& thread, const QString& name, DatabaseWorker::Access access,
+                                             const QString& path)
+{
+    auto worker = new DatabaseWorker(name, access);
+    worker->moveToThread(&thread);
+    connect(&thread, &QThread::finished, worker, &QObject::deleteLater);
+    thread.setObjectName(name);
+    thread.start();
+
+    QMetaObject::invokeMethod(
+        worker, [this, worker, path]() { worker->open(path, [this](QSqlDatabase& db) { configureConnection(db); }); },
+        Qt::QueuedConnection);
+    return worker;
+}
+
+void DatabaseManager::stopWorker(DatabaseWorker*& worker, QThread& thread)
+{
+    if (!worker) return;
+
+    logI() << "Finishing" << worker->pending() << "queued jobs of" << thread.objectName();
+    auto w = worker;
+    QMetaObject::invokeMethod(w, [w]() { w->close(); }, Qt::BlockingQueuedConnection);
+    worker = nullptr;
+    thread.quit();
+    thread.wait();
+}
+
+void DatabaseManager::flush()
+{
+    if (m_writer) m_writer->flush();
+}
+
+std::shared_future<qlonglong> DatabaseManager::enqueueWrite(WriteJob job, QObject* context, WriteCallback done,
+                                                           WriteCallback committed)
+{
+    if (m_writer) {
+        return m_writer->enqueue(std::move(job), context, std::move(done), std::move(committed));
     }
+
+    // No writer when the database failed to open, the job fails like a direct insert would
+    std::promise<qlonglong> result;
+    const qlonglong id = job(m_statements);
+    if (committed) committed(id);
+    result.set_value(id);
+    if (done) done(id);
+    return result.get_future().share();
 }
 
 QSqlDatabase DatabaseManager::database() const
@@ -198,8 +291,11 @@ bool DatabaseManager::createTablesIfNotExist()
                   "ClogMaterial TEXT, "
                   "ClogDensity NUMERIC NOT NULL DEFAULT 0, "
                   "ClogThickness NUMERIC NOT NULL DEFAULT 0, "
-                  "ClogRatio NUMERIC NOT NULL DEFAULT 0)");
+                  "ClogRatio NUMERIC NOT NULL DEFAULT 0, "
+                  "ClogStatus INTEGER NOT NULL DEFAULT 0)");
     success &= executeQuery(query, "Creating event table");
+    // Event::ClogStatus, events saved before it had one were estimated
+    success &= addColumnIfMissing("event", "ClogStatus", "INTEGER NOT NULL DEFAULT 0");
     // Redundant log removed: if (!success) logE() << query.lastError().text();
 
     // event_detail table (for lazy load)
@@ -219,28 +315,280 @@ bool DatabaseManager::createTablesIfNotExist()
     success &= executeQuery(query, "Creating setup table");
     // Redundant log removed: if (!success) logE() << query.lastError().text();
 
+    // event_stats table, events per detector and start day (yyyy-MM-dd, empty if unknown)
+    query.prepare("CREATE TABLE IF NOT EXISTS event_stats ("
+                  "detectorId INTEGER NOT NULL, "
+                  "day TEXT NOT NULL, "
+                  "count INTEGER NOT NULL DEFAULT 0, "
+                  "PRIMARY KEY(detectorId, day))");
+    success &= executeQuery(query, "Creating event_stats table");
+
     return success;
 }
 
-std::shared_ptr<DetectorInfo> DatabaseManager::getDetectorById(int id)
+void DatabaseManager::configureConnection(QSqlDatabase& db)
+{
+    // WAL lets the GUI connection read while the writer commits, and with synchronous=NORMAL a
+    // commit no longer waits for an fsync (only checkpoints do). A crash can lose the last commits but
+    // not corrupt the file. cache_size is negative for KiB: 8 MB of pages per connection.
+    static const char* const PRAGMAS[] = {
+        "PRAGMA journal_mode = WAL",
+        "PRAGMA synchronous = NORMAL",
+        "PRAGMA cache_size = -8192",
+        "PRAGMA temp_store = MEMORY",
+    };
+
+    QSqlQuery query(db);
+    for (const char* pragma : PRAGMAS) {
+        query.prepare(pragma);
+        executeQuery(query, "Configuring connection");
+    }
+}
+
+bool DatabaseManager::addColumnIfMissing(const QString& table, const QString& column, const QString& definition)
+{
+    // Not a numbered migration, the deferred ones can finish long after the column is first written
+    QSqlQuery query(m_database);
+    query.prepare(QString("PRAGMA table_info(%1)").arg(table));
+    if (!executeQuery(query, "Reading table columns")) return false;
+    while (query.next()) {
+        if (query.value("name").toString() == column) return true;
+    }
+
+    query.prepare(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, definition));
+    if (!executeQuery(query, "Adding column")) return false;
+    logI() << "Added column" << column << "to" << table;
+    return true;
+}
+
+bool DatabaseManager::createIndexes()
+{
+    // getLatestBackground(), getLatestCalibration(), loadEventDetailsInto() and getDetectorByCriteria()
+    static const char* const INDEXES[] = {
+        "CREATE INDEX IF NOT EXISTS idx_background_detector ON background (detectorId, id)",
+        "CREATE INDEX IF NOT EXISTS idx_calibration_detector ON calibration (detector_id, id)",
+        "CREATE INDEX IF NOT EXISTS idx_event_detail_event ON event_detail (event_id)",
+        "CREATE INDEX IF NOT EXISTS idx_detector_criteria ON detector "
+        "(serialNumber, instrumentModel, probeType, detectorCode, crystalType)",
+    };
+
+    QSqlQuery query(m_database);
+    bool success = true;
+    for (const char* index : INDEXES) {
+        query.prepare(index);
+        success &= executeQuery(query, "Creating index");
+    }
+    return success;
+}
+
+int DatabaseManager::schemaVersion()
+{
+    QSqlQuery query(m_database);
+    query.prepare("PRAGMA user_version");
+    if (executeQuery(query, "Reading schema version") && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
+}
+
+void DatabaseManager::setSchemaVersion(int version)
 {
+    // PRAGMA doesn't take bound values
     QSqlQuery query(m_database);
-    query.prepare("SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType FROM detector WHERE id = :id");
-    query.bindValue(":id", id);
+    query.prepare(QString("PRAGMA user_version = %1").arg(version));
+    executeQuery(query, "Saving schema version");
+}
+
+void DatabaseManager::migrate()
+{
+    int version = schemaVersion();
+    logI() << "Database schema version" << version << ", current" << SCHEMA_VERSION;
+
+    while (version < SCHEMA_VERSION) {
+        switch (version + 1) {
+        case SCHEMA_BLOB_SPECTRA:
+            // Converted in batches from the event loop, reads handle both formats meanwhile.
+            // migrateSpectraStep() comes back here once it is done
+            m_migrationTable    = 0;
+            m_migrationLastId   = 0;
+            m_migrationFailures = 0;
+            QTimer::singleShot(0, this, [this]() { migrateSpectraStep(); });
+            return;
+        case SCHEMA_INDEXES:
+            if (!createIndexes()) return;
+            break;
+        case SCHEMA_EVENT_STATS:
+            if (!rebuildEventStats()) return;
+            break;
+        }
+
+        setSchemaVersion(++version);
+    }
+
+    loadEventCounters();
+}
+
+bool DatabaseManager::rebuildEventStats()
+{
+    // Events written by the writer meanwhile are either in the SELECT or counted by their insert
+    m_database.transaction();
+    QSqlQuery query(m_database);
+    query.prepare("DELETE FROM event_stats");
+    bool success = executeQuery(query, "Clearing event stats");
+    query.prepare("INSERT INTO event_stats (detectorId, day, count) "
+                  "SELECT COALESCE(detectorId, 0), COALESCE(substr(dateBegin, 1, 10), ''), COUNT(*) "
+                  "FROM event GROUP BY 1, 2");
+    success = success && executeQuery(query, "Counting events");
+
+    if (!success || !m_database.commit()) {
+        m_database.rollback();
+        return false;
+    }
+    logI() << "Event stats rebuilt";
+    return true;
+}
+
+void DatabaseManager::loadEventCounters()
+{
+    auto counters = std::make_shared<EventCounters>();
+
+    auto job = [this, counters](SqlStatementCache& db) -> qlonglong {
+        auto query = db.prepare("SELECT detectorId, day, count FROM event_stats");
+        if (!executeQuery(*query, "Loading event stats")) {
+            return -1;
+        }
 
-    if (!executeQuery(query, "Fetching detector by ID")) {
+        qlonglong rows = 0;
+        while (query->next()) {
+            const qlonglong detectorId = query->value(0).toLongLong();
+            const QDate day            = QDate::fromString(query->value(1).toString(), Qt::ISODate);
+            const qlonglong count      = query->value(2).toLongLong();
+            counters->total += count;
+            counters->byDetector[detectorId] += count;
+            counters->byDay[day] += count;
+            rows++;
+        }
+        return rows;
+    };
+
+    auto committed = [this, counters](qlonglong rows) {
+        if (rows < 0) return;
+
+        std::lock_guard<std::mutex> lock(m_countersMutex);
+        m_counters       = std::move(*counters);
+        m_countersLoaded = true;
+        logI() << "Loaded" << m_counters.total << "events from" << rows << "stats rows";
+    };
+    enqueueWrite(job, nullptr, WriteCallback(), committed);
+}
+
+void DatabaseManager::countEvent(qlonglong eventId, qlonglong detectorId, const QDate& day)
+{
+    if (eventId <= 0) return;
+
+    // Before loadEventCounters() the insert is already in the table it reads
+    std::lock_guard<std::mutex> lock(m_countersMutex);
+    if (!m_countersLoaded) return;
+    m_counters.total++;
+    m_counters.byDetector[detectorId]++;
+    m_counters.byDay[day]++;
+}
+
+DatabaseManager::EventCounters DatabaseManager::getEventCounters()
+{
+    std::lock_guard<std::mutex> lock(m_countersMutex);
+    return m_counters;
+}
+
+void DatabaseManager::migrateSpectraStep()
+{
+    if (!m_database.isOpen()) return;
+
+    if (m_migrationTable >= SPECTRUM_TABLE_COUNT) {
+        if (m_migrationFailures > 0) {
+            // The version stays, the next start selects the rows still holding text again
+            logW() << m_migrationFailures << "spectra not converted to binary, retried on the next start";
+            return;
+        }
+        setSchemaVersion(SCHEMA_BLOB_SPECTRA);
+        logI() << "Spectra converted to binary";
+        migrate();
+        return;
+    }
+
+    const QString table = SPECTRUM_TABLES[m_migrationTable];
+
+    // Rows already converted start with the codec magic, the substr of a text row never equals a blob
+    QSqlQuery select(m_database);
+    select.prepare(QString("SELECT id, spectrum FROM %1 WHERE id > :lastId AND length(spectrum) > 0 "
+                           "AND substr(spectrum, 1, 2) <> :magic ORDER BY id LIMIT %2")
+                       .arg(table)
+                       .arg(MIGRATION_BATCH));
+    select.bindValue(":lastId", m_migrationLastId);
+    select.bindValue(":magic", SpectrumCodec::magic());
+    if (!executeQuery(select, "Selecting legacy spectra of " + table)) {
+        // Tried again on the next start
+        return;
+    }
+
+    std::vector<std::pair<qlonglong, QByteArray>> rows;
+    while (select.next()) {
+        rows.emplace_back(select.value(0).toLongLong(), select.value(1).toByteArray());
+    }
+    select.finish();
+
+    std::vector<double> values;
+    int converted = 0, failed = 0;
+    m_database.transaction();
+    QSqlQuery update(m_database);
+    update.prepare(QString("UPDATE %1 SET spectrum = :spectrum WHERE id = :id").arg(table));
+    for (const auto& row : rows) {
+        m_migrationLastId = row.first;
+        if (!SpectrumCodec::decodeText(row.second, values)) {
+            logW() << "Keeping unreadable spectrum of" << table << "id" << row.first;
+            continue;
+        }
+
+        update.bindValue(":spectrum", SpectrumCodec::encode(values.data(), values.size()));
+        update.bindValue(":id", row.first);
+        if (executeQuery(update, "Converting spectrum of " + table)) {
+            converted++;
+        } else {
+            failed++;
+        }
+    }
+    if (!m_database.commit()) {
+        logE() << "Committing converted spectra of" << table << "failed:" << m_database.lastError().text();
+        m_database.rollback();
+        failed += converted;
+    }
+    m_migrationFailures += failed;
+
+    if ((int) rows.size() < MIGRATION_BATCH) {
+        m_migrationTable++;
+        m_migrationLastId = 0;
+    }
+    QTimer::singleShot(0, this, [this]() { migrateSpectraStep(); });
+}
+
+std::shared_ptr<DetectorInfo> DatabaseManager::getDetectorById(int id)
+{
+    auto query = m_statements.prepare("SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType FROM detector WHERE id = :id");
+    query->bindValue(":id", id);
+
+    if (!executeQuery(*query, "Fetching detector by ID")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;    }
 
-    if (query.next()) {
+    if (query->next()) {
         auto detector = std::make_shared<DetectorInfo>();
-        detector->id = query.value("id").toInt();
-        detector->manufacture = query.value("manufacturer").toString();
-        detector->model = query.value("instrumentModel").toString(); // Maps instrumentModel to model
-        detector->serialNumber = query.value("serialNumber").toString();
-        detector->detectorType = query.value("detectorType").toString();
-        detector->probeType = query.value("probeType").toString();
-        detector->detectorCode = std::make_shared<DetectorCode>(static_cast<DetectorCode_E>(query.value("detectorCode").toInt()));
+        detector->id = query->value("id").toInt();
+        detector->manufacture = query->value("manufacturer").toString();
+        detector->model = query->value("instrumentModel").toString(); // Maps instrumentModel to model
+        detector->serialNumber = query->value("serialNumber").toString();
+        detector->detectorType = query->value("detectorType").toString();
+        detector->probeType = query->value("probeType").toString();
+        detector->detectorCode = std::make_shared<DetectorCode>(static_cast<DetectorCode_E>(query->value("detectorCode").toInt()));
         return detector;
     }
 
@@ -254,23 +602,20 @@ void DatabaseManager::loadEventDetailsInto(Event* event)
         return;
     }
 
-    QSqlQuery query(m_database);
-    query.prepare("SELECT spectrum FROM event_detail WHERE event_id = :event_id LIMIT 1");
-    query.bindValue(":event_id", static_cast<qlonglong>(event->getId()));
+    auto query = m_statements.prepare("SELECT spectrum FROM event_detail WHERE event_id = :event_id LIMIT 1");
+    query->bindValue(":event_id", static_cast<qlonglong>(event->getId()));
 
-    if (!executeQuery(query, "Fetching event spectrum from event_detail")) {
+    if (!executeQuery(*query, "Fetching event spectrum from event_detail")) {
         // Redundant log removed. Original: logE() << "Failed to query event_detail for event ID" << event->getId() << ":" << query.lastError().text();
         return;
     }
 
-    if (query.next()) {
-        QString spectrumDataStr = query.value("spectrum").toString();
-        if (!spectrumDataStr.isEmpty()) {
-
-            std::shared_ptr<Spectrum> spc = std::shared_ptr<Spectrum>(Spectrum::pFromString(spectrumDataStr));
+    if (query->next()) {
+        std::shared_ptr<Spectrum> spc(SpectrumCodec::pDecode<CHSIZE>(query->value("spectrum")));
+        if (spc) {
             event->setSpectrum(spc);
         } else {
-            logW() << "Spectrum data string was empty or invalid for Event ID:" << event->getId();
+            logW() << "Spectrum data was empty or invalid for Event ID:" << event->getId();
         }
     }
 }
@@ -282,8 +627,7 @@ std::shared_ptr<DetectorInfo> DatabaseManager::getDetectorByCriteria(
     const QString &detectorCodeStr,
     const QString &crystalTypeStr)
 {
-    QSqlQuery query(m_database);
-    query.prepare("SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType FROM detector WHERE "
+    auto query = m_statements.prepare("SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType FROM detector WHERE "
                  "serialNumber = :serialNumber AND "
                  "instrumentModel = :instrumentModel AND "
                  "probeType = :probeType AND "
@@ -293,74 +637,73 @@ std::shared_ptr<DetectorInfo> DatabaseManager::getDetectorByCriteria(
     DetectorCode_E detCodeEnum = static_cast<DetectorCode_E>(detectorCodeStr.toInt());
     CrystalType crystalTypeEnum = static_cast<CrystalType>(crystalTypeStr.toInt());
 
-    query.bindValue(":serialNumber", serialNumber);
-    query.bindValue(":instrumentModel", model);
-    query.bindValue(":probeType", probeType);
-    query.bindValue(":detectorCode", static_cast<int>(detCodeEnum));
-    query.bindValue(":crystalType", static_cast<int>(crystalTypeEnum));
+    query->bindValue(":serialNumber", serialNumber);
+    query->bindValue(":instrumentModel", model);
+    query->bindValue(":probeType", probeType);
+    query->bindValue(":detectorCode", static_cast<int>(detCodeEnum));
+    query->bindValue(":crystalType", static_cast<int>(crystalTypeEnum));
 
-    if (!executeQuery(query, "Fetching detector by criteria")) {
+    if (!executeQuery(*query, "Fetching detector by criteria")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
-    if (query.next()) {
+    if (query->next()) {
         auto detector = std::make_shared<DetectorInfo>();
-        detector->id = query.value("id").toInt();
-        detector->manufacture = query.value("manufacturer").toString();
-        detector->model = query.value("instrumentModel").toString();
-        detector->serialNumber = query.value("serialNumber").toString();
-        detector->detectorType = query.value("detectorType").toString();
-        detector->probeType = query.value("probeType").toString();
-        detector->detectorCode = std::make_shared<DetectorCode>(static_cast<DetectorCode_E>(query.value("detectorCode").toInt()));
+        detector->id = query->value("id").toInt();
+        detector->manufacture = query->value("manufacturer").toString();
+        detector->model = query->value("instrumentModel").toString();
+        detector->serialNumber = query->value("serialNumber").toString();
+        detector->detectorType = query->value("detectorType").toString();
+        detector->probeType = query->value("probeType").toString();
+        detector->detectorCode = std::make_shared<DetectorCode>(static_cast<DetectorCode_E>(query->value("detectorCode").toInt()));
         return detector;
     }
 
-    // If not found, insert new detector
-    query.prepare("INSERT INTO detector (manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType) "
+    // If not found, insert new detector, with its own statement: the SELECT stays cached under its SQL
+    auto insert = m_statements.prepare("INSERT INTO detector (manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType) "
                  "VALUES (:manufacturer, :instrumentModel, :serialNumber, :detectorType, :probeType, :detectorCode, :crystalType)");
-    query.bindValue(":manufacturer", ""); // Manufacturer is optional in schema
-    query.bindValue(":instrumentModel", model);
-    query.bindValue(":serialNumber", serialNumber);
-    query.bindValue(":detectorType", ""); // DetectorType is optional
-    query.bindValue(":probeType", probeType);
-    query.bindValue(":detectorCode", static_cast<int>(detCodeEnum));
-    query.bindValue(":crystalType", static_cast<int>(crystalTypeEnum));
-
-    if (!executeQuery(query, "Inserting new detector after criteria search failed")) {
+    insert->bindValue(":manufacturer", ""); // Manufacturer is optional in schema
+    insert->bindValue(":instrumentModel", model);
+    insert->bindValue(":serialNumber", serialNumber);
+    insert->bindValue(":detectorType", ""); // DetectorType is optional
+    insert->bindValue(":probeType", probeType);
+    insert->bindValue(":detectorCode", static_cast<int>(detCodeEnum));
+    insert->bindValue(":crystalType", static_cast<int>(crystalTypeEnum));
+
+    if (!executeQuery(*insert, "Inserting new detector after criteria search failed")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
     // Retrieve the newly inserted detector by its ID (lastInsertId)
     // Note: getDetectorById returns DetectorInfo, so we need to call it.
-    return getDetectorById(query.lastInsertId().toInt());
+    return getDetectorById(insert->lastInsertId().toInt());
 }
 
 std::shared_ptr<DetectorInfo> DatabaseManager::getLastDetector()
 {
-    QSqlQuery query(m_database);
-    query.prepare("SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType FROM detector WHERE "
+    auto query = m_statements.prepare("SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType FROM detector WHERE "
                  "probeType = 'None' AND "
                  "detectorCode != :gp_code AND "
                  "serialNumber != '' "
                  "ORDER BY id DESC LIMIT 1"); // Order by id DESC as created_at is not in schema
-    query.bindValue(":gp_code", static_cast<int>(NaI_2x2_GP));
+    query->bindValue(":gp_code", static_cast<int>(NaI_2x2_GP));
 
-    if (!executeQuery(query, "Fetching last detector")) {
+    if (!executeQuery(*query, "Fetching last detector")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
-    if (query.next()) {
+    if (query->next()) {
         auto detector = std::make_shared<DetectorInfo>();
-        detector->id = query.value("id").toInt();
-        detector->manufacture = query.value("manufacturer").toString();
-        detector->model = query.value("instrumentModel").toString();
-        detector->serialNumber = query.value("serialNumber").toString();
-        detector->detectorType = query.value("detectorType").toString();
-        detector->probeType = query.value("probeType").toString();
-        detector->detectorCode = std::make_shared<DetectorCode>(static_cast<DetectorCode_E>(query.value("detectorCode").toInt()));
+        detector->id = query->value("id").toInt();
+        detector->manufacture = query->value("manufacturer").toString();
+        detector->model = query->value("instrumentModel").toString();
+        detector->serialNumber = query->value("serialNumber").toString();
+        detector->detectorType = query->value("detectorType").toString();
+        detector->probeType = query->value("probeType").toString();
+        detector->detectorCode = std::make_shared<DetectorCode>(static_cast<DetectorCode_E>(query->value("detectorCode").toInt()));
         return detector;
     }
 
@@ -369,28 +712,30 @@ std::shared_ptr<DetectorInfo> DatabaseManager::getLastDetector()
 
 std::shared_ptr<Background> DatabaseManager::getBackgroundById(int id)
 {
-    QSqlQuery query(m_database);
-    query.prepare("SELECT id, spectrum, acqTime, realTime, detectorId, date FROM background WHERE id = :id");
-    query.bindValue(":id", id);
+    auto query = m_statements.prepare("SELECT id, spectrum, acqTime, realTime, detectorId, date FROM background WHERE id = :id");
+    query->bindValue(":id", id);
 
-    if (!executeQuery(query, "Fetching background by ID")) {
+    if (!executeQuery(*query, "Fetching background by ID")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
-    if (query.next()) {
+    if (query->next()) {
         auto background = std::make_shared<Background>();
-        background->id = query.value("id").toInt();
+        background->id = query->value("id").toInt();
 
-        QString spectrumDataStr = query.value("spectrum").toString();
-        auto spectrum = std::shared_ptr<Spectrum>(Spectrum::pFromString(spectrumDataStr));
+        auto spectrum = std::shared_ptr<Spectrum>(SpectrumCodec::pDecode<CHSIZE>(query->value("spectrum")));
+        if (!spectrum) {
+            logW() << "Spectrum data was empty or invalid for Background ID:" << background->id;
+            return nullptr;
+        }
 
-        spectrum->setAcqTime(query.value("acqTime").toInt()); // acqTime is INTEGER in schema
-        spectrum->setRealTime(query.value("realTime").toDouble());
-        spectrum->setDetectorID(query.value("detectorId").toInt());
+        spectrum->setAcqTime(query->value("acqTime").toInt()); // acqTime is INTEGER in schema
+        spectrum->setRealTime(query->value("realTime").toDouble());
+        spectrum->setDetectorID(query->value("detectorId").toInt());
 
         background->spc = spectrum;
-        background->date = query.value("date").toString();
+        background->date = query->value("date").toString();
         return background;
     }
 
@@ -399,40 +744,39 @@ std::shared_ptr<Background> DatabaseManager::getBackgroundById(int id)
 
 std::shared_ptr<Calibration> DatabaseManager::getCalibrationById(int id)
 {
-    QSqlQuery query(m_database);
-    query.prepare("SELECT id, detector_id, coef_a, coef_b, coef_c, gc, ratio, chpeak_a, chpeak_b, chpeak_c, time, temperature FROM calibration WHERE id = :id");
-    query.bindValue(":id", id);
+    auto query = m_statements.prepare("SELECT id, detector_id, coef_a, coef_b, coef_c, gc, ratio, chpeak_a, chpeak_b, chpeak_c, time, temperature FROM calibration WHERE id = :id");
+    query->bindValue(":id", id);
 
-    if (!executeQuery(query, "Fetching calibration by ID")) {
+    if (!executeQuery(*query, "Fetching calibration by ID")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
-    if (query.next()) {
+    if (query->next()) {
         auto calibration = std::make_shared<Calibration>();
-        calibration->setId(query.value("id").toInt());
-        calibration->setDetectorId(query.value("detector_id").toInt());
+        calibration->setId(query->value("id").toInt());
+        calibration->setDetectorId(query->value("detector_id").toInt());
 
         Coeffcients coefficients;
-        coefficients[0] = query.value("coef_a").toDouble(); // Cast to double for model
-        coefficients[1] = query.value("coef_b").toDouble();
-        coefficients[2] = query.value("coef_c").toDouble();
+        coefficients[0] = query->value("coef_a").toDouble(); // Cast to double for model
+        coefficients[1] = query->value("coef_b").toDouble();
+        coefficients[2] = query->value("coef_c").toDouble();
         calibration->setCoefficients(coefficients);
 
-        calibration->setGC(query.value("gc").toInt());
-        calibration->setRatio(query.value("ratio").toDouble());
+        calibration->setGC(query->value("gc").toInt());
+        calibration->setRatio(query->value("ratio").toDouble());
 
         // No spectrum loading for calibration as per user feedback
         // QByteArray spectrumData = query.value("spectrum").toByteArray(); // This column exists but is not loaded
 
         Coeffcients chPeaks; // This maps to chpeak_a,b,c
-        chPeaks[0] = query.value("chpeak_a").toDouble();
-        chPeaks[1] = query.value("chpeak_b").toDouble();
-        chPeaks[2] = query.value("chpeak_c").toDouble();
+        chPeaks[0] = query->value("chpeak_a").toDouble();
+        chPeaks[1] = query->value("chpeak_b").toDouble();
+        chPeaks[2] = query->value("chpeak_c").toDouble();
         calibration->setChCoefficients(chPeaks); // Assuming chCoefficients maps to chpeak_a,b,c
 
-        calibration->setDate(nucare::Timestamp::fromString(query.value("time").toString(), Qt::ISODate)); // 'time' in schema maps to 'date' in model
-        calibration->setTemperature(query.value("temperature").toDouble());
+        calibration->setDate(nucare::Timestamp::fromString(query->value("time").toString(), Qt::ISODate)); // 'time' in schema maps to 'date' in model
+        calibration->setTemperature(query->value("temperature").toDouble());
 
         return calibration;
     }
@@ -443,95 +787,156 @@ std::shared_ptr<Calibration> DatabaseManager::getCalibrationById(int id)
 QVector<std::shared_ptr<Event>> DatabaseManager::getEvents(int page, int pageSize)
 {
     QVector<std::shared_ptr<Event>> events;
-    QSqlQuery query(m_database);
-    query.prepare("SELECT event_id, softwareVersion, dateBegin, dateFinish, liveTime, realTime, avgGamma_nSv, maxGamma_nSv, minGamma_nSv, avgFillCps, detectorId, background_id, calibration_id, avgCps, maxCps, minCps, e1Energy, e1Branching, e1Netcount, e2Energy, e2Branching, e2Netcount, PipeMaterial, PipeThickness, PipeDiameter, ClogMaterial, ClogDensity, ClogThickness, ClogRatio FROM event ORDER BY event_id DESC LIMIT :limit OFFSET :offset");
-    query.bindValue(":limit", pageSize);
-    query.bindValue(":offset", page * pageSize);
+    auto query = m_statements.prepare("SELECT event_id, softwareVersion, dateBegin, dateFinish, liveTime, realTime, avgGamma_nSv, maxGamma_nSv, minGamma_nSv, avgFillCps, detectorId, background_id, calibration_id, avgCps, maxCps, minCps, e1Energy, e1Branching, e1Netcount, e2Energy, e2Branching, e2Netcount, PipeMaterial, PipeThickness, PipeDiameter, ClogMaterial, ClogDensity, ClogThickness, ClogRatio, ClogStatus FROM event ORDER BY event_id DESC LIMIT :limit OFFSET :offset");
+    query->bindValue(":limit", pageSize);
+    query->bindValue(":offset", page * pageSize);
 
-    if (!executeQuery(query, QString::asprintf("Fetching events with pagination at %d", page))) {
+    if (!executeQuery(*query, QString::asprintf("Fetching events with pagination at %d", page))) {
         // Redundant log removed: logE() << query.lastError().text();
         return events;
     }
 
-    while (query.next()) {
+    while (query->next()) {
+        auto event = std::make_shared<Event>();
+        event->setId(query->value("event_id").toLongLong());
+        event->setSoftwareVersion(query->value("softwareVersion").toString());
+        event->setStartedTime(query->value("dateBegin").toDateTime());
+        event->setFinishedTime(query->value("dateFinish").toDateTime());
+        event->setLiveTime(query->value("liveTime").toDouble());
+        event->setRealTime(query->value("realTime").toDouble());
+        event->setAvgGamma_nSv(query->value("avgGamma_nSv").toDouble());
+        event->setMaxGamma_nSv(query->value("maxGamma_nSv").toDouble());
+        event->setMinGamma_nSv(query->value("minGamma_nSv").toDouble());
+        event->setAvgFillCps(query->value("avgFillCps").toDouble());
+        event->setDetectorId(query->value("detectorId").toLongLong());
+        event->setBackgroundId(query->value("background_id").toLongLong());
+        event->setCalibrationId(query->value("calibration_id").toLongLong());
+        event->setAvgCps(query->value("avgCps").toDouble());
+        event->setMaxCps(query->value("maxCps").toDouble());
+        event->setMinCps(query->value("minCps").toDouble());
+        event->setE1Energy(query->value("e1Energy").toDouble());
+        event->setE1Branching(query->value("e1Branching").toDouble());
+        event->setE1Netcount(query->value("e1Netcount").toDouble());
+        event->setE2Energy(query->value("e2Energy").toDouble());
+        event->setE2Branching(query->value("e2Branching").toDouble());
+        event->setE2Netcount(query->value("e2Netcount").toDouble());
+        event->setPipeMaterial(query->value("PipeMaterial").toString());
+        event->setPipeThickness(query->value("PipeThickness").toDouble());
+        event->setPipeDiameter(query->value("PipeDiameter").toDouble());
+        event->setClogMaterial(query->value("ClogMaterial").toString());
+        event->setClogDensity(query->value("ClogDensity").toDouble());
+        event->setClogThickness(query->value("ClogThickness").toDouble());
+        event->setClogRatio(query->value("ClogRatio").toDouble());
+        event->setClogStatus(static_cast<Event::ClogStatus>(query->value("ClogStatus").toInt()));
+        events.push_back(event);
+    }
+
+    return events;
+}
+
+QVector<std::shared_ptr<Event>> DatabaseManager::getEventSummaries(qlonglong beforeId, int pageSize)
+{
+    return getEventSummaries(m_statements, beforeId, pageSize);
+}
+
+QVector<std::shared_ptr<Event>> DatabaseManager::getEventSummaries(SqlStatementCache& db, qlonglong beforeId,
+                                                                   int pageSize)
+{
+    QVector<std::shared_ptr<Event>> events;
+    // Walks the primary key from beforeId down, the cost doesn't grow with the depth of the page
+    auto query = db.prepare("SELECT event_id, dateBegin, ClogThickness, ClogStatus FROM event WHERE event_id < :beforeId "
+                            "ORDER BY event_id DESC LIMIT :limit");
+    query->bindValue(":beforeId", beforeId);
+    query->bindValue(":limit", pageSize);
+
+    if (!executeQuery(*query, "Fetching event summaries")) {
+        return events;
+    }
+
+    events.reserve(pageSize);
+    while (query->next()) {
         auto event = std::make_shared<Event>();
-        event->setId(query.value("event_id").toLongLong());
-        event->setSoftwareVersion(query.value("softwareVersion").toString());
-        event->setStartedTime(query.value("dateBegin").toDateTime());
-        event->setFinishedTime(query.value("dateFinish").toDateTime());
-        event->setLiveTime(query.value("liveTime").toDouble());
-        event->setRealTime(query.value("realTime").toDouble());
-        event->setAvgGamma_nSv(query.value("avgGamma_nSv").toDouble());
-        event->setMaxGamma_nSv(query.value("maxGamma_nSv").toDouble());
-        event->setMinGamma_nSv(query.value("minGamma_nSv").toDouble());
-        event->setAvgFillCps(query.value("avgFillCps").toDouble());
-        event->setDetectorId(query.value("detectorId").toLongLong());
-        event->setBackgroundId(query.value("background_id").toLongLong());
-        event->setCalibrationId(query.value("calibration_id").toLongLong());
-        event->setAvgCps(query.value("avgCps").toDouble());
-        event->setMaxCps(query.value("maxCps").toDouble());
-        event->setMinCps(query.value("minCps").toDouble());
-        event->setE1Energy(query.value("e1Energy").toDouble());
-        event->setE1Branching(query.value("e1Branching").toDouble());
-        event->setE1Netcount(query.value("e1Netcount").toDouble());
-        event->setE2Energy(query.value("e2Energy").toDouble());
-        event->setE2Branching(query.value("e2Branching").toDouble());
-        event->setE2Netcount(query.value("e2Netcount").toDouble());
-        event->setPipeMaterial(query.value("PipeMaterial").toString());
-        event->setPipeThickness(query.value("PipeThickness").toDouble());
-        event->setPipeDiameter(query.value("PipeDiameter").toDouble());
-        event->setClogMaterial(query.value("ClogMaterial").toString());
-        event->setClogDensity(query.value("ClogDensity").toDouble());
-        event->setClogThickness(query.value("ClogThickness").toDouble());
-        event->setClogRatio(query.value("ClogRatio").toDouble());
+        event->setId(query->value(0).toLongLong());
+        event->setStartedTime(query->value(1).toDateTime());
+        event->setClogThickness(query->value(2).toDouble());
+        event->setClogStatus(static_cast<Event::ClogStatus>(query->value(3).toInt()));
         events.push_back(event);
     }
 
     return events;
 }
 
+void DatabaseManager::getEventSummariesAsync(qlonglong beforeId, int pageSize, QObject* context, EventsCallback done)
+{
+    if (!m_reader) {
+        done(getEventSummaries(beforeId, pageSize));
+        return;
+    }
+
+    auto events = std::make_shared<QVector<std::shared_ptr<Event>>>();
+    auto job    = [this, events, beforeId, pageSize](SqlStatementCache& db) -> qlonglong {
+        *events = getEventSummaries(db, beforeId, pageSize);
+        return events->size();
+    };
+    m_reader->enqueue(job, context, [events, done](qlonglong) { done(std::move(*events)); });
+}
+
+qlonglong DatabaseManager::getEventCursor(int index)
+{
+    if (index <= 0) return FIRST_EVENT_PAGE;
+
+    // Id of the event just before row index, an index-only scan of the primary key
+    auto query = m_statements.prepare("SELECT event_id FROM event ORDER BY event_id DESC LIMIT 1 OFFSET :offset");
+    query->bindValue(":offset", index - 1);
+
+    if (executeQuery(*query, "Fetching event cursor") && query->next()) {
+        return query->value(0).toLongLong();
+    }
+    return 0; // Past the end, ids start at 1
+}
+
 std::shared_ptr<Event> DatabaseManager::getEventDetails(int id)
 {
-    QSqlQuery query(m_database);
-    query.prepare("SELECT event_id, softwareVersion, dateBegin, dateFinish, liveTime, realTime, avgGamma_nSv, maxGamma_nSv, minGamma_nSv, avgFillCps, detectorId, background_id, calibration_id, avgCps, maxCps, minCps, e1Energy, e1Branching, e1Netcount, e2Energy, e2Branching, e2Netcount, PipeMaterial, PipeThickness, PipeDiameter, ClogMaterial, ClogDensity, ClogThickness, ClogRatio FROM event WHERE event_id = :id");
-    query.bindValue(":id", id);
+    auto query = m_statements.prepare("SELECT event_id, softwareVersion, dateBegin, dateFinish, liveTime, realTime, avgGamma_nSv, maxGamma_nSv, minGamma_nSv, avgFillCps, detectorId, background_id, calibration_id, avgCps, maxCps, minCps, e1Energy, e1Branching, e1Netcount, e2Energy, e2Branching, e2Netcount, PipeMaterial, PipeThickness, PipeDiameter, ClogMaterial, ClogDensity, ClogThickness, ClogRatio, ClogStatus FROM event WHERE event_id = :id");
+    query->bindValue(":id", id);
 
-    if (!executeQuery(query, "Fetching event details by ID")) {
+    if (!executeQuery(*query, "Fetching event details by ID")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
-    if (query.next()) {
+    if (query->next()) {
         auto event = std::make_shared<Event>();
-        event->setId(query.value("event_id").toLongLong());
-        event->setSoftwareVersion(query.value("softwareVersion").toString());
-        event->setStartedTime(query.value("dateBegin").toDateTime());
-        event->setFinishedTime(query.value("dateFinish").toDateTime());
-        event->setLiveTime(query.value("liveTime").toDouble());
-        event->setRealTime(query.value("realTime").toDouble());
-        event->setAvgGamma_nSv(query.value("avgGamma_nSv").toDouble());
-        event->setMaxGamma_nSv(query.value("maxGamma_nSv").toDouble());
-        event->setMinGamma_nSv(query.value("minGamma_nSv").toDouble());
-        event->setAvgFillCps(query.value("avgFillCps").toDouble());
-        event->setDetectorId(query.value("detectorId").toLongLong());
-        event->setBackgroundId(query.value("background_id").toLongLong());
-        event->setCalibrationId(query.value("calibration_id").toLongLong());
-        event->setAvgCps(query.value("avgCps").toDouble());
-        event->setMaxCps(query.value("maxCps").toDouble());
-        event->setMinCps(query.value("minCps").toDouble());
-        event->setE1Energy(query.value("e1Energy").toDouble());
-        event->setE1Branching(query.value("e1Branching").toDouble());
-        event->setE1Netcount(query.value("e1Netcount").toDouble());
-        event->setE2Energy(query.value("e2Energy").toDouble());
-        event->setE2Branching(query.value("e2Branching").toDouble());
-        event->setE2Netcount(query.value("e2Netcount").toDouble());
-        event->setPipeMaterial(query.value("PipeMaterial").toString());
-        event->setPipeThickness(query.value("PipeThickness").toDouble());
-        event->setPipeDiameter(query.value("PipeDiameter").toDouble());
-        event->setClogMaterial(query.value("ClogMaterial").toString());
-        event->setClogDensity(query.value("ClogDensity").toDouble());
-        event->setClogThickness(query.value("ClogThickness").toDouble());
-        event->setClogRatio(query.value("ClogRatio").toDouble());
+        event->setId(query->value("event_id").toLongLong());
+        event->setSoftwareVersion(query->value("softwareVersion").toString());
+        event->setStartedTime(query->value("dateBegin").toDateTime());
+        event->setFinishedTime(query->value("dateFinish").toDateTime());
+        event->setLiveTime(query->value("liveTime").toDouble());
+        event->setRealTime(query->value("realTime").toDouble());
+        event->setAvgGamma_nSv(query->value("avgGamma_nSv").toDouble());
+        event->setMaxGamma_nSv(query->value("maxGamma_nSv").toDouble());
+        event->setMinGamma_nSv(query->value("minGamma_nSv").toDouble());
+        event->setAvgFillCps(query->value("avgFillCps").toDouble());
+        event->setDetectorId(query->value("detectorId").toLongLong());
+        event->setBackgroundId(query->value("background_id").toLongLong());
+        event->setCalibrationId(query->value("calibration_id").toLongLong());
+        event->setAvgCps(query->value("avgCps").toDouble());
+        event->setMaxCps(query->value("maxCps").toDouble());
+        event->setMinCps(query->value("minCps").toDouble());
+        event->setE1Energy(query->value("e1Energy").toDouble());
+        event->setE1Branching(query->value("e1Branching").toDouble());
+        event->setE1Netcount(query->value("e1Netcount").toDouble());
+        event->setE2Energy(query->value("e2Energy").toDouble());
+        event->setE2Branching(query->value("e2Branching").toDouble());
+        event->setE2Netcount(query->value("e2Netcount").toDouble());
+        event->setPipeMaterial(query->value("PipeMaterial").toString());
+        event->setPipeThickness(query->value("PipeThickness").toDouble());
+        event->setPipeDiameter(query->value("PipeDiameter").toDouble());
+        event->setClogMaterial(query->value("ClogMaterial").toString());
+        event->setClogDensity(query->value("ClogDensity").toDouble());
+        event->setClogThickness(query->value("ClogThickness").toDouble());
+        event->setClogRatio(query->value("ClogRatio").toDouble());
+        event->setClogStatus(static_cast<Event::ClogStatus>(query->value("ClogStatus").toInt()));
         return event;
     }
 
@@ -541,27 +946,26 @@ std::shared_ptr<Event> DatabaseManager::getEventDetails(int id)
 std::shared_ptr<DetectorCalibConfig> DatabaseManager::getDefaultDetectorConfig(const int detId)
 {
     QString cmd = "SELECT * FROM detector_config WHERE detectorId = :detId OR detectorId = 0 ORDER BY id LIMIT 1";
-    QSqlQuery query(m_database);
-    query.prepare(cmd);
-    query.bindValue(":detId", detId);
-    if (!executeQuery(query, "Fetching default detector config")) {
+    auto query = m_statements.prepare(cmd);
+    query->bindValue(":detId", detId);
+    if (!executeQuery(*query, "Fetching default detector config")) {
         // Redundant log removed: logE() << query.lastError().text();
         return nullptr;
     }
 
-    if (query.next()) {
+    if (query->next()) {
 
         auto pRet = std::make_shared<DetectorCalibConfig>();
         pRet->detectorId = detId;
-        if (!query.next()) {
+        if (!query->next()) {
             pRet->calib = {13, 372, 860};
             return pRet;
         }
 
         pRet->calib = {
-            query.value("chPeakA").toDouble(),
-            query.value("chPeakB").toDouble(),
-            query.value("chPeakC").toDouble()
+            query->value("chPeakA").toDouble(),
+            query->value("chPeakB").toDouble(),
+            query->value("chPeakC").toDouble()
         };
 
         return pRet;
@@ -573,130 +977,212 @@ std::shared_ptr<DetectorCalibConfig> DatabaseManager::getDefaultDetectorConfig(c
 // Insert functions
 int DatabaseManager::insertDetector(const DetectorInfo* detector)
 {
-    QSqlQuery query(m_database);
-    query.prepare("INSERT INTO detector (manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType) "
+    auto query = m_statements.prepare("INSERT INTO detector (manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, crystalType) "
                  "VALUES (:manufacturer, :instrumentModel, :serialNumber, :detectorType, :probeType, :detectorCode, :crystalType)");
-    query.bindValue(":manufacturer", detector->manufacture);
-    query.bindValue(":instrumentModel", detector->model);
-    query.bindValue(":serialNumber", detector->serialNumber);
-    query.bindValue(":detectorType", detector->detectorType);
-    query.bindValue(":probeType", detector->probeType);
-    query.bindValue(":detectorCode", static_cast<int>(detector->detectorCode->code));
-    query.bindValue(":crystalType", static_cast<int>(detector->detectorCode->cType));
-
-    if (!executeQuery(query, "Inserting new detector")) {
+    query->bindValue(":manufacturer", detector->manufacture);
+    query->bindValue(":instrumentModel", detector->model);
+    query->bindValue(":serialNumber", detector->serialNumber);
+    query->bindValue(":detectorType", detector->detectorType);
+    query->bindValue(":probeType", detector->probeType);
+    query->bindValue(":detectorCode", static_cast<int>(detector->detectorCode->code));
+    query->bindValue(":crystalType", static_cast<int>(detector->detectorCode->cType));
+
+    if (!executeQuery(*query, "Inserting new detector")) {
         // Redundant log removed: logE() << query.lastError().text();
         return -1; // Indicate failure
     }
-    return query.lastInsertId().toInt();
+    return query->lastInsertId().toInt();
 }
 
 int DatabaseManager::insertBackground(const Background* background)
 {
-    QSqlQuery query(m_database);
-    query.prepare("INSERT INTO background (spectrum, acqTime, realTime, detectorId, date) "
+    return static_cast<int>(insertBackground(m_statements, background));
+}
+
+qlonglong DatabaseManager::insertBackground(SqlStatementCache& db, const Background* background)
+{
+    auto query = db.prepare("INSERT INTO background (spectrum, acqTime, realTime, detectorId, date) "
                  "VALUES (:spectrum, :acqTime, :realTime, :detectorId, :date)");
 
     QByteArray spectrumData;
     if (background->spc) {
-        spectrumData = background->spc->toString().toUtf8(); // Use Spectrum::toString()
+        spectrumData = SpectrumCodec::encode(*background->spc);
     }
 
-    query.bindValue(":spectrum", spectrumData);
-    query.bindValue(":acqTime", background->spc ? static_cast<int>(background->spc->getAcqTime()) : 0); // acqTime is INTEGER
-    query.bindValue(":realTime", background->spc ? background->spc->getRealTime() : 0.0);
-    query.bindValue(":detectorId", background->spc ? background->spc->getDetectorID() : -1);
-    query.bindValue(":date", background->date);
+    query->bindValue(":spectrum", spectrumData);
+    query->bindValue(":acqTime", background->spc ? static_cast<int>(background->spc->getAcqTime()) : 0); // acqTime is INTEGER
+    query->bindValue(":realTime", background->spc ? background->spc->getRealTime() : 0.0);
+    query->bindValue(":detectorId", background->spc ? background->spc->getDetectorID() : -1);
+    query->bindValue(":date", background->date);
 
-    if (!executeQuery(query, "Inserting new background")) {
+    if (!executeQuery(*query, "Inserting new background")) {
         // Redundant log removed: logE() << query.lastError().text();
         return -1;
     }
-    return query.lastInsertId().toInt();
+    return query->lastInsertId().toLongLong();
 }
 
 int DatabaseManager::insertCalibration(const Calibration* calibration)
 {
-    QSqlQuery query(m_database);
-    query.prepare("INSERT INTO calibration (detector_id, coef_a, coef_b, coef_c, gc, ratio, chpeak_a, chpeak_b, chpeak_c, time, temperature, spectrum) "
+    return static_cast<int>(insertCalibration(m_statements, calibration));
+}
+
+qlonglong DatabaseManager::insertCalibration(SqlStatementCache& db, const Calibration* calibration)
+{
+    auto query = db.prepare("INSERT INTO calibration (detector_id, coef_a, coef_b, coef_c, gc, ratio, chpeak_a, chpeak_b, chpeak_c, time, temperature, spectrum) "
                  "VALUES (:detector_id, :coef_a, :coef_b, :coef_c, :gc, :ratio, :chpeak_a, :chpeak_b, :chpeak_c, :time, :temperature, :spectrum)");
 
-    query.bindValue(":detector_id", calibration->getDetectorId());
-    query.bindValue(":coef_a", calibration->coefficients()[0]);
-    query.bindValue(":coef_b", calibration->coefficients()[1]);
-    query.bindValue(":coef_c", calibration->coefficients()[2]);
-    query.bindValue(":gc", calibration->getGC());
-    query.bindValue(":ratio", calibration->getRatio());
-    query.bindValue(":chpeak_a", calibration->chCoefficients()[0]); // Assuming chCoefficients maps to chpeak_a,b,c
-    query.bindValue(":chpeak_b", calibration->chCoefficients()[1]);
-    query.bindValue(":chpeak_c", calibration->chCoefficients()[2]);
-    query.bindValue(":time", calibration->getDate().toString(Qt::ISODate)); // 'time' in schema maps to 'date' in model
-    query.bindValue(":temperature", calibration->temperature());
+    query->bindValue(":detector_id", calibration->getDetectorId());
+    query->bindValue(":coef_a", calibration->coefficients()[0]);
+    query->bindValue(":coef_b", calibration->coefficients()[1]);
+    query->bindValue(":coef_c", calibration->coefficients()[2]);
+    query->bindValue(":gc", calibration->getGC());
+    query->bindValue(":ratio", calibration->getRatio());
+    query->bindValue(":chpeak_a", calibration->chCoefficients()[0]); // Assuming chCoefficients maps to chpeak_a,b,c
+    query->bindValue(":chpeak_b", calibration->chCoefficients()[1]);
+    query->bindValue(":chpeak_c", calibration->chCoefficients()[2]);
+    query->bindValue(":time", calibration->getDate().toString(Qt::ISODate)); // 'time' in schema maps to 'date' in model
+    query->bindValue(":temperature", calibration->temperature());
 
 
-    auto spectrumData = calibration->spc() ? calibration->spc()->toString() : "";
-    query.bindValue(":spectrum", spectrumData);
+    QByteArray spectrumData;
+    if (calibration->spc()) {
+        spectrumData = SpectrumCodec::encode(*calibration->spc());
+    }
+    query->bindValue(":spectrum", spectrumData);
 
-    if (!executeQuery(query, "Inserting new calibration")) {
+    if (!executeQuery(*query, "Inserting new calibration")) {
         return -1;
     }
-    return query.lastInsertId().toInt();
+    return query->lastInsertId().toLongLong();
 }
 
 qlonglong DatabaseManager::insertEvent(const Event* event)
 {
-    QSqlQuery query(m_database);
-    query.prepare("INSERT INTO event (softwareVersion, dateBegin, dateFinish, liveTime, realTime, avgGamma_nSv, maxGamma_nSv, minGamma_nSv, avgFillCps, detectorId, background_id, calibration_id, avgCps, maxCps, minCps, e1Energy, e1Branching, e1Netcount, e2Energy, e2Branching, e2Netcount, PipeMaterial, PipeThickness, PipeDiameter, ClogMaterial, ClogDensity, ClogThickness, ClogRatio) "
-                 "VALUES (:softwareVersion, :dateBegin, :dateFinish, :liveTime, :realTime, :avgGamma_nSv, :maxGamma_nSv, :minGamma_nSv, :avgFillCps, :detectorId, :background_id, :calibration_id, :avgCps, :maxCps, :minCps, :e1Energy, :e1Branching, :e1Netcount, :e2Energy, :e2Branching, :e2Netcount, :PipeMaterial, :PipeThickness, :PipeDiameter, :ClogMaterial, :ClogDensity, :ClogThickness, :ClogRatio)");
-
-    query.bindValue(":softwareVersion", event->getSoftwareVersion());
-    query.bindValue(":dateBegin", event->getStartedTime());
-    query.bindValue(":dateFinish", event->getFinishedTime());
-    query.bindValue(":liveTime", event->getLiveTime());
-    query.bindValue(":realTime", event->getRealTime());
-    query.bindValue(":avgGamma_nSv", event->getAvgGamma_nSv());
-    query.bindValue(":maxGamma_nSv", event->getMaxGamma_nSv());
-    query.bindValue(":minGamma_nSv", event->getMinGamma_nSv());
-    query.bindValue(":avgFillCps", event->getAvgFillCps());
-    query.bindValue(":detectorId", static_cast<qlonglong>(event->getDetectorId()));
-    query.bindValue(":background_id", static_cast<qlonglong>(event->getBackgroundId()));
-    query.bindValue(":calibration_id", static_cast<qlonglong>(event->getCalibrationId()));
-    query.bindValue(":avgCps", event->getAvgCps());
-    query.bindValue(":maxCps", event->getMaxCps());
-    query.bindValue(":minCps", event->getMinCps());
-    query.bindValue(":e1Energy", event->getE1Energy());
-    query.bindValue(":e1Branching", event->getE1Branching());
-    query.bindValue(":e1Netcount", event->getE1Netcount());
-    query.bindValue(":e2Energy", event->getE2Energy());
-    query.bindValue(":e2Branching", event->getE2Branching());
-    query.bindValue(":e2Netcount", event->getE2Netcount());
-    query.bindValue(":PipeMaterial", event->getPipeMaterial());
-    query.bindValue(":PipeThickness", event->getPipeThickness());
-    query.bindValue(":PipeDiameter", event->getPipeDiameter());
-    query.bindValue(":ClogMaterial", event->getClogMaterial());
-    query.bindValue(":ClogDensity", event->getClogDensity());
-    query.bindValue(":ClogThickness", event->getClogThickness());
-    query.bindValue(":ClogRatio", event->getClogRatio());
-
-    if (!executeQuery(query, "Inserting new event")) {
+    // Through the writer like insertEventAsync(), so the counters see every insert in commit order
+    const qlonglong detectorId = event->getDetectorId();
+    const QDate day            = event->getStartedTime().date();
+    auto job       = [this, event](SqlStatementCache& db) { return insertEvent(db, event); };
+    auto committed = [this, detectorId, day](qlonglong id) { countEvent(id, detectorId, day); };
+    return enqueueWrite(job, nullptr, WriteCallback(), committed).get();
+}
+
+qlonglong DatabaseManager::insertEvent(SqlStatementCache& db, const Event* event)
+{
+    auto query = db.prepare("INSERT INTO event (softwareVersion, dateBegin, dateFinish, liveTime, realTime, avgGamma_nSv, maxGamma_nSv, minGamma_nSv, avgFillCps, detectorId, background_id, calibration_id, avgCps, maxCps, minCps, e1Energy, e1Branching, e1Netcount, e2Energy, e2Branching, e2Netcount, PipeMaterial, PipeThickness, PipeDiameter, ClogMaterial, ClogDensity, ClogThickness, ClogRatio, ClogStatus) "
+                 "VALUES (:softwareVersion, :dateBegin, :dateFinish, :liveTime, :realTime, :avgGamma_nSv, :maxGamma_nSv, :minGamma_nSv, :avgFillCps, :detectorId, :background_id, :calibration_id, :avgCps, :maxCps, :minCps, :e1Energy, :e1Branching, :e1Netcount, :e2Energy, :e2Branching, :e2Netcount, :PipeMaterial, :PipeThickness, :PipeDiameter, :ClogMaterial, :ClogDensity, :ClogThickness, :ClogRatio, :ClogStatus)");
+
+    query->bindValue(":softwareVersion", event->getSoftwareVersion());
+    query->bindValue(":dateBegin", event->getStartedTime());
+    query->bindValue(":dateFinish", event->getFinishedTime());
+    query->bindValue(":liveTime", event->getLiveTime());
+    query->bindValue(":realTime", event->getRealTime());
+    query->bindValue(":avgGamma_nSv", event->getAvgGamma_nSv());
+    query->bindValue(":maxGamma_nSv", event->getMaxGamma_nSv());
+    query->bindValue(":minGamma_nSv", event->getMinGamma_nSv());
+    query->bindValue(":avgFillCps", event->getAvgFillCps());
+    query->bindValue(":detectorId", static_cast<qlonglong>(event->getDetectorId()));
+    query->bindValue(":background_id", static_cast<qlonglong>(event->getBackgroundId()));
+    query->bindValue(":calibration_id", static_cast<qlonglong>(event->getCalibrationId()));
+    query->bindValue(":avgCps", event->getAvgCps());
+    query->bindValue(":maxCps", event->getMaxCps());
+    query->bindValue(":minCps", event->getMinCps());
+    query->bindValue(":e1Energy", event->getE1Energy());
+    query->bindValue(":e1Branching", event->getE1Branching());
+    query->bindValue(":e1Netcount", event->getE1Netcount());
+    query->bindValue(":e2Energy", event->getE2Energy());
+    query->bindValue(":e2Branching", event->getE2Branching());
+    query->bindValue(":e2Netcount", event->getE2Netcount());
+    query->bindValue(":PipeMaterial", event->getPipeMaterial());
+    query->bindValue(":PipeThickness", event->getPipeThickness());
+    query->bindValue(":PipeDiameter", event->getPipeDiameter());
+    query->bindValue(":ClogMaterial", event->getClogMaterial());
+    query->bindValue(":ClogDensity", event->getClogDensity());
+    query->bindValue(":ClogThickness", event->getClogThickness());
+    query->bindValue(":ClogRatio", event->getClogRatio());
+    query->bindValue(":ClogStatus", static_cast<int>(event->getClogStatus()));
+
+    if (!executeQuery(*query, "Inserting new event")) {
         // Redundant log removed: logE() << query.lastError().text();
         return -1;
     }
-    return query.lastInsertId().toLongLong();
+    const qlonglong eventId = query->lastInsertId().toLongLong();
+
+    if (!updateEventStats(db, event)) {
+        // Recounted by the next rebuild, the event itself is kept
+        logW() << "Event" << eventId << "not counted in event_stats";
+    }
+    return eventId;
 }
 
-qlonglong DatabaseManager::insertEventDetail(qlonglong eventId, const QString& spectrumData)
+bool DatabaseManager::updateEventStats(SqlStatementCache& db, const Event* event)
 {
-    QSqlQuery query(m_database);
-    query.prepare("INSERT INTO event_detail (event_id, spectrum) VALUES (:event_id, :spectrum)");
-    query.bindValue(":event_id", eventId);
-    query.bindValue(":spectrum", spectrumData);
+    const qlonglong detectorId = event->getDetectorId();
+    const QString day          = statsDay(event->getStartedTime());
+
+    auto insert = db.prepare("INSERT OR IGNORE INTO event_stats (detectorId, day, count) "
+                             "VALUES (:detectorId, :day, 0)");
+    insert->bindValue(":detectorId", detectorId);
+    insert->bindValue(":day", day);
+    if (!executeQuery(*insert, "Adding event stats row")) {
+        return false;
+    }
+
+    auto update = db.prepare("UPDATE event_stats SET count = count + 1 WHERE detectorId = :detectorId AND day = :day");
+    update->bindValue(":detectorId", detectorId);
+    update->bindValue(":day", day);
+    return executeQuery(*update, "Counting event");
+}
 
-    if (!executeQuery(query, "Inserting event detail")) {
+qlonglong DatabaseManager::insertEventDetail(qlonglong eventId, const QByteArray& spectrumData)
+{
+    return insertEventDetail(m_statements, eventId, spectrumData);
+}
+
+qlonglong DatabaseManager::insertEventDetail(SqlStatementCache& db, qlonglong eventId, const QByteArray& spectrumData)
+{
+    auto query = db.prepare("INSERT INTO event_detail (event_id, spectrum) VALUES (:event_id, :spectrum)");
+    query->bindValue(":event_id", eventId);
+    query->bindValue(":spectrum", spectrumData);
+
+    if (!executeQuery(*query, "Inserting event detail")) {
         // executeQuery already logs the error
         return -1;
     }
-    return query.lastInsertId().toLongLong();
+    return query->lastInsertId().toLongLong();
+}
+
+std::shared_future<qlonglong> DatabaseManager::insertEventAsync(std::shared_ptr<const Event> event,
+                                                               const QByteArray& spectrumData, QObject* context,
+                                                               WriteCallback done)
+{
+    // Event and spectrum land in the same transaction, failing the job rolls back both
+    auto job = [this, event, spectrumData](SqlStatementCache& db) -> qlonglong {
+        qlonglong eventId = insertEvent(db, event.get());
+        if (eventId > 0 && !spectrumData.isEmpty() && insertEventDetail(db, eventId, spectrumData) < 0) {
+            return -1;
+        }
+        return eventId;
+    };
+
+    const qlonglong detectorId = event->getDetectorId();
+    const QDate day            = event->getStartedTime().date();
+    auto committed             = [this, detectorId, day](qlonglong id) { countEvent(id, detectorId, day); };
+    return enqueueWrite(job, context, std::move(done), committed);
+}
+
+std::shared_future<qlonglong> DatabaseManager::insertBackgroundAsync(std::shared_ptr<const Background> background,
+                                                                    QObject* context, WriteCallback done)
+{
+    auto job = [this, background](SqlStatementCache& db) { return insertBackground(db, background.get()); };
+    return enqueueWrite(job, context, std::move(done));
+}
+
+std::shared_future<qlonglong> DatabaseManager::insertCalibrationAsync(std::shared_ptr<const Calibration> calibration,
+                                                                     QObject* context, WriteCallback done)
+{
+    auto job = [this, calibration](SqlStatementCache& db) { return insertCalibration(db, calibration.get()); };
+    return enqueueWrite(job, context, std::move(done));
 }
 
 int DatabaseManager::insertDetectorCalibConfig(const DetectorCalibConfig* config)
@@ -725,15 +1211,15 @@ int DatabaseManager::insertDetectorCalibConfig(const DetectorCalibConfig* config
     return query.lastInsertId().toInt(); // Returns the rowid of the last inserted row
 }
 
-QSqlQuery DatabaseManager::executeSingleRowQuery(const QString& queryString, const QVariantMap& bindValues)
+SqlStatementCache::Statement DatabaseManager::executeSingleRowQuery(const QString& queryString,
+                                                                   const QVariantMap& bindValues)
 {
-    QSqlQuery query(m_database);
-    query.prepare(queryString);
+    auto query = m_statements.prepare(queryString);
     for (auto it = bindValues.constBegin(); it != bindValues.constEnd(); ++it) {
-        query.bindValue(it.key(), it.value());
+        query->bindValue(it.key(), it.value());
     }
 
-    if (!executeQuery(query, queryString)) { // Using queryString as context, can be improved
+    if (!executeQuery(*query, queryString)) { // Using queryString as context, can be improved
         // Redundant log removed. Original: logE() << "SQL Query failed:" << query.lastError().text() << "Query:" << queryString;
         // executeQuery already logs the error, the context (which is the queryString here), and the bound query.
     }
@@ -742,25 +1228,30 @@ QSqlQuery DatabaseManager::executeSingleRowQuery(const QString& queryString, con
 
 std::shared_ptr<Background> DatabaseManager::getLatestBackground(int detectorId)
 {
+    // Must see a background queued just before, as when a detector is initialized again
+    flush();
     QString queryString = "SELECT id, spectrum, acqTime, realTime, detectorId, date FROM background WHERE detectorId = :detectorId ORDER BY id DESC LIMIT 1";
     QVariantMap bindValues;
     bindValues[":detectorId"] = detectorId;
 
-    QSqlQuery query = executeSingleRowQuery(queryString, bindValues); // This call doesn't need to change if executeSingleRowQuery handles executeQuery
+    auto query = executeSingleRowQuery(queryString, bindValues); // This call doesn't need to change if executeSingleRowQuery handles executeQuery
 
-    if (query.next()) {
+    if (query->next()) {
         auto background = std::make_shared<Background>();
-        background->id = query.value("id").toInt();
+        background->id = query->value("id").toInt();
 
-        QString spectrumDataStr = query.value("spectrum").toString();
-        auto spectrum = std::shared_ptr<Spectrum>(Spectrum::pFromString(spectrumDataStr));
+        auto spectrum = std::shared_ptr<Spectrum>(SpectrumCodec::pDecode<CHSIZE>(query->value("spectrum")));
+        if (!spectrum) {
+            logW() << "Spectrum data was empty or invalid for Background ID:" << background->id;
+            return nullptr;
+        }
 
-        spectrum->setAcqTime(query.value("acqTime").toInt());
-        spectrum->setRealTime(query.value("realTime").toDouble());
-        spectrum->setDetectorID(query.value("detectorId").toInt());
+        spectrum->setAcqTime(query->value("acqTime").toInt());
+        spectrum->setRealTime(query->value("realTime").toDouble());
+        spectrum->setDetectorID(query->value("detectorId").toInt());
 
         background->spc = spectrum;
-        background->date = query.value("date").toString();
+        background->date = query->value("date").toString();
         return background;
     }
 
@@ -769,34 +1260,36 @@ std::shared_ptr<Background> DatabaseManager::getLatestBackground(int detectorId)
 
 std::shared_ptr<Calibration> DatabaseManager::getLatestCalibration(int detectorId)
 {
+    // Must see a calibration queued just before, as when a detector is initialized again
+    flush();
     QString queryString = "SELECT id, detector_id, coef_a, coef_b, coef_c, gc, ratio, chpeak_a, chpeak_b, chpeak_c, time, temperature FROM calibration WHERE detector_id = :detector_id ORDER BY id DESC LIMIT 1";
     QVariantMap bindValues;
     bindValues[":detector_id"] = detectorId;
 
-    QSqlQuery query = executeSingleRowQuery(queryString, bindValues);
+    auto query = executeSingleRowQuery(queryString, bindValues);
 
-    if (query.next()) {
+    if (query->next()) {
         auto calibration = std::make_shared<Calibration>();
-        calibration->setId(query.value("id").toInt());
-        calibration->setDetectorId(query.value("detector_id").toInt());
+        calibration->setId(query->value("id").toInt());
+        calibration->setDetectorId(query->value("detector_id").toInt());
 
         Coeffcients coefficients;
-        coefficients[0] = query.value("coef_a").toDouble();
-        coefficients[1] = query.value("coef_b").toDouble();
-        coefficients[2] = query.value("coef_c").toDouble();
+        coefficients[0] = query->value("coef_a").toDouble();
+        coefficients[1] = query->value("coef_b").toDouble();
+        coefficients[2] = query->value("coef_c").toDouble();
         calibration->setCoefficients(coefficients);
 
-        calibration->setGC(query.value("gc").toInt());
-        calibration->setRatio(query.value("ratio").toDouble());
+        calibration->setGC(query->value("gc").toInt());
+        calibration->setRatio(query->value("ratio").toDouble());
 
         Coeffcients chPeaks;
-        chPeaks[0] = query.value("chpeak_a").toDouble();
-        chPeaks[1] = query.value("chpeak_b").toDouble();
-        chPeaks[2] = query.value("chpeak_c").toDouble();
+        chPeaks[0] = query->value("chpeak_a").toDouble();
+        chPeaks[1] = query->value("chpeak_b").toDouble();
+        chPeaks[2] = query->value("chpeak_c").toDouble();
         calibration->setChCoefficients(chPeaks);
 
-        calibration->setDate(nucare::Timestamp::fromString(query.value("time").toString(), Qt::ISODate));
-        calibration->setTemperature(query.value("temperature").toDouble());
+        calibration->setDate(nucare::Timestamp::fromString(query->value("time").toString(), Qt::ISODate));
+        calibration->setTemperature(query->value("temperature").toDouble());
 
         return calibration;
     }
@@ -805,35 +1298,46 @@ std::shared_ptr<Calibration> DatabaseManager::getLatestCalibration(int detectorI
 }
 
 QVariant DatabaseManager::getSetting(const QString& name, const QVariant& defaultValue) {
-    QSqlQuery query(m_database);
-    query.prepare("SELECT Value FROM setup WHERE Name = ?");
-    query.addBindValue(name);
+    flushSettings();
+    auto query = m_statements.prepare("SELECT Value FROM setup WHERE Name = ?");
+    query->addBindValue(name);
 
-    if (executeQuery(query, "Getting setting by name") && query.next()) {
-        return query.value(0);
+    if (executeQuery(*query, "Getting setting by name") && query->next()) {
+        return query->value(0);
     }
     return defaultValue;
 }
 
 void DatabaseManager::setSetting(const QString& name, const QVariant& value) {
-    QSqlQuery query(m_database);
-    query.prepare("INSERT OR REPLACE INTO setup (Name, Value) VALUES (?, ?)");
-    query.addBindValue(name);
-    query.addBindValue(value.toString());
+    m_pendingSettings.fetch_add(1, std::memory_order_release);
+    enqueueWrite([this, name, value](SqlStatementCache& db) -> qlonglong { return setSetting(db, name, value) ? 0 : -1; },
+                 nullptr, WriteCallback(),
+                 [this](qlonglong) { m_pendingSettings.fetch_sub(1, std::memory_order_release); });
+}
 
-    if (!executeQuery(query, "Saving setting: " + name)) {
-        // executeQuery logs the error, context ("Saving setting: [name]"), and the SQL.
-    }
+void DatabaseManager::flushSettings()
+{
+    // Only a setting read right after it was saved waits for the writer
+    if (m_pendingSettings.load(std::memory_order_acquire) > 0) flush();
+}
+
+bool DatabaseManager::setSetting(SqlStatementCache& db, const QString& name, const QVariant& value) {
+    auto query = db.prepare("INSERT OR REPLACE INTO setup (Name, Value) VALUES (?, ?)");
+    query->addBindValue(name);
+    query->addBindValue(value.toString());
+
+    // executeQuery logs the error, context ("Saving setting: [name]"), and the SQL.
+    return executeQuery(*query, "Saving setting: " + name);
 }
 
 QMap<QString, QVariant> DatabaseManager::getAllSettings() {
     QMap<QString, QVariant> settings;
-    QSqlQuery query(m_database); // Ensure query is associated with the database
-    query.prepare("SELECT Name, Value FROM setup");
+    flushSettings();
+    auto query = m_statements.prepare("SELECT Name, Value FROM setup");
 
-    if (executeQuery(query, "Getting all settings")) {
-        while (query.next()) {
-            settings.insert(query.value(0).toString(), query.value(1));
+    if (executeQuery(*query, "Getting all settings")) {
+        while (query->next()) {
+            settings.insert(query->value(0).toString(), query->value(1));
         }
     }
 
@@ -847,15 +1351,19 @@ int DatabaseManager::getTotalEventCount()
         return 0;
     }
 
-    QSqlQuery query(m_database);
-    query.prepare("SELECT COUNT(*) FROM event");
+    {
+        std::lock_guard<std::mutex> lock(m_countersMutex);
+        if (m_countersLoaded) return static_cast<int>(m_counters.total);
+    }
+
+    auto query = m_statements.prepare("SELECT COUNT(*) FROM event");
 
-    if (!executeQuery(query, "Getting total event count")) {
+    if (!executeQuery(*query, "Getting total event count")) {
         return 0;
     }
 
-    if (query.next()) {
-        return query.value(0).toInt();
+    if (query->next()) {
+        return query->value(0).toInt();
     }
 
     return 0;
@@ -2,10 +2,22 @@
 #define DATABASEMANAGER_H
 
 #include "component/component.h"
+#include "component/DatabaseWorker.h"
+#include "component/SqlStatementCache.h"
+#include <QByteArray>
+#include <QDate>
+#include <QHash>
+#include <QMap>
 #include <QSqlDatabase>
 #include <QObject>
 #include <QString>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 // Forward declarations for model classes
@@ -20,6 +32,20 @@ namespace nucare {
 class DatabaseManager : public QObject, public Component
 {
 public:
+    typedef std::function<void(qlonglong)> WriteCallback;
+    typedef std::function<void(QVector<std::shared_ptr<Event>>)> EventsCallback;
+
+    // Stored events, kept up to date by the inserts instead of counted
+    struct EventCounters {
+        qlonglong total = 0;
+        QHash<qlonglong, qlonglong> byDetector;
+        // Local start date of the events, an invalid date for events without one
+        QMap<QDate, qlonglong> byDay;
+    };
+
+    // beforeId of the first page of getEventSummaries()
+    static constexpr qlonglong FIRST_EVENT_PAGE = std::numeric_limits<qlonglong>::max();
+
     explicit DatabaseManager(QObject *parent = nullptr);
     ~DatabaseManager();
 
@@ -47,6 +73,16 @@ public:
 
     // Event operations
     QVector<std::shared_ptr<Event>> getEvents(int index, int pageSize);
+    /**
+     * Keyset page of the event list, newest first: the pageSize events with an id below beforeId.
+     * Only id, start time and clog thickness are loaded, getEventDetails() has the rest.
+     * @param beforeId FIRST_EVENT_PAGE or the id of the last event of the previous page
+     */
+    QVector<std::shared_ptr<Event>> getEventSummaries(qlonglong beforeId, int pageSize);
+    // getEventSummaries() on the reader connection, done runs on the thread of context
+    void getEventSummariesAsync(qlonglong beforeId, int pageSize, QObject* context, EventsCallback done);
+    // beforeId of the page starting at row index of the list, to jump there without the pages before it
+    qlonglong getEventCursor(int index);
     std::shared_ptr<Event> getEventDetails(int id);
     void loadEventDetailsInto(Event* event);
     std::shared_ptr<DetectorCalibConfig> getDefaultDetectorConfig(const int detId);
@@ -57,24 +93,106 @@ public:
     int insertCalibration(const Calibration* calibration);
     qlonglong insertEvent(const Event* event);
     int insertDetectorCalibConfig(const DetectorCalibConfig* config);
-    qlonglong insertEventDetail(qlonglong eventId, const QString& spectrumData);
+    // spectrumData is SpectrumCodec::encode() of the event spectrum
+    qlonglong insertEventDetail(qlonglong eventId, const QByteArray& spectrumData);
+
+    /**
+     * Write-behind inserts, run on the writer thread and committed together with the other writes
+     * queued at the same time. The objects must not be changed afterwards.
+     * @param context done runs on the thread of context with the new row id, -1 on failure
+     */
+    std::shared_future<qlonglong> insertEventAsync(std::shared_ptr<const Event> event, const QByteArray& spectrumData,
+                                                   QObject* context = nullptr, WriteCallback done = WriteCallback());
+    std::shared_future<qlonglong> insertBackgroundAsync(std::shared_ptr<const Background> background,
+                                                        QObject* context = nullptr, WriteCallback done = WriteCallback());
+    std::shared_future<qlonglong> insertCalibrationAsync(std::shared_ptr<const Calibration> calibration,
+                                                         QObject* context = nullptr, WriteCallback done = WriteCallback());
+
+    // Block until the queued writes are committed. Reads of this connection see the last commit and
+    // don't wait, except the few that must read back a write queued just before
+    void flush();
 
     // Settings operations
     QVariant getSetting(const QString& name, const QVariant& defaultValue = QVariant());
+    // Queued on the writer thread
     void setSetting(const QString& name, const QVariant& value);
     QMap<QString, QVariant> getAllSettings();
+    // From the event counters (committed events), COUNT(*) until they are loaded
     int getTotalEventCount();
+    // Snapshot of the counters, empty until they are loaded after the migration
+    EventCounters getEventCounters();
 
 private:
     QSqlDatabase m_database;
+    SqlStatementCache m_statements; // Of m_database
     QString m_dataDirPath;
 
+    QThread m_writerThread;
+    DatabaseWorker* m_writer = nullptr;
+    // Prefetching reads, see getEventSummariesAsync()
+    QThread m_readerThread;
+    DatabaseWorker* m_reader = nullptr;
+
+    // Progress of the spectrum migration, see migrateSpectraStep()
+    int m_migrationTable        = 0;
+    qlonglong m_migrationLastId = 0;
+    int m_migrationFailures     = 0; // Rows left as text, SCHEMA_BLOB_SPECTRA is not saved then
+
+    // Loaded from event_stats, then only changed by the writer once an insert is committed
+    std::mutex m_countersMutex;
+    EventCounters m_counters;
+    bool m_countersLoaded = false;
+    // setSetting() writes not committed yet, getSetting() waits for them
+    std::atomic<int> m_pendingSettings{0};
+
     // Helper for executing queries and fetching a single row
-    QSqlQuery executeSingleRowQuery(const QString& queryString, const QVariantMap& bindValues);
+    SqlStatementCache::Statement executeSingleRowQuery(const QString& queryString, const QVariantMap& bindValues);
     bool executeQuery(QSqlQuery& query, const QString& context);
 
     bool deployDatabase(const QString& sourcePath, const QString& destinationPath);
     bool createTablesIfNotExist();
+    // Columns added to an existing table after its first release
+    bool addColumnIfMissing(const QString& table, const QString& column, const QString& definition);
+    // WAL journal, synchronous=NORMAL and page cache of a connection
+    void configureConnection(QSqlDatabase& db);
+    // Indexes of the lookups by detector and event, schema version 2
+    bool createIndexes();
+
+    typedef std::function<qlonglong(SqlStatementCache&)> WriteJob;
+
+    DatabaseWorker* startWorker(QThread& thread, const QString& name, DatabaseWorker::Access access,
+                                const QString& path);
+    void stopWorker(DatabaseWorker*& worker, QThread& thread);
+    void flushSettings();
+    // Queue job on the writer, runs it right away when there is none
+    std::shared_future<qlonglong> enqueueWrite(WriteJob job, QObject* context = nullptr,
+                                               WriteCallback done = WriteCallback(),
+                                               WriteCallback committed = WriteCallback());
+
+    // Inserts on a given connection, shared by the synchronous calls and the writer jobs
+    qlonglong insertBackground(SqlStatementCache& db, const Background* background);
+    qlonglong insertCalibration(SqlStatementCache& db, const Calibration* calibration);
+    // Also counts the event in event_stats, in the same transaction
+    qlonglong insertEvent(SqlStatementCache& db, const Event* event);
+    bool updateEventStats(SqlStatementCache& db, const Event* event);
+    qlonglong insertEventDetail(SqlStatementCache& db, qlonglong eventId, const QByteArray& spectrumData);
+    bool setSetting(SqlStatementCache& db, const QString& name, const QVariant& value);
+    QVector<std::shared_ptr<Event>> getEventSummaries(SqlStatementCache& db, qlonglong beforeId, int pageSize);
+
+    // Schema version kept in PRAGMA user_version
+    int schemaVersion();
+    void setSchemaVersion(int version);
+    // Bring an older database up to the current schema, the slow steps continue from the event loop
+    void migrate();
+    // Convert one batch of legacy TEXT spectra to SpectrumCodec blobs and schedule the next one
+    void migrateSpectraStep();
+    // Fill event_stats from the event table, schema version 3
+    bool rebuildEventStats();
+
+    // Read event_stats into m_counters on the writer, behind the writes queued before
+    void loadEventCounters();
+    // Committed hook of an event insert
+    void countEvent(qlonglong eventId, qlonglong detectorId, const QDate& day);
 };
 
 } // namespace nucare
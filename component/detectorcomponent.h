@@ -4,14 +4,15 @@
 #include "component/component.h"
 #include "model/Spectrum.h" // Include Spectrum_t definition
 #include "model/DetectorModels.h" // Include DetectorModels.h for GcResponse and DetectorPackage
-#include <QSerialPort>
 #include <QByteArray>
-#include <QTimer>
+#include <QElapsedTimer>
+#include <QThread>
 #include <memory> // For std::shared_ptr
 
 namespace nucare {
 
 class DetectorProperty;
+class DetectorIoWorker;
 
 class DetectorComponent : public QObject, public Component
 {
@@ -27,60 +28,43 @@ public:
     void stop();
     auto properties() const { return m_properties; }
 
-    bool openSerialPort(const QString &portName, int baudRate);
-    void closeSerialPort();
-    void clearSerialBuffer();
-
-    void sendCommand(const QByteArray &command);
     void nativeSend(const QByteArray& command);
 
     void initialize();
     void sendUpdateCalib(const int ch32, const int ch662, const int chK40);
     void sendPowerOff();
 
+    // Raw serial stream capture and replay, see DetectorCapture.h
+    void startCapture(const QString& path);
+    void stopCapture();
+    void replay(const QString& path, bool realtime = true);
+
+    // Handoff statistics of the serial I/O thread
+    size_t queueDepth() const;
+    quint64 droppedPackages() const;
+
 signals:
     void detectorInfoReceived(DetectorComponent* dev, std::shared_ptr<GcResponse> info);
     void packageReceived(DetectorComponent* dev, std::shared_ptr<DetectorPackage> packageData);
     void detectorInitialized();
     void errorOccurred(const QString &errorMessage);
+    void replayFinished();
 
 private slots:
-    void readData();
-    void handleTimeout();
-    void handleError(QSerialPort::SerialPortError error);
+    void onPackagesAvailable();
+    void onInfoTimedOut();
+    void onReplayFinished(quint64 packages, qint64 elapsedMs);
 
 private:
-    QSerialPort *m_serialPort;
-    QByteArray m_readBuffer;
-    QTimer m_responseTimer;
-    QByteArray m_currentCommand;
-    int m_retryCount;
-
-    enum CommandState {
-        Idle,
-        SendingStop,
-        WaitingForStopResponse,
-        SendingGetInfo,
-        WaitingForInfoResponse,
-        SendingStart,
-        WaitingForStartResponse,
-        ReceivingPackage
-    };
-
-    CommandState m_commandState;
-
-    // Optimized package buffer for accumulation
-    char m_packageBuffer[4166];
-    int m_packageBytes = 0;
-
-    void processReceivedData();
-    void processDetectorInfo(const QByteArray &data);
-    void processPackageData(const QByteArray &data);
-    void startCommandFlow();
-    void sendStopCommand();
-    void sendGetInfoCommand();
-    void sendStartCommand();
+    // Serial link runs on its own thread so a busy GUI thread can't stall the detector
+    QThread m_ioThread;
+    DetectorIoWorker* m_worker;
+
+    // End-to-end throughput of a replay, measured where packages leave this component
+    QElapsedTimer m_replayClock;
+    quint64 m_replayDelivered = 0;
 
+    void processDetectorInfo(const QByteArray &data);
 };
 
 } // namespace nucare
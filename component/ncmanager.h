@@ -7,8 +7,16 @@
 #include "model/Calibration.h"
 #include "model/Types.h"
 #include "model/ndt_model.h"
+#include "util/ObjectPool.h"
+#include <QThreadPool>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
 
-namespace nucare { class DetectorComponent; }
+namespace nucare {
+class DetectorComponent;
+class AnalysisContext;
+}
 class DetectorPackage;
 class Calibration;
 
@@ -25,8 +33,29 @@ public:
                                 std::shared_ptr<HwSpectrum> hwSpc,
                                 Calibration::Mode mode = Calibration::HH300_CS_137,
                                 bool updateStdPeaks = false);
+    // @throws NcException when the thickness can't be estimated, it is never NaN
     ClogEstimation estimateClog(std::shared_ptr<Spectrum> spc, nucare::DetectorComponent* dev);
 
+    /**
+     * Run the clog estimation of spc on a worker thread. The spectrum, background and detector
+     * settings are copied before this returns, so later changes don't affect the job. A new job
+     * cancels the one still running; a cancelled job reports nothing.
+     * @return Job id passed back by clogEstimated() or clogEstimationFailed()
+     */
+    quint64 estimateClogAsync(std::shared_ptr<Spectrum> spc, nucare::DetectorComponent* dev);
+    void cancelClogEstimation();
+
+    /**
+     * Live analysis: the analyzed spectra of each detector are accumulated and the clog estimation
+     * runs on that sum after every `seconds` of acquisition. Results come from liveClogEstimated().
+     * @param seconds Cadence, 0 turns live analysis off. Changing it restarts the accumulation
+     */
+    void setLiveAnalysisInterval(int seconds);
+    int getLiveAnalysisInterval() const { return mLiveInterval; }
+    // Start the accumulation over and drop the runs in flight, done when a measurement starts
+    void resetLiveAnalysis();
+
+    // Primary detector, the first one opened by ComponentManager
     nucare::DetectorComponent* getCurrentDetector();
 
 public slots:
@@ -35,10 +64,98 @@ public slots:
 
 signals:
     // Signal to forward processed data to other components
-    void spectrumReceived(std::shared_ptr<Spectrum> spc);
+    void spectrumReceived(nucare::DetectorComponent* dev, std::shared_ptr<Spectrum> spc);
+
+    void clogEstimated(quint64 jobId, ClogEstimation result);
+    void clogEstimationFailed(quint64 jobId, QString error);
+
+    void liveClogEstimated(nucare::DetectorComponent* dev, ClogEstimation result);
 
 private:
-    nucare::Average<double, 5> mAvgCps;
+    // Per detector analysis state, only touched by the analysis task of the detector (one at a time)
+    struct DeviceAnalysis {
+        nucare::Average<double, 5> avgCps;
+
+        // Live analysis accumulation, started over when liveGeneration falls behind the pipeline's
+        Spectrum liveSpc;
+        double liveSinceRun    = 0;
+        quint64 liveGeneration = 0;
+
+        DeviceAnalysis() { liveSpc.setAcqTime(0); }
+    };
+
+    // What the analysis task of a package posts back to the GUI thread
+    struct PackageResult {
+        std::shared_ptr<Spectrum> spc;
+        double rawCps = 0;
+        double cps    = 0;
+        // Copy of the live accumulation when a live run is due
+        std::shared_ptr<Spectrum> liveSpc;
+        quint64 liveGeneration = 0;
+    };
+
+    // Per detector state. Packages of one detector are analyzed one at a time and in order,
+    // different detectors run in parallel on mAnalysisPool.
+    struct DevicePipeline {
+        std::shared_ptr<DeviceAnalysis> analysis = std::make_shared<DeviceAnalysis>();
+        std::deque<std::shared_ptr<DetectorPackage>> pending;
+        bool busy = false;
+
+        // Bumped by resetLiveAnalysis(), the next task starts the accumulation over
+        quint64 liveGeneration = 0;
+        bool liveBusy          = false;
+    };
+
+    std::unordered_map<nucare::DetectorComponent*, DevicePipeline> mPipelines;
+    QThreadPool mAnalysisPool;
+    nucare::ObjectPool<Spectrum> mSpectrumPool;
+    size_t mReportedHighWater = 0;
+
+    // Intermediate spectra of one estimateClog() run, recycled instead of allocated on every call
+    struct ClogWorkspace {
+        Spectrum smoothSpc;
+        Spectrum bgr;
+        Spectrum reBinEmptySpc;
+        Spectrum BGEroChSpec;
+        Spectrum PPChSpec;
+        BinSpectrum BinSpec;
+        BinSpectrum BGEroBinSpec;
+
+        void reset();
+    };
+    nucare::ObjectPool<ClogWorkspace> mClogWorkspaces;
+
+    // Inputs of one clog estimation, private copies owned by the job
+    struct ClogSnapshot {
+        std::shared_ptr<Spectrum> spc;
+        std::shared_ptr<Spectrum> background;
+        std::shared_ptr<const nucare::AnalysisContext> analysis;
+        std::pair<double, double> smooth;
+        Threshold srcThreshold;
+        double pipeThickness = 0;
+    };
+
+    QThreadPool mClogPool;
+    quint64 mClogJobId = 0;
+    std::shared_ptr<std::atomic<bool>> mClogCancel;
+
+    int mLiveInterval = 0;
+    std::shared_ptr<std::atomic<bool>> mLiveCancel;
+    // Live runs have their own thread, a measurement's estimation must not wait behind one
+    QThreadPool mLivePool;
+
+    // spc is kept as is, it must not change while the estimation runs
+    ClogSnapshot takeClogSnapshot(std::shared_ptr<Spectrum> spc, nucare::DetectorComponent* dev);
+    // Returns false when cancelled before finishing
+    bool runClog(const ClogSnapshot& in, const std::atomic<bool>* cancelled, ClogEstimation& out);
+
+    // Runs in the analysis task, returns a copy of the accumulation when a live run is due
+    static std::shared_ptr<Spectrum> accumulateLive(DeviceAnalysis& state, const Spectrum& spc, double seconds,
+                                                    int interval, quint64 generation, bool busy);
+    void startLiveAnalysis(nucare::DetectorComponent* dev, DevicePipeline& pipeline, std::shared_ptr<Spectrum> spc);
+    void submitPackage(nucare::DetectorComponent* dev, std::shared_ptr<DetectorPackage> pkg);
+    void onPackageAnalyzed(nucare::DetectorComponent* dev, std::shared_ptr<DetectorPackage> pkg,
+                           const PackageResult& result);
 };
 
 #endif // NCMANAGER_H
@@ -156,6 +156,10 @@ SubSettingItem* setting::buildSettingTree() {
                     ->setName("Measurement Interval Time")
                     ->setKey(SettingManager::KEY_MEASURE_INVERVAL)
                     ->setShowValue(true),
+                (new ChoiceSettingItem({{"Off", 0}, {"30", 30}, {"60", 60}, {"300", 300}}, ret))
+                    ->setName("Live Analysis Interval")
+                    ->setKey(SettingManager::KEY_LIVE_ANALYSIS_INTERVAL)
+                    ->setShowValue(true),
             })
             ->setName("Measurement Setup"),
         (new InfoSettingItem(ret))
@@ -182,7 +186,8 @@ SettingManager::SettingManager(QObject *parent)
       m_pipeMaterial(new ConfigEntry(KEY_PIPE_MATERIAL, "Steel", this)),
       m_pipeDensity(new ConfigEntry(KEY_PIPE_DENSITY, 7.85, this)),
       m_pipeThickness(new ConfigEntry(KEY_PIPE_THICKNESS, 10.0, this)),
-      m_pipeDiameter(new ConfigEntry(KEY_PIPE_DIAMETER, 100.0, this))
+      m_pipeDiameter(new ConfigEntry(KEY_PIPE_DIAMETER, 100.0, this)),
+      m_liveAnalysisInterval(new ConfigEntry(KEY_LIVE_ANALYSIS_INTERVAL, 0, this))
 {
     // Register all ConfigEntry members in the map and connect their signals
     auto connectAndRegister = [&](ConfigEntry* entry) {
@@ -199,6 +204,7 @@ SettingManager::SettingManager(QObject *parent)
     connectAndRegister(m_pipeDensity);
     connectAndRegister(m_pipeThickness);
     connectAndRegister(m_pipeDiameter);
+    connectAndRegister(m_liveAnalysisInterval);
 }
 
 SettingManager::~SettingManager()
@@ -335,6 +341,11 @@ double SettingManager::getPipeDiameter() const
     return m_pipeDiameter->getValue().toDouble();
 }
 
+int SettingManager::getLiveAnalysisInterval() const
+{
+    return m_liveAnalysisInterval->getValue().toInt();
+}
+
 IsoProfile *SettingManager::getIsotopeProfile() const
 {
     return m_isotopeProfile;
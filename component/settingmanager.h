@@ -65,6 +65,7 @@ public:
     static constexpr const char* KEY_PIPE_DENSITY = "pipe_density";
     static constexpr const char* KEY_PIPE_THICKNESS = "pipe_thickness";
     static constexpr const char* KEY_PIPE_DIAMETER = "pipe_diameter";
+    static constexpr const char* KEY_LIVE_ANALYSIS_INTERVAL = "live_analysis_interval";
 
  SettingManager(QObject* parent = nullptr);
  virtual ~SettingManager();
@@ -84,6 +85,8 @@ public:
     double getPipeDensity() const;
     double getPipeThickness() const;
     double getPipeDiameter() const;
+    // Seconds between live clog estimations, 0 when live analysis is off
+    int getLiveAnalysisInterval() const;
     IsoProfile* getIsotopeProfile() const;
 
     template <typename Func>
@@ -116,6 +119,7 @@ private:
     ConfigEntry* m_pipeDensity;
     ConfigEntry* m_pipeThickness;
     ConfigEntry* m_pipeDiameter;
+    ConfigEntry* m_liveAnalysisInterval;
     IsoProfile* m_isotopeProfile = nullptr;
 
     void loadSettings();
@@ -20,6 +20,7 @@ struct GcResponse {
 // Domain package structure for continuous data (from Start command)
 struct DetectorPackage {
     std::shared_ptr<HwSpectrum> spc = nullptr;
+    std::shared_ptr<HwCountSpectrum> counts = nullptr; // Integer counts behind spc, before realtime scaling
     int neutron = 0;
     double gm = 0;
     double realtime = -1;
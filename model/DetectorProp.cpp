@@ -1,4 +1,5 @@
  #include "DetectorProp.h"
+#include "util/AnalysisContext.h"
 
 using namespace std;
 using namespace nucare;
@@ -47,6 +48,18 @@ double DetectorProperty::getK40Ch()
     return 0;
 }
 
+std::shared_ptr<const AnalysisContext> DetectorProperty::getAnalysisContext()
+{
+    if (!mCalib) return nullptr;
+
+    // Calibration also updates its coefficients and ratio in place, so compare them too
+    double ratio = mCalib->getRatio();
+    if (!mAnalysisContext || !mAnalysisContext->matches(getCoeffcients(), mFWHM, ratio)) {
+        mAnalysisContext = make_shared<const AnalysisContext>(getCoeffcients(), mFWHM, interCoeff, ratio);
+    }
+    return mAnalysisContext;
+}
+
 void DetectorProperty::setPeakInfo(const int &middleCalib, const int &endCalib)
 {
     mPeakInfo[0] = middleCalib;
@@ -16,6 +16,7 @@ class NcManager;
 
 namespace nucare {
 
+class AnalysisContext;
 
 #define NC_GAIN_REST_TIME_HIGH 120      // stabilization rest time if K40diff <= 1%:150
 #define NC_GAIN_REST_TIME_MEDIUM 60     // stabilization rest time if K40diff <= 2%:60
@@ -45,6 +46,8 @@ private:
     std::shared_ptr<Background> mBackground;
     std::shared_ptr<Spectrum> mSpc;
     std::shared_ptr<HwSpectrum> mOriginSpc;
+    std::shared_ptr<HwCountSpectrum> mOriginCounts;
+    std::shared_ptr<const AnalysisContext> mAnalysisContext;
     double mCPS = 0;
     double m_rawCps = 0;
     double mDoserate = 0;
@@ -100,15 +103,27 @@ public:
     double getWndRatio_Co57_Tc99m() { return 0.45; }
     double getNeutronCps() { return mNeutron; }
     auto getOriginSpc() { return mOriginSpc; }
+    auto getOriginCounts() { return mOriginCounts; }
     int getGC() { return mGC; }
     int getTemperature() { return mTemperature; }
     int getRawTemperature() { return mRawTemperature; }
     bool hasNeutron() { return mHasNeutron; }
     double getK40Ch();
-
-    void setCoeffcients(const Coeffcients &newCoeffcients) { mCalib->setCoefficients(newCoeffcients); }
+    /**
+     * Analysis tables of the current calibration and FWHM, rebuilt when they changed. Only call it
+     * from the thread owning this property, the returned context itself can go to any thread.
+     */
+    std::shared_ptr<const AnalysisContext> getAnalysisContext();
+
+    void setCoeffcients(const Coeffcients &newCoeffcients) {
+        mCalib->setCoefficients(newCoeffcients);
+        mAnalysisContext = nullptr;
+    }
     void setGeCoefficient(const GeCoefficients &geCoeffs) { mGeCoeffcients = geCoeffs; }
-    void setFWHM(const FWHM& fwhm) { mFWHM = fwhm; }
+    void setFWHM(const FWHM& fwhm) {
+        mFWHM = fwhm;
+        mAnalysisContext = nullptr;
+    }
     void setFHM(const FHM& fhm) { mFHM = fhm; }
     void setROI(const double& roi) { mWndROI = roi; }
     void setSmooths(const double smoothA, const double smoothB) { mSmoothParams = std::pair<double, double>(smoothA, smoothB); }
@@ -132,7 +147,10 @@ public:
     void setDetectorCode(const DetectorCode_E code);
     void setSerial(const QString& serial) { info.serialNumber = serial; }
     void setDetectorType(const QString& type) { info.detectorType = type; }
-    void setCalibration(std::shared_ptr<Calibration> calib) { mCalib = calib; }
+    void setCalibration(std::shared_ptr<Calibration> calib) {
+        mCalib = calib;
+        mAnalysisContext = nullptr;
+    }
     void setBackgroundSpc(std::shared_ptr<Background> background) { mBackground = background; }
     auto getBackgroundSpc() { return mBackground ? mBackground->spc : nullptr; }
     auto getBackground() { return mBackground; }
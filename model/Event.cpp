@@ -12,13 +12,16 @@ Event::Event()
     mSpc(nullptr),
     mAvgDose(0),
     mMaxDose(0),
+    mE1Netcount(0.0),
+    mE2Netcount(0.0),
     mPipeMaterial(""),
     mPipeThickness(0.0),
     mPipeDiameter(0.0),
     mClogMaterial(""),
     mClogDensity(0.0),
     mClogThickness(0.0),
-    mClogRatio(0.0)
+    mClogRatio(0.0),
+    mClogStatus(ClogNotEstimated)
 {
 
 }
@@ -68,6 +71,7 @@ Event &Event::operator=(const Event &ev)
     mClogDensity = ev.mClogDensity;
     mClogThickness = ev.mClogThickness;
     mClogRatio = ev.mClogRatio;
+    mClogStatus = ev.mClogStatus;
 
     return *this;
 }
@@ -11,6 +11,10 @@ class Calibration;
 
 class Event
 {
+public:
+    // Outcome of the clog estimation, ClogThickness and ClogRatio only hold values when ClogEstimated
+    enum ClogStatus { ClogEstimated = 0, ClogNotEstimated = 1, ClogFailed = 2 };
+
 private:
 
     QString mSoftwareVersion;
@@ -41,6 +45,7 @@ private:
     double mClogDensity;
     double mClogThickness;
     double mClogRatio;
+    ClogStatus mClogStatus;
 
     nucare::Timestamp mTimeStarted;
     nucare::Timestamp mTimeFinished;
@@ -104,6 +109,7 @@ public:
     inline void setClogDensity(double value) { mClogDensity = value; }
     inline void setClogThickness(double value) { mClogThickness = value; }
     inline void setClogRatio(double value) { mClogRatio = value; }
+    inline void setClogStatus(ClogStatus status) { mClogStatus = status; }
 
     Event& operator=(const Event& ev);
 
@@ -139,6 +145,8 @@ public:
     inline double getClogDensity() const { return mClogDensity; }
     inline double getClogThickness() const { return mClogThickness; }
     inline double getClogRatio() const { return mClogRatio; }
+    inline ClogStatus getClogStatus() const { return mClogStatus; }
+    inline bool isClogEstimated() const { return mClogStatus == ClogEstimated; }
     inline long getDetectorId() const { return mDetectorId; }
 };
 
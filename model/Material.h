@@ -1,9 +1,12 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+// Materials with an attenuation table, see ndt::Mass_Attenuation_coefficient()
 enum Material {
     IRON,
-    ALUMINUM
+    ALUMINUM,
+    COPPER,
+    LEAD
 };
 
 #endif // MATERIAL_H
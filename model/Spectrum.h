@@ -4,21 +4,33 @@
 #include "config.h"
 #include "Types.h"
 #include "util/nc_exception.h"
+#include "util/SpectrumKernels.h"
 
 #include <stddef.h>
-#include <array>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <math.h>
 #include <QStringList>
 
+/**
+ * Fixed size spectrum. Channels live in a heap buffer so moving a spectrum only moves
+ * the pointer; copies are explicit through clone() or copyFrom(). A moved-from spectrum
+ * has no buffer and may only be assigned to or destroyed.
+ */
 template <class Data = float, size_t N = nucare::CHSIZE>
 class Spectrum_t
 {
    private:
-    std::array<Data, N> m_data = {0};
+    std::unique_ptr<Data[]> m_data;
     double m_acqTime = 0;
     double m_realTime = 0;
-    double m_totalCount = 0;
+    // Total count is computed on first read after the channels changed, not on every write.
+    // Reading it from several threads at once is only safe once it has been computed.
+    mutable double m_totalCount = 0;
+    mutable bool m_totalDirty = false;
+    int m_totalFill = 0; // m_fillCps as of the last update(), the part of the total not in the channels
     int m_fillCps = 0;
     int m_detID = -1;
     double m_count_rate = 0.0;
@@ -27,24 +39,51 @@ class Spectrum_t
     using Channel  = Data;
     using SPC_DATA = Data*;
 
-    Spectrum_t() noexcept : m_acqTime(1), m_totalCount(0), m_fillCps(0) {}
+    Spectrum_t() : m_data(new Data[N]()), m_acqTime(1), m_totalCount(0), m_fillCps(0) {}
 
-    explicit Spectrum_t(const Data* spc_data) noexcept(noexcept(setData(spc_data))) : Spectrum_t() {
-        setData(spc_data);
-    }
+    explicit Spectrum_t(const Data* spc_data) : Spectrum_t() { setData(spc_data); }
 
     Spectrum_t(const Spectrum_t& spc) = delete;
 
     Spectrum_t& operator=(const Spectrum_t& spc) = delete;
 
+    Spectrum_t(Spectrum_t&& spc) noexcept = default;
+
+    Spectrum_t& operator=(Spectrum_t&& spc) noexcept = default;
+
     ~Spectrum_t() = default;
 
+    Spectrum_t clone() const {
+        Spectrum_t ret;
+        ret.copyFrom(*this);
+        return ret;
+    }
+
+    // Copy channels and metadata into this spectrum's own buffer, no allocation
+    void copyFrom(const Spectrum_t& spc) {
+        if (&spc == this) return;
+        std::copy(spc.m_data.get(), spc.m_data.get() + N, m_data.get());
+        m_acqTime = spc.m_acqTime;
+        m_realTime = spc.m_realTime;
+        m_totalCount = spc.m_totalCount;
+        m_totalDirty = spc.m_totalDirty;
+        m_totalFill = spc.m_totalFill;
+        m_fillCps = spc.m_fillCps;
+        m_detID = spc.m_detID;
+        m_count_rate = spc.m_count_rate;
+    }
+
    public:
-    void update() {
-        m_totalCount = m_fillCps;
-        for (const auto& val : m_data) {
-            m_totalCount += val;
-        }
+    void update() noexcept {
+        m_totalFill = m_fillCps;
+        m_totalDirty = true;
+    }
+
+    // Same as update() when the channel sum was already computed while filling the data
+    void updateTotal(double channelSum) noexcept {
+        m_totalFill = m_fillCps;
+        m_totalCount = m_fillCps + channelSum;
+        m_totalDirty = false;
     }
 
     static inline constexpr size_t getSize() { return N; }
@@ -55,7 +94,7 @@ class Spectrum_t
 
     void setData(const Data* data_ptr) {
         if (data_ptr) {
-            std::copy(data_ptr, data_ptr + N, m_data.begin());
+            std::copy(data_ptr, data_ptr + N, m_data.get());
             update();
         }
     }
@@ -64,15 +103,24 @@ class Spectrum_t
 
     void setCountRate(double count_rate) noexcept { m_count_rate = count_rate; }
 
-    Data* data() noexcept { return m_data.data(); }
+    Data* data() noexcept {
+        m_totalDirty = true;
+        return m_data.get();
+    }
 
-    const Data* dataConst() const noexcept { return m_data.data(); }
+    const Data* dataConst() const noexcept { return m_data.get(); }
 
-    double getTotalCount() const noexcept { return m_totalCount; }
+    double getTotalCount() const noexcept {
+        if (m_totalDirty) {
+            m_totalCount = m_totalFill + sum();
+            m_totalDirty = false;
+        }
+        return m_totalCount;
+    }
 
     double getAvgCps() const {
         if (m_acqTime > 0) {
-            return m_totalCount / m_acqTime;
+            return getTotalCount() / m_acqTime;
         }
         return 0.0;
     }
@@ -90,30 +138,87 @@ class Spectrum_t
     double getCountRate() const noexcept { return m_count_rate; }
 
     void reset() {
-        std::fill(m_data.begin(), m_data.end(), 0);
+        std::fill(m_data.get(), m_data.get() + N, 0);
         m_acqTime = 1;
         m_realTime = 0;
         m_totalCount = 0;
+        m_totalDirty = false;
+        m_totalFill = 0;
         m_fillCps = 0;
         m_detID = -1;
         m_count_rate = 0.0;
     }
 
     void accumulate(const Spectrum_t<Data, N>& spc) {
-        for (size_t i = 0; i < N; ++i) {
-            m_data[i] += spc.m_data[i];
-        }
+        nucare::kernel::accumulate(m_data.get(), spc.m_data.get(), N);
         m_acqTime += spc.m_acqTime;
         m_realTime += spc.m_realTime;
         m_fillCps += spc.m_fillCps;
-        update();
+
+        // Both totals known: add them up instead of summing the channels again
+        if (!m_totalDirty && !spc.m_totalDirty) {
+            double channels = (m_totalCount - m_totalFill) + (spc.m_totalCount - spc.m_totalFill);
+            updateTotal(channels);
+        } else {
+            update();
+        }
+    }
+
+    // Channel-wise operations on the vector kernels, acquisition metadata is left alone
+
+    // this += a * spc
+    void axpy(const Spectrum_t<Data, N>& spc, double a) {
+        nucare::kernel::axpy(m_data.get(), spc.m_data.get(), a, N);
+        m_totalDirty = true;
+    }
+
+    // this = max(this - spc, 0)
+    void subtractClamp0(const Spectrum_t<Data, N>& spc) {
+        nucare::kernel::subtractClamp0(m_data.get(), m_data.get(), spc.m_data.get(), N);
+        m_totalDirty = true;
+    }
+
+    void scale(double factor) {
+        nucare::kernel::scale(m_data.get(), m_data.get(), factor, N);
+        m_totalDirty = true;
+    }
+
+    // Sum of the channels, without the fill count
+    double sum() const { return nucare::kernel::sum(m_data.get(), N); }
+
+    /**
+     * Explicit conversion to another channel type, e.g. integer counts to the double
+     * spectrum the analysis works on. Acquisition metadata is copied along.
+     */
+    template <class O>
+    void convertTo(Spectrum_t<O, N>& out) const {
+        O* dst = out.data();
+        for (size_t i = 0; i < N; ++i) {
+            dst[i] = static_cast<O>(m_data[i]);
+        }
+        out.setAcqTime(m_acqTime);
+        out.setRealTime(m_realTime);
+        out.setDetectorID(m_detID);
+        out.setCountRate(m_count_rate);
+
+        // Carry the cached total over, same fill part included
+        out.setFillCps(m_totalFill);
+        if (m_totalDirty) {
+            out.update();
+        } else {
+            out.updateTotal(m_totalCount - m_totalFill);
+        }
+        out.setFillCps(m_fillCps);
     }
 
-    auto begin() { return m_data.begin(); }
-    auto end() { return m_data.end(); }
+    auto begin() {
+        m_totalDirty = true;
+        return m_data.get();
+    }
+    auto end() { return m_data.get() + N; }
 
     Spectrum_t<Data, N> operator+(const Spectrum_t<Data, N>& spc) const {
-        Spectrum_t<Data, N> result = *this;
+        Spectrum_t<Data, N> result = clone();
         result.accumulate(spc);
         return result;
     }
@@ -122,6 +227,7 @@ class Spectrum_t
         if (i >= N) {
             throw std::out_of_range("Spectrum_t::operator[]: index out of bounds");
         }
+        m_totalDirty = true;
         return m_data[i];
     }
 
@@ -133,7 +239,10 @@ class Spectrum_t
     }
 
     const Data& at(const unsigned int i) const {
-        return m_data.at(i);
+        if (i >= N) {
+            throw std::out_of_range("Spectrum_t::at: index out of bounds");
+        }
+        return m_data[i];
     }
 
     QString toString() {
@@ -154,8 +263,9 @@ class Spectrum_t
 
         Spectrum_t* ret = new Spectrum_t();
         for (int i = 0; i < ret->getSize(); i++) {
-            ret->m_data[i] = dataParts[i].toDouble();
+            ret->m_data[i] = static_cast<Data>(dataParts[i].toDouble());
         }
+        ret->update();
 
         return ret;
     }
@@ -281,5 +391,7 @@ class Spectrum_t
 typedef Spectrum_t<double, nucare::CHSIZE> Spectrum;
 typedef Spectrum_t<double, nucare::HW_CHSIZE> HwSpectrum;
 typedef Spectrum_t<double, nucare::BINSIZE> BinSpectrum;
+// Raw integer counts as read from the detector, half the size of HwSpectrum
+typedef Spectrum_t<uint32_t, nucare::HW_CHSIZE> HwCountSpectrum;
 
 #endif /* INCLUDE_MODEL_SPECTRUM_H_ */
@@ -32,6 +32,7 @@ struct ClogEstimation {
     double thickness = 0;
     double netCount1 = 0;
     double netCount2 = 0;
+    qint64 elapsedMs = 0; // Time spent in the estimation pipeline
 };
 
 #endif // NDT_MODEL_H
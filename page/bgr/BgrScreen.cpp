@@ -144,9 +144,10 @@ void BackgroundScreen::onRecvBacground()
     auto date = QDateTime::currentDateTime();
     bgr->date = datetime::formatIsoDate(date);
     bgr->spc = m_counter->getCurrentResult().spectrum;
-    bgr->id = dbMgr->insertBackground(bgr.get());
-
-    if (bgr->id > 0) {
-        showConfirmDlg();
-    }
+    dbMgr->insertBackgroundAsync(bgr, this, [this, bgr](qlonglong id) {
+        bgr->id = static_cast<int>(id);
+        if (bgr->id > 0) {
+            showConfirmDlg();
+        }
+    });
 }
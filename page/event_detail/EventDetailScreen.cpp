@@ -48,7 +48,15 @@ void EventDetailScreen::bindEvent(std::shared_ptr<Event> event)
     ui->materialLabel->setText(QString("Material: %1").arg(event->getPipeMaterial()));
     ui->diameterLabel->setText(QString("Diameter: %1").arg(event->getPipeDiameter(), 0, 'f', 1));
     ui->thicknessLabel->setText(QString("Thickness: %1").arg(event->getPipeThickness(), 0, 'f', 1));
-    ui->clogRatioLabel->setText(QString("Clog ratio: %1%").arg(event->getClogRatio(), 0, 'f', 0));
-    ui->clogThickEstValue->setText(QString("%1 mm").arg(event->getClogThickness(), 0, 'f', 1));
+    if (event->isClogEstimated()) {
+        // No ratio without a pipe thickness
+        ui->clogRatioLabel->setText(event->getPipeThickness() > 0
+                                        ? QString("Clog ratio: %1%").arg(event->getClogRatio(), 0, 'f', 0)
+                                        : QString("Clog ratio: -"));
+        ui->clogThickEstValue->setText(QString("%1 mm").arg(event->getClogThickness(), 0, 'f', 1));
+    } else {
+        ui->clogRatioLabel->setText("Clog ratio: -");
+        ui->clogThickEstValue->setText(event->getClogStatus() == Event::ClogFailed ? "Failed" : "Not estimated");
+    }
     ui->clogDensityValue->setText(QString("%1 g/cc").arg(event->getClogDensity(), 0, 'f', 1));
 }
@@ -28,6 +28,7 @@ QVariant EventListAdapter::data(const QModelIndex &index, int role) const {
     }
 
     if (event == nullptr) return QString();
+    if (mCb && index.column() == 0) mCb->onRowShown(index.row());
 
     switch (index.column()) {
         case 0:
@@ -39,6 +40,7 @@ QVariant EventListAdapter::data(const QModelIndex &index, int role) const {
         case 2: {
             //        auto unit = mSettingDB->getDoseUnit();
             //        auto dose = nucare::from_nSvh(event->getDoses(), unit);
+            if (!event->isClogEstimated()) return QString("-");
             return QString("%1mm").arg(event->getClogThickness(), 0, 'f', 2);
             // return QString(nucare::autoformat_nSvh(event->getDoses()).c_str());
         }
@@ -7,6 +7,8 @@
 
 struct EventListCallback {
     virtual void onRequestLoadMore(const QModelIndex&& index) = 0;
+    // A loaded row is being shown, lets the screen fetch ahead
+    virtual void onRowShown(int row) { Q_UNUSED(row); }
 };
 
 class EventListAdapter : public BaseModel<std::shared_ptr<Event>>
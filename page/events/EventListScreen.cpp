@@ -88,8 +88,9 @@ void EventListScreen::onCreate(navigation::NavigationArgs *args)
     BaseScreen::onCreate(args);
     mTotalCount = mDataRepo->getTotalEventCount();
     mEvents = make_shared<QVector<shared_ptr<Event>>>(mTotalCount, nullptr);
-    auto events = mDataRepo->getEvents(0, EVENT_PAGE_SIZE);
-    onLoadEvent(std::move(events), 0);
+    mPageCursors.assign(mTotalCount / EVENT_PAGE_SIZE + 1, -1);
+    mPageCursors[0] = nucare::DatabaseManager::FIRST_EVENT_PAGE;
+    loadPage(0);
     mAdapter->setData(mEvents);
 }
 
@@ -111,8 +112,41 @@ void EventListScreen::onRequestLoadMore(const QModelIndex &&qIndex)
         mLoadSession.start = pageStart;
         mLoadSession.end = pageEnd;
 
-        auto events = mDataRepo->getEvents(page, EVENT_PAGE_SIZE);
-        onLoadEvent(std::move(events), page);
+        loadPage(page);
+}
+
+void EventListScreen::onRowShown(int row)
+{
+    prefetchPage(row / EVENT_PAGE_SIZE + 1);
+}
+
+void EventListScreen::loadPage(int page)
+{
+    auto events = mDataRepo->getEventSummaries(pageCursor(page), EVENT_PAGE_SIZE);
+    onLoadEvent(std::move(events), page);
+    prefetchPage(page + 1);
+}
+
+void EventListScreen::prefetchPage(int page)
+{
+    int pageStart = page * EVENT_PAGE_SIZE;
+    if (pageStart >= mEvents->size() || (*mEvents)[pageStart] || mPrefetching.contains(page)) return;
+
+    mPrefetching.insert(page);
+    mDataRepo->getEventSummariesAsync(pageCursor(page), EVENT_PAGE_SIZE, this,
+                                      [this, page](QVector<shared_ptr<Event>> events) {
+                                          mPrefetching.remove(page);
+                                          onLoadEvent(std::move(events), page);
+                                      });
+}
+
+qlonglong EventListScreen::pageCursor(int page)
+{
+    // Known once the page before is loaded, a jump asks the database
+    if (mPageCursors[page] < 0) {
+        mPageCursors[page] = mDataRepo->getEventCursor(page * EVENT_PAGE_SIZE);
+    }
+    return mPageCursors[page];
 }
 
 void EventListScreen::reloadLocal()
@@ -134,6 +168,10 @@ void EventListScreen::toEventDetail(long id) {
 
 void EventListScreen::onLoadEvent(QVector<std::shared_ptr<Event>> &&events, int page)
 {
+    if (!events.isEmpty() && page + 1 < (int) mPageCursors.size()) {
+        mPageCursors[page + 1] = events.back()->getId();
+    }
+
     if (mEvents->size() <= events.size()) {
         mEvents = make_shared<QVector<shared_ptr<Event>>>(events);
         return;
@@ -3,7 +3,9 @@
 
 #include "base/basescreen.h"
 #include "page/events/EventListAdapter.h"
+#include <QSet>
 #include <QWidget>
+#include <vector>
 
 namespace Ui {
 class EventListScreen;
@@ -23,18 +25,28 @@ public:
 
     void onCreate(navigation::NavigationArgs* args) override;
     void onRequestLoadMore(const QModelIndex &&index) override;
+    void onRowShown(int row) override;
     void reloadLocal() override;
 
 
     void toEventDetail(long id);
     void onLoadEvent(QVector<std::shared_ptr<Event>>&& events, int page);
 private:
+    void loadPage(int page);
+    // Load the page on the reader connection before the list gets there
+    void prefetchPage(int page);
+    qlonglong pageCursor(int page);
+
     Ui::EventListScreen *ui;
     
     int mTotalCount = 0;
     nucare::DatabaseManager* mDataRepo;
     std::shared_ptr<QVector<std::shared_ptr<Event>>> mEvents;
 
+    // Keyset cursor of every page, the id of the last event of the page before. -1 until known
+    std::vector<qlonglong> mPageCursors;
+    QSet<int> mPrefetching;
+
     struct LoadingSession {
         int start = -1;
         int end = -1;
@@ -10,6 +10,8 @@
 #include "model/DetectorInfo.h"
 #include "model/Background.h"
 #include "model/Calibration.h"
+#include "util/SpectrumCodec.h"
+#include <cmath>
 using namespace navigation;
 using namespace setting;
 
@@ -55,6 +57,12 @@ HomePage::HomePage(QWidget* parent) : BaseScreen(tag::HOME_TAG, parent), ui(new
     connect(m_accumulator.get(), &SpectrumAccumulator::stateChanged, this, &HomePage::stateChanged);
     connect(m_accumulator.get(), &SpectrumAccumulator::accumulationUpdated, this, &HomePage::updateEvent);
 
+    if (auto ncMgr = ComponentManager::instance().ncManager()) {
+        connect(ncMgr.get(), &NcManager::clogEstimated, this, &HomePage::onClogEstimated);
+        connect(ncMgr.get(), &NcManager::clogEstimationFailed, this, &HomePage::onClogEstimationFailed);
+        connect(ncMgr.get(), &NcManager::liveClogEstimated, this, &HomePage::onLiveClogEstimated);
+    }
+
     settingMgr->subscribeKey(SettingManager::KEY_ACQTIME_ID, (QObject*) this, [this](setting::SettingManager* mgr, auto) {
         setMeasureTime(mgr->getAcqTimeId());
     });
@@ -183,6 +191,11 @@ void HomePage::stateChanged(AccumulatorState state)
         ui->etValueLabel->show();
         ui->stopTimeValueLabel->setText(datetime::formatDate_yyyyMMdd_HHmm(m_accumulator->getCurrentResult().finishTime));
         ui->startTimeValueLabel->setText(datetime::formatDate_yyyyMMdd_HHmm(m_accumulator->getCurrentResult().startTime));
+
+        // Live analysis covers the spectra of this measurement only
+        if (auto ncMgr = ComponentManager::instance().ncManager()) {
+            ncMgr->resetLiveAnalysis();
+        }
         break;
     }
     case AccumulatorState::Waiting: {
@@ -194,10 +207,19 @@ void HomePage::stateChanged(AccumulatorState state)
 
         auto ret = m_accumulator->getCurrentResult();
 
-        auto dbManager = ComponentManager::instance().databaseManager();
         auto settingMgr = ComponentManager::instance().settingManager();
         auto ncMgr = ComponentManager::instance().ncManager();
-        Event event;
+
+        // A new measurement supersedes the estimation still running for the previous one
+        if (m_pendingEvent) {
+            nucare::logW() << "Clog estimation" << m_clogJob << "superseded, saving its event without estimation.";
+            ncMgr->cancelClogEstimation();
+            savePendingEvent(Event::ClogNotEstimated);
+        }
+
+        m_pendingEvent.reset(new Event());
+        m_pendingSpectrum.clear();
+        Event& event = *m_pendingEvent;
 
         // Populate Event object
         event.setSoftwareVersion(QApplication::applicationVersion()); // Or a more appropriate version
@@ -227,41 +249,25 @@ void HomePage::stateChanged(AccumulatorState state)
             nucare::logW() << "Calibration ID is -1 in accumulation result.";
         }
 
-        QString spectrumStringData;
-        ClogEstimation clog;
-
-        if (ret.spectrum) {
-            spectrumStringData = ret.spectrum->toString();
-            event.setRealTime(ret.spectrum->getRealTime());
-            event.setAvgFillCps(ret.spectrum->getFillCps() / ret.spectrum->getAcqTime());
-
-            clog = ncMgr->estimateClog(ret.spectrum, ncMgr->getCurrentDetector());
-        }
-
         auto isotopeProfile = settingMgr->getIsotopeProfile();
 
         event.setE1Energy(isotopeProfile->threshold_energy.first);
         event.setE1Branching(isotopeProfile->threshold_branching.first);
-        event.setE1Netcount(clog.netCount1);
         event.setE2Energy(isotopeProfile->threshold_energy.second);
         event.setE2Branching(isotopeProfile->threshold_branching.second);
-        event.setE2Netcount(clog.netCount2);
         event.setPipeMaterial(settingMgr->getPipeMaterial());
         event.setPipeDiameter(settingMgr->getPipeDiameter());
         event.setPipeThickness(settingMgr->getPipeThickness());
-        event.setClogThickness(clog.thickness);
-        event.setClogRatio(clog.thickness / settingMgr->getPipeThickness());
 
-        // Insert event data
-        if (dbManager) {
-            qlonglong eventId = dbManager->insertEvent(&event);
-            nucare::logI() << "Event inserted with ID:" << eventId;
+        if (ret.spectrum) {
+            m_pendingSpectrum = nucare::SpectrumCodec::encode(*ret.spectrum);
+            event.setRealTime(ret.spectrum->getRealTime());
+            event.setAvgFillCps(ret.spectrum->getFillCps() / ret.spectrum->getAcqTime());
 
-            if (eventId > 0 && !spectrumStringData.isEmpty()) {
-                dbManager->insertEventDetail(eventId, spectrumStringData);
-            }
+            // Saved once the estimation comes back, see onClogEstimated()
+            m_clogJob = ncMgr->estimateClogAsync(ret.spectrum, ncMgr->getCurrentDetector());
         } else {
-            nucare::logW() << "DatabaseManager not found!";
+            savePendingEvent(Event::ClogNotEstimated);
         }
 
         break;
@@ -269,6 +275,76 @@ void HomePage::stateChanged(AccumulatorState state)
     }
 }
 
+void HomePage::onClogEstimated(quint64 jobId, ClogEstimation clog)
+{
+    if (!m_pendingEvent || jobId != m_clogJob) return;
+
+    // ClogThickness and ClogRatio are NOT NULL, SQLite would store NaN as NULL and drop the event
+    if (!std::isfinite(clog.thickness)) {
+        onClogEstimationFailed(jobId, "Clog thickness is not a finite number.");
+        return;
+    }
+
+    nucare::logI() << "Clog estimation took" << clog.elapsedMs << "ms, thickness:" << clog.thickness;
+    showClogEstimation(clog);
+    savePendingEvent(Event::ClogEstimated, clog);
+}
+
+void HomePage::onClogEstimationFailed(quint64 jobId, QString error)
+{
+    if (!m_pendingEvent || jobId != m_clogJob) return;
+
+    nucare::logW() << "Saving event without clog estimation:" << error;
+    savePendingEvent(Event::ClogFailed);
+}
+
+void HomePage::onLiveClogEstimated(nucare::DetectorComponent* dev, ClogEstimation clog)
+{
+    auto ncMgr = ComponentManager::instance().ncManager();
+    if (!ncMgr || dev != ncMgr->getCurrentDetector() || !std::isfinite(clog.thickness)) return;
+
+    showClogEstimation(clog);
+}
+
+void HomePage::showClogEstimation(const ClogEstimation& clog)
+{
+    ui->clogThickEstValue->setText(QString("%1 mm").arg(clog.thickness, 0, 'f', 1));
+
+    auto pipeThickness = ComponentManager::instance().settingManager()->getPipeThickness();
+    if (pipeThickness > 0) {
+        ui->clogRatioLabel->setText(QString("Clog ratio: %1%").arg(clog.thickness / pipeThickness * 100, 0, 'f', 0));
+    }
+}
+
+void HomePage::savePendingEvent(Event::ClogStatus status, const ClogEstimation& clog)
+{
+    auto event = std::move(m_pendingEvent);
+    auto spectrumData = std::move(m_pendingSpectrum);
+    m_pendingSpectrum.clear();
+    if (!event) return;
+
+    // Superseded or failed estimations keep the zero defaults, the status tells them from a clean pipe
+    event->setClogStatus(status);
+    if (status == Event::ClogEstimated) {
+        event->setE1Netcount(clog.netCount1);
+        event->setE2Netcount(clog.netCount2);
+        event->setClogThickness(clog.thickness);
+        // Without a pipe thickness there is no ratio, and NaN can't go in the NOT NULL column
+        if (event->getPipeThickness() > 0) {
+            event->setClogRatio(clog.thickness / event->getPipeThickness());
+        }
+    }
+
+    // Insert event data, written behind so the next cycle starts right away
+    auto dbManager = ComponentManager::instance().databaseManager();
+    if (dbManager) {
+        dbManager->insertEventAsync(std::shared_ptr<const Event>(std::move(event)), spectrumData, this,
+                                    [](qlonglong eventId) { nucare::logI() << "Event inserted with ID:" << eventId; });
+    } else {
+        nucare::logW() << "DatabaseManager not found!";
+    }
+}
+
 void HomePage::updateEvent()
 {
     if (m_accumulator) {
@@ -3,6 +3,8 @@
 
 #include "base/basescreen.h"
 #include "model/AccumulationDataTypes.h"
+#include "model/Event.h"
+#include "model/ndt_model.h"
 
 // Forward declaration for the UI class
 namespace Ui {
@@ -10,6 +12,9 @@ class HomePage;
 }
 
 class SpectrumAccumulator;
+namespace nucare {
+class DetectorComponent;
+}
 
 // NavigationComponent is forward-declared in basescreen.h which is included above.
 // No need for a redundant forward declaration here.
@@ -40,9 +45,24 @@ public slots:
     void stateChanged(AccumulatorState);
     void updateEvent();
 
+private slots:
+    void onClogEstimated(quint64 jobId, ClogEstimation clog);
+    void onClogEstimationFailed(quint64 jobId, QString error);
+    void onLiveClogEstimated(nucare::DetectorComponent* dev, ClogEstimation clog);
+
 private:
     Ui::HomePage *ui;
     std::shared_ptr<SpectrumAccumulator> m_accumulator;
+
+    // Completed measurement waiting for its clog estimation before being saved
+    std::unique_ptr<Event> m_pendingEvent;
+    QByteArray m_pendingSpectrum;
+    quint64 m_clogJob = 0;
+
+    // clog is only saved when status is Event::ClogEstimated
+    void savePendingEvent(Event::ClogStatus status, const ClogEstimation& clog = ClogEstimation());
+    // Estimated thickness and clog ratio labels
+    void showClogEstimation(const ClogEstimation& clog);
 };
 
 #endif // HOMEPAGE_H
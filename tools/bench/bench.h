@@ -0,0 +1,50 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Timing helpers shared by the benchmarks and checks in tools/bench. Qt free.
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+namespace bench {
+
+// Keep the compiler from dropping a computation whose result is not used
+template <class T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Average time of one call of f in nanoseconds, over at least minMs of calls
+template <class F>
+double nsPerCall(F&& f, double minMs = 100) {
+    typedef std::chrono::steady_clock Clock;
+
+    f(); // Warm up caches and the kernel dispatch
+    size_t calls  = 0;
+    size_t batch  = 1;
+    const auto t0 = Clock::now();
+    double elapsedNs;
+    do {
+        for (size_t i = 0; i < batch; i++) f();
+        calls += batch;
+        batch *= 2;
+        elapsedNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+    } while (elapsedNs < minMs * 1e6);
+    return elapsedNs / calls;
+}
+
+// Largest |a[i] - b[i]| relative to the largest |a[i]|, 0 for identical arrays
+inline double maxRelDiff(const double* a, const double* b, size_t n) {
+    double diff = 0, scale = 0;
+    for (size_t i = 0; i < n; i++) {
+        diff  = std::fmax(diff, std::fabs(a[i] - b[i]));
+        scale = std::fmax(scale, std::fabs(a[i]));
+    }
+    return scale > 0 ? diff / scale : diff;
+}
+
+} // namespace bench
+
+#endif // BENCH_H
@@ -0,0 +1,201 @@
+/**
+ * Check of SpectrumCodec, the format of the spectra stored in the database.
+ *
+ * - encode() then decode() must give back the same bits, for count spectra (delta varints, up to
+ *   +-2^53) and for anything else (raw doubles: -0, NaN, fractions, counts past 2^53);
+ * - decode() and pDecode() must reject blobs cut at any byte, with a byte too many, holding another
+ *   number of values, of another version or encoding;
+ * - legacy text written by Spectrum_t::toString() must read as it did, malformed text must not.
+ * The run then times encode() and pDecode() against the text round trip.
+ *
+ * Exits with 1 when a check fails.
+ */
+
+#include "tools/bench/bench.h"
+#include "util/SpectrumCodec.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+const int RUNS           = 200;
+const double TWO_POW_53  = 9007199254740992.0;
+const double NOT_A_COUNT = TWO_POW_53 + 2;
+
+int failures = 0;
+
+void fail(const char* what, int t) {
+    if (failures++ < 10) fprintf(stderr, "%s, run %d\n", what, t);
+}
+
+bool sameBits(const double* a, const double* b, size_t n) { return memcmp(a, b, n * sizeof(double)) == 0; }
+
+uint8_t encodingOf(const QByteArray& bytes) { return static_cast<uint8_t>(bytes[3]); }
+
+// Counts of spectrum t, some runs with the values only raw doubles keep
+void makeSpectrum(int t, HwSpectrum& spc) {
+    std::mt19937 rng(t);
+    std::poisson_distribution<int> counts(t % 4 == 0 ? 3 : 3000);
+    for (size_t i = 0; i < spc.getSize(); i++) spc[i] = counts(rng);
+
+    switch (t % 6) {
+    case 1: // Extreme counts, still delta varints
+        spc[0]    = TWO_POW_53;
+        spc[1]    = -TWO_POW_53;
+        spc[2]    = TWO_POW_53;
+        spc[2047] = -TWO_POW_53;
+        break;
+    case 2:
+        spc[100] = -0.0;
+        break;
+    case 3:
+        spc[7]    = std::numeric_limits<double>::quiet_NaN();
+        spc[8]    = -std::numeric_limits<double>::quiet_NaN();
+        spc[9]    = INFINITY;
+        spc[2047] = -INFINITY;
+        break;
+    case 4:
+        spc[500] = 0.5;
+        spc[501] = -1e-300;
+        break;
+    case 5:
+        spc[1000] = NOT_A_COUNT;
+        break;
+    }
+}
+
+void checkRoundTrip(int t, const HwSpectrum& spc, const QByteArray& blob) {
+    const uint8_t expected = t % 6 <= 1 ? SpectrumCodec::DELTA_VARINT : SpectrumCodec::RAW_DOUBLE;
+    if (!SpectrumCodec::isEncoded(blob) || encodingOf(blob) != expected) fail("Unexpected header", t);
+
+    HwSpectrum byArray;
+    if (!SpectrumCodec::decode(blob, byArray.data(), byArray.getSize()) ||
+        !sameBits(spc.dataConst(), byArray.dataConst(), spc.getSize())) {
+        fail("decode() into an array differs", t);
+    }
+
+    std::vector<double> byVector;
+    if (!SpectrumCodec::decode(blob, byVector) || byVector.size() != spc.getSize() ||
+        !sameBits(spc.dataConst(), byVector.data(), spc.getSize())) {
+        fail("decode() into a vector differs", t);
+    }
+
+    std::unique_ptr<HwSpectrum> byColumn(SpectrumCodec::pDecode<HW_CHSIZE>(QVariant(blob)));
+    if (!byColumn || !sameBits(spc.dataConst(), byColumn->dataConst(), spc.getSize())) {
+        fail("pDecode() differs", t);
+    }
+}
+
+bool rejected(const QByteArray& bytes) {
+    HwSpectrum out;
+    std::vector<double> values;
+    std::unique_ptr<HwSpectrum> column(SpectrumCodec::pDecode<HW_CHSIZE>(QVariant(bytes)));
+    return !SpectrumCodec::decode(bytes, out.data(), out.getSize()) && !SpectrumCodec::decode(bytes, values) &&
+           !column;
+}
+
+void checkMalformed(int t, const QByteArray& blob) {
+    // Every cut on the first runs, which cover each kind of spectrum twice, then a sample
+    const int step = t < 12 ? 1 : 61;
+    for (int size = 0; size < blob.size(); size += step) {
+        if (!rejected(blob.left(size))) {
+            fail("Truncated blob accepted", t);
+            break;
+        }
+    }
+    if (!rejected(blob + '\0')) fail("Blob with a trailing byte accepted", t);
+
+    QByteArray version = blob, encoding = blob;
+    version[2]  = static_cast<char>(SpectrumCodec::VERSION + 1);
+    encoding[3] = static_cast<char>(7);
+    if (!rejected(version)) fail("Blob of another version accepted", t);
+    if (!rejected(encoding)) fail("Blob of an unknown encoding accepted", t);
+
+    // Decodes as a spectrum of its own size only
+    HwSpectrum out;
+    if (SpectrumCodec::decode(blob, out.data(), out.getSize() - 1)) fail("Blob decoded as a shorter spectrum", t);
+    std::unique_ptr<Spectrum> shorter(SpectrumCodec::pDecode<CHSIZE>(QVariant(blob)));
+    if (shorter) fail("Blob read as a channel spectrum", t);
+}
+
+// Spectrum_t::toString() keeps six significant digits, legacy rows read back those values. Only
+// finite spectra were ever written as text.
+void checkLegacyText(int t, HwSpectrum& spc) {
+    const QByteArray text = spc.toString().toUtf8();
+    if (SpectrumCodec::isEncoded(text)) fail("Legacy text taken for a blob", t);
+
+    std::unique_ptr<HwSpectrum> read(SpectrumCodec::pDecode<HW_CHSIZE>(QVariant(QString::fromUtf8(text))));
+    if (!read) {
+        fail("Legacy text rejected", t);
+        return;
+    }
+    for (size_t i = 0; i < spc.getSize(); i++) {
+        const double printed = QString::number(spc[i]).toDouble();
+        if (memcmp(&printed, &(*read)[i], sizeof(double)) != 0) {
+            fail("Legacy text read differs", t);
+            return;
+        }
+    }
+
+    std::unique_ptr<Spectrum> shorter(SpectrumCodec::pDecode<CHSIZE>(QVariant(text)));
+    if (shorter) fail("Legacy text read as a channel spectrum", t);
+}
+
+void checkText() {
+    std::vector<double> values;
+    if (!SpectrumCodec::decodeText(" 1, 2.5 ,-3,1e3", values) || values != std::vector<double>{1, 2.5, -3, 1000}) {
+        fail("Legacy text with blanks differs", 0);
+    }
+    const char* malformed[] = {"", "1,,2", "1,2,", "1,abc", ",1"};
+    for (const char* text : malformed) {
+        if (SpectrumCodec::decodeText(text, values)) fail("Malformed legacy text accepted", 0);
+    }
+    std::unique_ptr<HwSpectrum> empty(SpectrumCodec::pDecode<HW_CHSIZE>(QVariant(QByteArray())));
+    if (empty) fail("Empty column read", 0);
+}
+
+} // namespace
+
+int main() {
+    for (int t = 0; t < RUNS; t++) {
+        HwSpectrum spc;
+        makeSpectrum(t, spc);
+        const QByteArray blob = SpectrumCodec::encode(spc);
+
+        checkRoundTrip(t, spc, blob);
+        checkMalformed(t, blob);
+        if (t % 6 != 3) checkLegacyText(t, spc);
+    }
+    checkText();
+
+    HwSpectrum spc;
+    makeSpectrum(0, spc);
+    QByteArray blob;
+    QString text;
+    const double encodeNs = bench::nsPerCall([&]() { blob = SpectrumCodec::encode(spc); });
+    const double textNs   = bench::nsPerCall([&]() { text = spc.toString(); });
+    const double decodeNs = bench::nsPerCall([&]() {
+        std::unique_ptr<HwSpectrum> read(SpectrumCodec::pDecode<HW_CHSIZE>(QVariant(blob)));
+        bench::keep(read);
+    });
+    const double parseNs  = bench::nsPerCall([&]() {
+        std::unique_ptr<HwSpectrum> read(SpectrumCodec::pDecode<HW_CHSIZE>(QVariant(text)));
+        bench::keep(read);
+    });
+
+    printf("SpectrumCodec, %d runs: %s\n", RUNS, failures == 0 ? "ok" : "MISMATCH");
+    printf("count spectrum of %d channels: blob %d bytes, text %d bytes\n", (int) spc.getSize(), (int) blob.size(),
+           (int) text.toUtf8().size());
+    printf("write: text %.1f us, blob %.1f us; read: text %.1f us, blob %.1f us\n", textNs / 1e3, encodeNs / 1e3,
+           parseNs / 1e3, decodeNs / 1e3);
+
+    return failures > 0 ? 1 : 0;
+}
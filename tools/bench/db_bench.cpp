@@ -0,0 +1,306 @@
+/**
+ * Benchmark of the SQLite setup of DatabaseManager: the lookup indexes, WAL and the prepared
+ * statement cache.
+ *
+ * Seeds a scratch database with the schema of DatabaseManager::createTablesIfNotExist(): 100k events
+ * (or the count given as first argument) with their event_detail rows, 20k backgrounds, 20k
+ * calibrations and 2k detectors, spectra as 1100 byte blobs. The lookups DatabaseManager runs are
+ * timed on a plain connection, compiling the SQL on every call, then on a connection configured as
+ * configureConnection() does, after createIndexes() and through SqlStatementCache. An event and its
+ * detail inserted in their own transaction are timed the same way, each on a freshly seeded database.
+ *
+ * Usage: NDTDatabaseBench [events]. Exits with 1 when a statement fails.
+ */
+
+#include "component/SqlStatementCache.h"
+#include "tools/bench/bench.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSqlError>
+#include <QTemporaryDir>
+#include <QVariant>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace nucare;
+
+namespace {
+
+const int DETECTORS    = 2000;
+const int BACKGROUNDS  = 20000;
+const int CALIBRATIONS = 20000;
+const int DETECTOR_IDS = 50; // Backgrounds, calibrations and events spread over these detectors
+const int BLOB_SIZE    = 1100;
+
+// Tables of DatabaseManager::createTablesIfNotExist() the queries below touch
+const char* const TABLES[] = {
+    "CREATE TABLE detector (manufacturer TEXT, instrumentModel TEXT NOT NULL, serialNumber TEXT, "
+    "detectorType TEXT, probeType TEXT, id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+    "detectorCode INTEGER NOT NULL DEFAULT 12, crystalType INTEGER NOT NULL DEFAULT 1)",
+    "CREATE TABLE background (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, spectrum TEXT NOT NULL, "
+    "acqTime INTEGER NOT NULL, realTime REAL NOT NULL, detectorId INTEGER, date TEXT)",
+    "CREATE TABLE calibration (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, detector_id INTEGER NOT NULL "
+    "DEFAULT -1, coef_a INTEGER NOT NULL, coef_b INTEGER NOT NULL, coef_c INTEGER NOT NULL, gc INTEGER, "
+    "ratio REAL NOT NULL DEFAULT 1.0, spectrum TEXT, chpeak_a REAL, chpeak_b REAL, chpeak_c REAL, time TEXT, "
+    "temperature REAL)",
+    "CREATE TABLE event (event_id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, softwareVersion TEXT NOT NULL "
+    "DEFAULT '1.0.0', dateBegin TEXT, dateFinish TEXT, liveTime REAL, realTime REAL, avgGamma_nSv REAL, "
+    "maxGamma_nSv REAL, minGamma_nSv REAL, avgFillCps REAL, detectorId INTEGER, background_id INTEGER, "
+    "calibration_id INTEGER, avgCps REAL NOT NULL DEFAULT 0, maxCps REAL NOT NULL DEFAULT 0, minCps REAL NOT "
+    "NULL DEFAULT 0, e1Energy NUMERIC NOT NULL DEFAULT 0, e1Branching NUMERIC NOT NULL DEFAULT 0, e1Netcount "
+    "NUMERIC NOT NULL DEFAULT 0, e2Energy NUMERIC NOT NULL DEFAULT 0, e2Branching NUMERIC NOT NULL DEFAULT 0, "
+    "e2Netcount NUMERIC NOT NULL DEFAULT 0, PipeMaterial TEXT, PipeThickness NUMERIC NOT NULL DEFAULT 0, "
+    "PipeDiameter NUMERIC NOT NULL DEFAULT 0, ClogMaterial TEXT, ClogDensity NUMERIC NOT NULL DEFAULT 0, "
+    "ClogThickness NUMERIC NOT NULL DEFAULT 0, ClogRatio NUMERIC NOT NULL DEFAULT 0, ClogStatus INTEGER NOT "
+    "NULL DEFAULT 0)",
+    "CREATE TABLE event_detail (id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, spectrum TEXT, event_id "
+    "INTEGER, FOREIGN KEY(event_id) REFERENCES event(event_id) ON DELETE CASCADE ON UPDATE CASCADE)",
+};
+
+// DatabaseManager::createIndexes()
+const char* const INDEXES[] = {
+    "CREATE INDEX idx_background_detector ON background (detectorId, id)",
+    "CREATE INDEX idx_calibration_detector ON calibration (detector_id, id)",
+    "CREATE INDEX idx_event_detail_event ON event_detail (event_id)",
+    "CREATE INDEX idx_detector_criteria ON detector (serialNumber, instrumentModel, probeType, detectorCode, "
+    "crystalType)",
+};
+
+// DatabaseManager::configureConnection()
+const char* const PRAGMAS[] = {
+    "PRAGMA journal_mode = WAL",
+    "PRAGMA synchronous = NORMAL",
+    "PRAGMA cache_size = -8192",
+    "PRAGMA temp_store = MEMORY",
+};
+
+QString serialNumber(int i) { return QString("SN%1").arg(i % DETECTORS, 5, 10, QChar('0')); }
+
+// Lookups as DatabaseManager runs them, bind() sets the keys of call i on a database of events events
+struct Lookup {
+    const char* name;
+    const char* sql;
+    void (*bind)(QSqlQuery& query, int i, int events);
+};
+
+const Lookup LOOKUPS[] = {
+    {"event detail", "SELECT spectrum FROM event_detail WHERE event_id = :event_id LIMIT 1",
+     [](QSqlQuery& query, int i, int events) { query.bindValue(":event_id", 1 + (i * 7919LL) % events); }},
+    {"detector", "SELECT id, manufacturer, instrumentModel, serialNumber, detectorType, probeType, detectorCode, "
+                 "crystalType FROM detector WHERE serialNumber = :serialNumber AND instrumentModel = "
+                 ":instrumentModel AND probeType = :probeType AND detectorCode = :detectorCode AND crystalType = "
+                 ":crystalType",
+     [](QSqlQuery& query, int i, int) {
+         query.bindValue(":serialNumber", serialNumber(i));
+         query.bindValue(":instrumentModel", "M");
+         query.bindValue(":probeType", "P");
+         query.bindValue(":detectorCode", 12);
+         query.bindValue(":crystalType", 1);
+     }},
+    {"calibration", "SELECT id, detector_id, coef_a, coef_b, coef_c, gc, ratio, chpeak_a, chpeak_b, chpeak_c, "
+                    "time, temperature FROM calibration WHERE detector_id = :detector_id ORDER BY id DESC LIMIT 1",
+     [](QSqlQuery& query, int i, int) { query.bindValue(":detector_id", i % DETECTOR_IDS); }},
+    {"background", "SELECT id, spectrum, acqTime, realTime, detectorId, date FROM background WHERE detectorId = "
+                   ":detectorId ORDER BY id DESC LIMIT 1",
+     [](QSqlQuery& query, int i, int) { query.bindValue(":detectorId", i % DETECTOR_IDS); }},
+};
+const int LOOKUP_COUNT = sizeof(LOOKUPS) / sizeof(LOOKUPS[0]);
+
+// One QSQLITE connection, removed again when it goes out of scope
+class Connection
+{
+public:
+    Connection(const QString& path, const QString& name) : m_name(name) {
+        db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(path);
+        if (!db.open()) fprintf(stderr, "Opening %s: %s\n", qPrintable(path), qPrintable(db.lastError().text()));
+        statements.setDatabase(db);
+    }
+
+    ~Connection() {
+        statements.setDatabase(QSqlDatabase());
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_name);
+    }
+
+    QSqlDatabase db;
+    SqlStatementCache statements;
+
+private:
+    QString m_name;
+};
+
+int failures = 0;
+
+bool check(QSqlQuery& query, bool ok) {
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", qPrintable(query.lastQuery()), qPrintable(query.lastError().text()));
+        failures++;
+    }
+    return ok;
+}
+
+bool exec(QSqlDatabase& db, const char* sql) {
+    QSqlQuery query(db);
+    return check(query, query.exec(sql));
+}
+
+// Fresh database at path with events events and their details, returns the spectrum blob
+QByteArray seed(const QString& path, int events) {
+    for (const char* suffix : {"", "-wal", "-shm"}) QFile::remove(path + suffix);
+
+    std::mt19937 rng(1);
+    QByteArray blob(BLOB_SIZE, 0);
+    for (auto& c : blob) c = static_cast<char>(rng() & 0xff);
+
+    Connection c(path, "seed");
+    for (const char* table : TABLES) exec(c.db, table);
+
+    c.db.transaction();
+    QSqlQuery query(c.db);
+    query.prepare("INSERT INTO detector (serialNumber, instrumentModel, probeType, detectorCode, crystalType) "
+                  "VALUES (?, 'M', 'P', 12, 1)");
+    for (int i = 0; i < DETECTORS; i++) {
+        query.addBindValue(serialNumber(i));
+        if (!check(query, query.exec())) break;
+    }
+    query.prepare("INSERT INTO background (spectrum, acqTime, realTime, detectorId) VALUES (?, 1, 1.0, ?)");
+    for (int i = 0; i < BACKGROUNDS; i++) {
+        query.addBindValue(blob);
+        query.addBindValue(i % DETECTOR_IDS);
+        if (!check(query, query.exec())) break;
+    }
+    query.prepare("INSERT INTO calibration (detector_id, coef_a, coef_b, coef_c) VALUES (?, 1, 2, 3)");
+    for (int i = 0; i < CALIBRATIONS; i++) {
+        query.addBindValue(i % DETECTOR_IDS);
+        if (!check(query, query.exec())) break;
+    }
+    query.prepare("INSERT INTO event (detectorId) VALUES (?)");
+    for (int i = 0; i < events; i++) {
+        query.addBindValue(i % DETECTOR_IDS);
+        if (!check(query, query.exec())) break;
+    }
+    query.prepare("INSERT INTO event_detail (spectrum, event_id) VALUES (?, ?)");
+    for (int i = 0; i < events; i++) {
+        query.addBindValue(blob);
+        query.addBindValue(i + 1);
+        if (!check(query, query.exec())) break;
+    }
+    query.finish();
+    c.db.commit();
+    return blob;
+}
+
+// Microseconds per lookup, compiling the SQL on every call unless cached
+void timeLookups(Connection& c, bool cached, int events, double us[]) {
+    for (int k = 0; k < LOOKUP_COUNT; k++) {
+        const Lookup& lookup = LOOKUPS[k];
+        int i                = 0;
+        us[k]                = bench::nsPerCall([&]() {
+            auto run = [&](QSqlQuery& query) {
+                lookup.bind(query, i++, events);
+                if (check(query, query.exec()) && query.next()) bench::keep(query.value(0));
+            };
+            if (cached) {
+                auto query = c.statements.prepare(lookup.sql);
+                run(*query);
+            } else {
+                QSqlQuery query(c.db);
+                query.prepare(lookup.sql);
+                run(query);
+            }
+        }, 200) / 1e3;
+    }
+}
+
+// Microseconds per event and detail insert, each in its own transaction
+double timeInsert(Connection& c, bool cached, const QByteArray& blob) {
+    auto insert = [&](QSqlQuery& event, QSqlQuery& detail) {
+        c.db.transaction();
+        event.bindValue(":detectorId", 1);
+        if (check(event, event.exec())) {
+            detail.bindValue(":event_id", event.lastInsertId());
+            detail.bindValue(":spectrum", blob);
+            check(detail, detail.exec());
+        }
+        c.db.commit();
+    };
+
+    const char* const EVENT  = "INSERT INTO event (detectorId) VALUES (:detectorId)";
+    const char* const DETAIL = "INSERT INTO event_detail (event_id, spectrum) VALUES (:event_id, :spectrum)";
+    return bench::nsPerCall([&]() {
+        if (cached) {
+            auto event  = c.statements.prepare(EVENT);
+            auto detail = c.statements.prepare(DETAIL);
+            insert(*event, *detail);
+        } else {
+            QSqlQuery event(c.db), detail(c.db);
+            event.prepare(EVENT);
+            detail.prepare(DETAIL);
+            insert(event, detail);
+        }
+    }, 200) / 1e3;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    const int events = argc > 1 ? std::max(1, atoi(argv[1])) : 100000;
+
+    QTemporaryDir dir;
+    const QString path = dir.filePath("bench.db");
+
+    printf("%d events, %d backgrounds, %d calibrations, %d detectors\n", events, BACKGROUNDS, CALIBRATIONS,
+           DETECTORS);
+    QByteArray blob = seed(path, events);
+
+    double before[LOOKUP_COUNT], after[LOOKUP_COUNT];
+    double indexMs = 0, insertBefore, insertAfter;
+    {
+        Connection c(path, "before");
+        timeLookups(c, false, events, before);
+    }
+    {
+        Connection c(path, "after");
+        for (const char* pragma : PRAGMAS) exec(c.db, pragma);
+        QElapsedTimer timer;
+        timer.start();
+        for (const char* index : INDEXES) exec(c.db, index);
+        indexMs = timer.nsecsElapsed() / 1e6;
+        timeLookups(c, true, events, after);
+    }
+
+    // Each on a new database, so the rows of the first run don't slow down the second
+    blob = seed(path, events);
+    {
+        Connection c(path, "before");
+        insertBefore = timeInsert(c, false, blob);
+    }
+    blob = seed(path, events);
+    {
+        Connection c(path, "after");
+        for (const char* pragma : PRAGMAS) exec(c.db, pragma);
+        insertAfter = timeInsert(c, true, blob);
+    }
+
+    printf("%-22s %12s %12s %9s\n", "operation", "before us", "after us", "speedup");
+    for (int k = 0; k < LOOKUP_COUNT; k++) {
+        printf("%-22s %12.1f %12.1f %8.1fx\n", LOOKUPS[k].name, before[k], after[k], before[k] / after[k]);
+    }
+    printf("%-22s %12.1f %12.1f %8.1fx\n", "event + detail insert", insertBefore, insertAfter,
+           insertBefore / insertAfter);
+    printf("indexes built in %.0f ms\n", indexMs);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d statements failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
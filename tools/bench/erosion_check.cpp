@@ -0,0 +1,127 @@
+/**
+ * Check of PeakSearch::BGErosion() against the erosion table it replaced.
+ *
+ * BGErosion used to keep all 70 erosion levels of the bin spectrum (70 x BINSIZE doubles) and pick
+ * level passes - 1 for every bin. It now keeps only the current level and takes every bin out once
+ * its own pass count is reached, which must give the same bits. Every entry point (raw arrays,
+ * spectra, precomputed AnalysisContext) is compared bit for bit over a range of calibrations and
+ * random spectra, some with NaN, infinite and negative counts. The run then times both versions.
+ *
+ * Exits with 1 when an entry point differs from the table.
+ */
+
+#include "tools/bench/bench.h"
+#include "util/AnalysisContext.h"
+#include "util/NcLibrary.h"
+#include "util/PeakSearch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+const int RUNS = 200;
+
+const InterCoeff INTER_COEFF = {-0.0000000001, 0.0000005531, -0.0008610261, 0.5684236932,
+                                -53.5185548731, 0.0002779219, -0.0100275772, 5.8129370431};
+const FWHM FWHM_COEFF        = {0.737424355, -4.269930955};
+
+// BGErosion as it was, with every erosion level kept
+void referenceErosion(const BinSpectrum& MSBinSpec, const InterCoeff& IterCoeff, BinSpectrum& bgBinOut,
+                      const BinSpectrum& TF, const Coeffcients& coeff) {
+    const int MaxIter = 70; // Defined: MaxNoIter=70+1
+
+    std::vector<double> DataEro(MaxIter * BINSIZE);
+    for (int iter = 0; iter < MaxIter; iter++) {
+        memcpy(&DataEro[iter * BINSIZE], MSBinSpec.dataConst(), BINSIZE * sizeof(double));
+    }
+
+    // 1st: Erosion and then save array
+    for (int iter = 0; iter < MaxIter - 1; iter++) {
+        double* level = &DataEro[iter * BINSIZE];
+        for (int i = 0; i < (int) BINSIZE; i++) {
+            if (i >= 4 && i <= (int) BINSIZE - 5) {
+                double tmp = (level[i - 4] + level[i + 4]) / 2;
+                if (level[i] > tmp) level[i] = tmp;
+            }
+            level[BINSIZE + i] = level[i];
+        }
+    }
+
+    // 2nd: Level of every bin from the energy of its channel
+    BinSpectrum CHArray;
+    NcLibrary::BinToCh(TF, CHArray);
+    for (int ind = 0; ind < (int) BINSIZE; ind++) {
+        const double x = CHArray.channelToEnergy(CHArray[ind], coeff);
+        double noiter1;
+        if (x <= 145) {
+            noiter1 = (int) (IterCoeff[5] * x * x + IterCoeff[6] * x + IterCoeff[7]);
+        } else {
+            noiter1 = IterCoeff[0] * x * x * x * x + IterCoeff[1] * x * x * x + IterCoeff[2] * x * x +
+                      IterCoeff[3] * x + IterCoeff[4];
+        }
+
+        int noiter = (int) round(noiter1);
+        if (noiter < 2) noiter = 2;
+        if (noiter > MaxIter - 1) noiter = MaxIter - 1;
+
+        bgBinOut[ind] = DataEro[(noiter - 1) * BINSIZE + ind];
+    }
+}
+
+bool sameBits(const BinSpectrum& a, const double* b) { return memcmp(a.dataConst(), b, BINSIZE * sizeof(double)) == 0; }
+
+} // namespace
+
+int main() {
+    int failures = 0;
+
+    for (int t = 0; t < RUNS; t++) {
+        std::mt19937 rng(t);
+        std::uniform_real_distribution<double> gain(0.3, 1.7), linear(1.5, 4), counts(0, 5000);
+        const Coeffcients coeff = {0.000342454 * gain(rng), linear(rng), -8.833218728};
+        const AnalysisContext ctx(coeff, FWHM_COEFF, INTER_COEFF, 1);
+
+        BinSpectrum in;
+        for (size_t i = 0; i < BINSIZE; i++) in[i] = counts(rng);
+        if (t % 5 == 1) {
+            in[100] = std::numeric_limits<double>::quiet_NaN();
+            in[300] = -0.0;
+            in[400] = INFINITY;
+            in[5]   = -1e300;
+        }
+
+        BinSpectrum expected, bySpectrum, byContext;
+        referenceErosion(in, INTER_COEFF, expected, ctx.transferFunction(), coeff);
+        PeakSearch::BGErosion(in, INTER_COEFF, bySpectrum, ctx.transferFunction(), coeff);
+        PeakSearch::BGErosion(in, byContext, ctx);
+
+        BinSpectrum rawIn = in.clone(), rawTF = ctx.transferFunction().clone();
+        double byArray[BINSIZE];
+        PeakSearch::BGErosion(rawIn.data(), INTER_COEFF.data(), byArray, rawTF.data(), coeff);
+
+        if (!sameBits(expected, bySpectrum.dataConst()) || !sameBits(expected, byContext.dataConst()) ||
+            !sameBits(expected, byArray)) {
+            fprintf(stderr, "BGErosion differs from the erosion table, run %d\n", t);
+            failures++;
+        }
+    }
+
+    const Coeffcients coeff = {0.000342454, 2.9, -8.833218728};
+    const AnalysisContext ctx(coeff, FWHM_COEFF, INTER_COEFF, 1);
+    BinSpectrum in, out;
+    for (size_t i = 0; i < BINSIZE; i++) in[i] = 1000 + 500 * sin(i / 20.0);
+
+    const double tableNs = bench::nsPerCall([&]() { referenceErosion(in, INTER_COEFF, out, ctx.transferFunction(), coeff); });
+    const double levelNs = bench::nsPerCall([&]() { PeakSearch::BGErosion(in, out, ctx); });
+    printf("BGErosion, %d runs: %s\n", RUNS, failures == 0 ? "ok" : "MISMATCH");
+    printf("table %.1f us, single level %.1f us, %.2fx\n", tableNs / 1e3, levelNs / 1e3, tableNs / levelNs);
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * Microbenchmark of the detector package framing, component/PackageFramer.h.
+ *
+ * Replays a synthetic capture of Package frames separated by junk (runs of header bytes, so partial
+ * headers show up between frames) through a RingBuffer of the size DetectorIoWorker uses. The
+ * capture is written in randomly sized chunks, as serial reads deliver it, so frames split across
+ * reads and wrap around the end of the buffer. Every frame must come out, the run reports the
+ * throughput and the time per frame for a few chunk size ranges.
+ *
+ * Build with CMAKE_BUILD_TYPE=Release. Exits with 1 when a frame is lost.
+ */
+
+#include "component/PackageFramer.h"
+#include "tools/bench/bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+const size_t FRAME_SIZE = sizeof(Package);
+const int FRAMES        = 500;
+
+// Smallest and largest chunk of one read
+const size_t CHUNKS[][2] = {{1, 64}, {1, 3000}, {512, 8192}};
+
+struct Capture {
+    std::vector<char> stream;
+    int frames = 0;
+};
+
+Capture makeCapture(std::mt19937& rng) {
+    Capture capture;
+    std::vector<char> frame(FRAME_SIZE);
+    for (int k = 0; k < FRAMES; k++) {
+        // Junk made of header bytes only, it never completes a header on its own
+        const int junk = rng() % 50;
+        for (int j = 0; j < junk; j++) capture.stream.push_back(PACKAGE_HEADER[rng() % 3]);
+
+        for (auto& c : frame) c = static_cast<char>(rng() & 0xff);
+        memcpy(frame.data(), PACKAGE_HEADER, sizeof(PACKAGE_HEADER));
+        memcpy(frame.data() + FRAME_SIZE - sizeof(PACKAGE_TAIL), PACKAGE_TAIL, sizeof(PACKAGE_TAIL));
+        capture.stream.insert(capture.stream.end(), frame.begin(), frame.end());
+        capture.frames++;
+    }
+    return capture;
+}
+
+// Same validation as DetectorIoWorker::processPackageData
+bool validFrame(const char* frame) {
+    return memcmp(frame, PACKAGE_HEADER, sizeof(PACKAGE_HEADER)) == 0 &&
+           memcmp(frame + FRAME_SIZE - sizeof(PACKAGE_TAIL), PACKAGE_TAIL, sizeof(PACKAGE_TAIL)) == 0;
+}
+
+// Feed the whole capture in the given read sizes, returns the number of frames taken out
+int replay(const Capture& capture, const std::vector<size_t>& chunks) {
+    static RingBuffer<16384> buffer;
+    static char scratch[sizeof(Package)];
+
+    buffer.clear();
+    int frames    = 0;
+    size_t pos    = 0;
+    size_t nChunk = 0;
+    while (pos < capture.stream.size()) {
+        size_t len = 0;
+        char* dst  = buffer.writeRegion(len);
+        len        = std::min(std::min(len, chunks[nChunk++ % chunks.size()]), capture.stream.size() - pos);
+        memcpy(dst, capture.stream.data() + pos, len);
+        buffer.commit(len);
+        pos += len;
+
+        frames += framePackages(buffer, scratch, [](const char* frame) {
+            bench::keep(frame[sizeof(PACKAGE_HEADER)]);
+            return validFrame(frame);
+        });
+    }
+    return frames;
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(1);
+    const Capture capture = makeCapture(rng);
+    const double mb       = capture.stream.size() / 1e6;
+
+    printf("Package framing, %d frames of %zu bytes, %.2f MB\n", capture.frames, FRAME_SIZE, mb);
+    printf("%-12s %10s %12s   %s\n", "read bytes", "MB/s", "ns/frame", "result");
+
+    int failures = 0;
+    for (const auto& range : CHUNKS) {
+        std::uniform_int_distribution<size_t> chunkSize(range[0], range[1]);
+        std::vector<size_t> chunks(4096);
+        for (auto& c : chunks) c = chunkSize(rng);
+
+        int frames      = 0;
+        const double ns = bench::nsPerCall([&]() { frames = replay(capture, chunks); });
+        const bool ok   = frames == capture.frames;
+        if (!ok) failures++;
+
+        char label[32];
+        snprintf(label, sizeof(label), "%zu-%zu", range[0], range[1]);
+        printf("%-12s %10.1f %12.1f   %s %d/%d\n", label, mb / (ns * 1e-9), ns / capture.frames,
+               ok ? "ok" : "LOST", frames, capture.frames);
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "%d runs lost frames\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+/**
+ * Check of PeakSearch::PeakSearch_Hight() and PeakSearch::PeakSearch_V1() against the code they replaced.
+ *
+ * PeakSearch_Hight used to call PeakSearch_V1 on the 2 sigma window, then the 3 sigma window, then the
+ * whole K40 ROI, every call checking the deviation of the ROI and scanning its window again. It now
+ * scans the union of the windows once. Over synthetic spectra (a few peaks around K40 on an
+ * exponential continuum, Poisson noise) and a range of FWHM, calibrations and thresholds, both must
+ * return the same channels as before. Every window has to be the first with a peak for some spectra,
+ * so each fallback is covered. The run then times both versions of PeakSearch_Hight.
+ *
+ * Exits with 1 when a result differs.
+ */
+
+#include "tools/bench/bench.h"
+#include "util/NcLibrary.h"
+#include "util/PeakSearch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+const int RUNS = 3000;
+
+// PeakSearch_V1 and PeakSearch_Hight as they were, with the three calls
+namespace reference {
+
+std::vector<int> PeakSearch_V1(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff, const double thshold,
+                               const Threshold& thsholdK40, const Threshold& theshold1, const int MaxDist2Peaks = 1) {
+    int peaklist[NO_MAX_K40] = {0};
+    int templist[NO_MAX_K40] = {0};
+    auto data                = in->dataConst();
+    std::vector<int> ret;
+
+    double Std_dev = PeakSearch::CalStdDevSpc(in, thsholdK40);
+
+    if (Std_dev > 17) {
+        int IndexMax = nucare::indexOfMax(data, theshold1.first, theshold1.second);
+        double MAX   = data[IndexMax];
+
+        double PeakAvg   = (theshold1.first + theshold1.second) / 2.0;
+        double FWHM_Peak = NcLibrary::channelToFWHM(PeakAvg, fwhm, coeff);
+
+        double PeakMinWidth = 4.0 / 2.355 * FWHM_Peak;
+        double halfWidth    = (PeakMinWidth / 2.0) * 0.8;
+        double quarterWidth = halfWidth / 2.0;
+
+        int ch2 = (int) round(halfWidth - quarterWidth / 2.0);
+        int ch3 = (int) round(quarterWidth);
+        int ch4 = (int) round(quarterWidth - quarterWidth / 2.0);
+
+        int peakCount      = 0;
+        double thshold_val = thshold * MAX;
+
+        for (int i = (int) theshold1.first; i <= (int) theshold1.second; i++) {
+            if (data[i] > thshold_val) {
+                if (data[i - ch2] < data[i - ch3] && data[i + ch2] < data[i + ch3]) {
+                    if (data[i - ch3] < data[i - ch4] && data[i + ch3] < data[i + ch4]) {
+                        if (data[i - ch4] < data[i] && data[i + ch4] < data[i]) {
+                            if (peakCount < NO_MAX_K40) {
+                                templist[peakCount] = i;
+                                peakCount           = peakCount + 1;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        int realPeakCount = 0;
+        int ind           = 0;
+        double maxval     = 0;
+        int maxch         = 0;
+        int index0        = 0;
+
+        for (int i = 0; i < peakCount; i++) {
+            index0 = templist[i];
+            maxval = data[index0];
+            maxch  = i;
+
+            if (i > 0 && i <= ind - 1) {
+                continue;
+            }
+
+            int j = 0;
+            for (j = i + 1; j < peakCount - 1; j++) {
+                if (abs((long) (templist[j] - templist[j + 1])) <= MaxDist2Peaks) {
+                    index0 = templist[j];
+                    if (maxval < data[index0]) {
+                        maxval = data[index0];
+                        maxch  = j;
+                    }
+                } else {
+                    break;
+                }
+            }
+            ind = j + 1;
+
+            peaklist[realPeakCount] = templist[maxch];
+            realPeakCount           = realPeakCount + 1;
+
+            if (ind == peakCount - 1) {
+                break;
+            }
+        }
+
+        for (int i = 0; i < realPeakCount; i++) {
+            ret.push_back(peaklist[i]);
+        }
+    }
+
+    return ret;
+}
+
+// The windows of PeakSearch_Hight: 2 sigma, 3 sigma and the whole K40 ROI
+void hightWindows(const FWHM& fwhm, const Threshold& k40Thshold, Threshold windows[3]) {
+    double PeakAvg  = (k40Thshold.first + k40Thshold.second) / 2.0;
+    double FWHM_K40 = fwhm[0] * sqrt(PeakAvg) + fwhm[1];
+
+    double Width_2Sig = FWHM_K40 * 4.0 / 2.355;
+    double Width_3Sig = FWHM_K40 * 6.0 / 2.355;
+
+    windows[0] = Threshold(round(PeakAvg - Width_2Sig / 2.0), round(PeakAvg + Width_2Sig / 2.0));
+    windows[1] = Threshold(round(PeakAvg - Width_3Sig / 2.0), round(PeakAvg + Width_3Sig / 2.0));
+    windows[2] = k40Thshold;
+}
+
+// Also reports the window the result came from, -1 if none has a peak
+std::vector<int> PeakSearch_Hight(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
+                                  const double thshold, const Threshold& k40Thshold, int* window = nullptr) {
+    Threshold windows[3];
+    hightWindows(fwhm, k40Thshold, windows);
+
+    std::vector<int> ret;
+    int k = 0;
+    for (; k < 3 && ret.empty(); k++) ret = PeakSearch_V1(in, fwhm, coeff, thshold, k40Thshold, windows[k]);
+    if (window) *window = ret.empty() ? -1 : k - 1;
+    return ret;
+}
+
+} // namespace reference
+
+struct Case {
+    Spectrum spc;
+    FWHM fwhm;
+    Coeffcients coeff;
+    Threshold k40, window;
+    double thshold;
+};
+
+// Spectrum t: one to six peaks 17 channels apart around a random K40 channel
+void makeCase(int t, Case& c) {
+    std::mt19937 rng(t);
+    const double center = 380 + (int) (rng() % 80);
+    const int peaks     = 1 + rng() % 6;
+    for (size_t i = 0; i < c.spc.getSize(); i++) {
+        double mean = 200 * exp(-(double) i / 150.0) + 5;
+        for (int p = 0; p < peaks; p++) {
+            const double at    = center - 30 + p * 17 + (rng() % 5);
+            const double width = 10.0 + rng() % 14;
+            mean += (400 + rng() % 4000) * exp(-pow((i - at) / width, 2));
+        }
+        c.spc[i] = std::poisson_distribution<int>(mean)(rng);
+    }
+
+    c.fwhm    = {1.1 + 0.3 * (t % 5) / 5.0, (double) (t % 3)};
+    c.coeff   = {0, 0.8 + 0.1 * (t % 4), 0};
+    c.k40     = Threshold(center - 60 - (t % 7), center + 60 + (t % 5));
+    c.window  = Threshold(center - 20, center + 20 + (t % 3));
+    c.thshold = 0.2 + 0.1 * (t % 6);
+}
+
+} // namespace
+
+int main() {
+    int failures = 0, found = 0;
+    int byWindow[3] = {0};
+
+    Case c;
+    for (int t = 0; t < RUNS; t++) {
+        makeCase(t, c);
+
+        int window       = -1;
+        const auto hight = reference::PeakSearch_Hight(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40, &window);
+        const auto v1    = reference::PeakSearch_V1(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40, c.window, 10);
+        if (window >= 0) byWindow[window]++;
+        if (!v1.empty()) found++;
+
+        if (PeakSearch::PeakSearch_Hight(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40) != hight) {
+            if (failures++ < 10) fprintf(stderr, "PeakSearch_Hight differs, run %d\n", t);
+        }
+        if (PeakSearch::PeakSearch_V1(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40, c.window, 10) != v1) {
+            if (failures++ < 10) fprintf(stderr, "PeakSearch_V1 differs, run %d\n", t);
+        }
+    }
+
+    printf("PeakSearch, %d runs: %s\n", RUNS, failures == 0 ? "ok" : "MISMATCH");
+    printf("Hight peaks in the 2 sigma window %d, 3 sigma %d, K40 ROI %d, none %d; V1 peaks %d\n", byWindow[0],
+           byWindow[1], byWindow[2], RUNS - byWindow[0] - byWindow[1] - byWindow[2], found);
+    for (int k = 0; k < 3; k++) {
+        if (byWindow[k] == 0) {
+            fprintf(stderr, "No spectrum has its first peak in window %d\n", k);
+            failures++;
+        }
+    }
+
+    // A spectrum whose peak only the K40 ROI finds, the old code scanned all three windows
+    int t = 0;
+    for (int window = -1; window != 2 && t < RUNS; t++) {
+        makeCase(t, c);
+        reference::PeakSearch_Hight(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40, &window);
+    }
+    makeCase(t - 1, c);
+    const double threeNs = bench::nsPerCall([&]() {
+        bench::keep(reference::PeakSearch_Hight(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40).size());
+    });
+    const double oneNs = bench::nsPerCall([&]() {
+        bench::keep(PeakSearch::PeakSearch_Hight(&c.spc, c.fwhm, c.coeff, c.thshold, c.k40).size());
+    });
+    printf("PeakSearch_Hight, peak in the K40 ROI: three calls %.2f us, one scan %.2f us, %.2fx\n", threeNs / 1e3,
+           oneNs / 1e3, threeNs / oneNs);
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * Check of the RebinOperator of an AnalysisContext against the rebinning functions they are built from.
+ *
+ * rebinning(), returnRebinning() and hwToChannel() must give what NcLibrary::ReBinning(),
+ * PeakSearch::ReturnReBinning() and HwSpectrum::convertSpectrum() give, over a range of calibrations
+ * (transfer functions from PeakSearch::TransferFunct()) and calibration ratios, on random spectra.
+ * Outputs start from the same junk, so channels one side leaves untouched have to be left untouched by
+ * the other too. The operators may turn an all zero sum from -0 into +0 or the reverse, anything
+ * else must be the same bits. The run then times both versions.
+ *
+ * Exits with 1 when an operator differs from its function.
+ */
+
+#include "tools/bench/bench.h"
+#include "util/AnalysisContext.h"
+#include "util/NcLibrary.h"
+#include "util/PeakSearch.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace nucare;
+
+namespace {
+
+const int RUNS    = 300;
+const double JUNK = 7.25;
+
+const InterCoeff INTER_COEFF = {-0.0000000001, 0.0000005531, -0.0008610261, 0.5684236932,
+                                -53.5185548731, 0.0002779219, -0.0100275772, 5.8129370431};
+
+// Same bits, where +0 and -0 count as the same
+template <class Spectrum_t>
+bool sameValues(const Spectrum_t& a, const Spectrum_t& b) {
+    for (size_t i = 0; i < a.getSize(); i++) {
+        if (memcmp(&a[i], &b[i], sizeof(double)) != 0 && !(a[i] == 0 && b[i] == 0)) return false;
+    }
+    return true;
+}
+
+template <class Spectrum_t>
+void fillRandom(Spectrum_t& spc, std::mt19937& rng) {
+    std::uniform_real_distribution<double> counts(0, 5000);
+    for (size_t i = 0; i < spc.getSize(); i++) spc[i] = counts(rng);
+}
+
+template <class Spectrum_t>
+void fillJunk(Spectrum_t& spc) {
+    for (size_t i = 0; i < spc.getSize(); i++) spc[i] = JUNK;
+}
+
+void report(const char* name, int failures, double functionNs, double operatorNs) {
+    printf("%-16s %12.2f %12.2f %7.2fx   %s\n", name, functionNs / 1e3, operatorNs / 1e3, functionNs / operatorNs,
+           failures == 0 ? "ok" : "MISMATCH");
+}
+
+} // namespace
+
+int main() {
+    int rebinFailures = 0, returnFailures = 0, convertFailures = 0;
+
+    for (int t = 0; t < RUNS; t++) {
+        std::mt19937 rng(t);
+        std::uniform_real_distribution<double> gain(0.3, 1.7), linear(1.5, 4), resolution(0.7, 1.6), ratios(1, 3);
+        const Coeffcients coeff = {0.000342454 * gain(rng), linear(rng), -8.833218728};
+        const FWHM fwhm         = {resolution(rng), -4.269930955 * (t % 3) / 2};
+        // Also no rebinning at all, convertSpectrum() then only copies
+        const double ratio = t % 10 == 0 ? 0.9 : t % 10 == 1 ? 1 : ratios(rng);
+        const AnalysisContext ctx(coeff, fwhm, INTER_COEFF, ratio);
+
+        BinSpectrum tf;
+        PeakSearch::TransferFunct(tf, fwhm, coeff);
+        if (!sameValues(tf, ctx.transferFunction())) {
+            fprintf(stderr, "Transfer function of the context differs, run %d\n", t);
+            rebinFailures++;
+        }
+
+        Spectrum ch;
+        fillRandom(ch, rng);
+        BinSpectrum binExpected, binActual;
+        fillJunk(binExpected);
+        fillJunk(binActual);
+        NcLibrary::ReBinning(ch, tf, binExpected);
+        ctx.rebinning().apply(ch.dataConst(), binActual.data());
+        if (!sameValues(binExpected, binActual)) {
+            fprintf(stderr, "rebinning() differs from NcLibrary::ReBinning(), run %d\n", t);
+            rebinFailures++;
+        }
+
+        BinSpectrum bin;
+        fillRandom(bin, rng);
+        Spectrum chExpected, chActual;
+        fillJunk(chExpected);
+        fillJunk(chActual);
+        PeakSearch::ReturnReBinning(bin, tf, chExpected);
+        ctx.returnRebinning().apply(bin.dataConst(), chActual.data());
+        if (!sameValues(chExpected, chActual)) {
+            fprintf(stderr, "returnRebinning() differs from PeakSearch::ReturnReBinning(), run %d\n", t);
+            returnFailures++;
+        }
+
+        HwSpectrum hw;
+        fillRandom(hw, rng);
+        fillJunk(chExpected);
+        fillJunk(chActual);
+        HwSpectrum::convertSpectrum(hw, chExpected, ratio);
+        ctx.hwToChannel().apply(hw.dataConst(), chActual.data());
+        if (!sameValues(chExpected, chActual)) {
+            fprintf(stderr, "hwToChannel() differs from convertSpectrum() with ratio %g, run %d\n", ratio, t);
+            convertFailures++;
+        }
+    }
+
+    printf("%-16s %12s %12s %8s   %s\n", "rebinning", "function us", "operator us", "speedup", "result");
+
+    const Coeffcients coeff = {0.000342454, 2.9, -8.833218728};
+    const FWHM fwhm         = {0.737424355, -4.269930955};
+    const double ratio      = 1.93;
+    const AnalysisContext ctx(coeff, fwhm, INTER_COEFF, ratio);
+    std::mt19937 rng(1);
+    Spectrum ch;
+    BinSpectrum bin;
+    HwSpectrum hw;
+    fillRandom(ch, rng);
+    fillRandom(bin, rng);
+    fillRandom(hw, rng);
+    BinSpectrum binOut;
+    Spectrum chOut;
+
+    report("ReBinning", rebinFailures,
+           bench::nsPerCall([&]() { NcLibrary::ReBinning(ch, ctx.transferFunction(), binOut); }),
+           bench::nsPerCall([&]() { ctx.rebinning().apply(ch.dataConst(), binOut.data()); }));
+    report("ReturnReBinning", returnFailures,
+           bench::nsPerCall([&]() { PeakSearch::ReturnReBinning(bin, ctx.transferFunction(), chOut); }),
+           bench::nsPerCall([&]() { ctx.returnRebinning().apply(bin.dataConst(), chOut.data()); }));
+    report("convertSpectrum", convertFailures,
+           bench::nsPerCall([&]() { HwSpectrum::convertSpectrum(hw, chOut, ratio); }),
+           bench::nsPerCall([&]() { ctx.hwToChannel().apply(hw.dataConst(), chOut.data()); }));
+
+    return rebinFailures + returnFailures + convertFailures > 0 ? 1 : 0;
+}
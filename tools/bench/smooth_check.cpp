@@ -0,0 +1,174 @@
+/**
+ * Check of NcLibrary::smoothSpectrum() and NcLibrary::AdaptFilter() against the direct window sums
+ * they replaced.
+ *
+ * Both filters take every window sum from a prefix sum, which only changes the rounding. Over
+ * synthetic spectra (a peak on an exponential continuum with Poisson noise) and a range of smoothing
+ * parameters and calibrations, the output must stay within 1e-12 of the largest output value, also
+ * when filtering in place. The run then times both versions.
+ *
+ * Exits with 1 when a filter is out of tolerance.
+ */
+
+#include "tools/bench/bench.h"
+#include "util/NcLibrary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+const double TOLERANCE = 1e-12;
+const int RUNS         = 200;
+
+// Filters summing every window directly, as NcLibrary did before the prefix sums
+namespace reference {
+
+template <class Spectrum_t>
+void smoothSpectrum(Spectrum_t& spc, Spectrum_t& out, const std::pair<double, double>& smoothPar) {
+    const int chSize = (int) out.getSize();
+    const double aval = smoothPar.first;
+    const double bval = smoothPar.second;
+    const double temp_wind = round(aval * chSize + bval);
+
+    std::vector<double> temp(spc.dataConst(), spc.dataConst() + chSize);
+    out.setAcqTime(spc.getAcqTime());
+    out.setRealTime(spc.getRealTime());
+
+    for (int nosmoo = 1; nosmoo <= 2; nosmoo++) {
+        if (nosmoo > 1) std::copy(out.dataConst(), out.dataConst() + chSize, temp.begin());
+
+        for (int j = 3; j < chSize - temp_wind; j++) {
+            int wnd = (int) floor(aval * (j + 1) + bval);
+            if (wnd % 2 == 0) wnd = wnd + 1;
+            const int wnd_half = wnd / 2;
+
+            double sum1 = 0;
+            for (int k = j - wnd_half; k <= j + wnd_half; k++) {
+                if (k >= 0 && k < chSize) sum1 = sum1 + temp[k];
+            }
+            out[j] = sum1 / wnd;
+        }
+    }
+}
+
+template <class Spectrum_t>
+void AdaptFilter(const Spectrum_t* in, Spectrum_t* out, const FHM& fhm, const Coeffcients* coeffs, nucare::uint repeat) {
+    using Channel = typename Spectrum_t::Channel;
+    const bool byChannel = coeffs == nullptr;
+    const size_t n       = in->getSize();
+
+    double temp_wind = round(byChannel ? NcLibrary::energyToFWHM(n, fhm) : NcLibrary::channelToFWHM(n, fhm, *coeffs));
+    if (temp_wind <= 0) temp_wind = 1;
+
+    std::vector<Channel> data(in->dataConst(), in->dataConst() + n);
+    auto dataOut = out->data();
+    std::fill(dataOut, dataOut + n, 0);
+
+    for (nucare::uint nosmoo = 1; nosmoo <= repeat; nosmoo++) {
+        if (nosmoo > 1) std::copy(dataOut, dataOut + n, data.begin());
+
+        for (nucare::uint j = 3; j < n - temp_wind; j++) {
+            const double wnd0 =
+                byChannel ? NcLibrary::energyToFWHM(j + 1, fhm) : NcLibrary::channelToFWHM(j + 1, fhm, *coeffs);
+            int wnd = (int) wnd0;
+            if (wnd % 2 == 0) wnd = wnd + 1;
+            const int wnd_half = (int) floor(wnd / 2.0);
+
+            const nucare::uint start = std::max(0, (int) j - wnd_half);
+            const nucare::uint end   = std::min<size_t>(j + wnd_half + 1, byChannel ? n : CHSIZE);
+
+            double sum1 = 0;
+            for (nucare::uint k = start; k < end; k++) sum1 += data[k];
+            dataOut[j] = sum1 / (double) wnd;
+        }
+    }
+}
+
+} // namespace reference
+
+template <class Spectrum_t>
+double relDiff(const Spectrum_t& a, const Spectrum_t& b) {
+    return bench::maxRelDiff(a.dataConst(), b.dataConst(), a.getSize());
+}
+
+void report(const char* name, double worst, double loopNs, double prefixNs, int& failures) {
+    const bool ok = worst <= TOLERANCE;
+    if (!ok) failures++;
+    printf("%-16s %12.1f %12.1f %7.2fx   %-8s %.3g\n", name, loopNs / 1e3, prefixNs / 1e3, loopNs / prefixNs,
+           ok ? "ok" : "MISMATCH", worst);
+}
+
+} // namespace
+
+int main() {
+    double worstSmooth = 0, worstAdapt = 0, worstAdaptHw = 0;
+
+    for (int t = 0; t < RUNS; t++) {
+        std::mt19937 rng(t);
+        Spectrum spc;
+        HwSpectrum hwSpc;
+        for (size_t i = 0; i < spc.getSize(); i++) {
+            const double mean = 5e4 * exp(-pow((i - 300) / 12.0, 2)) + 2e5 * exp(-(double) i / 80.0);
+            spc[i]            = std::poisson_distribution<int>(std::max(1.0, mean * (1 + t % 5)))(rng);
+        }
+        for (size_t i = 0; i < hwSpc.getSize(); i++) hwSpc[i] = spc[i / 2] / 2;
+
+        const std::pair<double, double> smoothPar(0.0115820221 * (1 + t % 3 * 0.3), 5.6739379103 - t % 4);
+        Spectrum expected, actual;
+        reference::smoothSpectrum(spc, expected, smoothPar);
+        NcLibrary::smoothSpectrum(spc, actual, smoothPar);
+        worstSmooth = std::max(worstSmooth, relDiff(expected, actual));
+
+        // In place, the prefix sum has to be taken before the output overwrites the input
+        expected.copyFrom(spc);
+        actual.copyFrom(spc);
+        reference::smoothSpectrum(expected, expected, smoothPar);
+        NcLibrary::smoothSpectrum(actual, actual, smoothPar);
+        worstSmooth = std::max(worstSmooth, relDiff(expected, actual));
+
+        const FHM fhm            = {1.2 + 0.1 * (t % 4), -1.0 + t % 3};
+        const Coeffcients coeffs = {1e-4 * (t % 3), 2.9 + 0.01 * t, -10.0 + t % 7};
+        reference::AdaptFilter(&spc, &expected, fhm, &coeffs, 3);
+        NcLibrary::AdaptFilter(&spc, &actual, fhm, &coeffs, 3);
+        worstAdapt = std::max(worstAdapt, relDiff(expected, actual));
+
+        const FHM fhmCh = {0.9 + 0.05 * (t % 5), 2.0};
+        HwSpectrum hwExpected, hwActual;
+        reference::AdaptFilter(&hwSpc, &hwExpected, fhmCh, nullptr, 3);
+        NcLibrary::AdaptFilter(&hwSpc, &hwActual, fhmCh, nullptr, 3);
+        worstAdaptHw = std::max(worstAdaptHw, relDiff(hwExpected, hwActual));
+    }
+
+    printf("%-16s %12s %12s %8s   %-8s %s\n", "filter", "direct us", "prefix us", "speedup", "result", "difference");
+
+    int failures = 0;
+    Spectrum spc, out;
+    for (size_t i = 0; i < spc.getSize(); i++) spc[i] = 1000 + i;
+    const std::pair<double, double> smoothPar(0.0115820221, 5.6739379103);
+    report("smoothSpectrum", worstSmooth, bench::nsPerCall([&]() { reference::smoothSpectrum(spc, out, smoothPar); }),
+           bench::nsPerCall([&]() { NcLibrary::smoothSpectrum(spc, out, smoothPar); }), failures);
+
+    const FHM fhm            = {1.3, 0};
+    const Coeffcients coeffs = {0, 2.9, -10};
+    report("AdaptFilter", worstAdapt, bench::nsPerCall([&]() { reference::AdaptFilter(&spc, &out, fhm, &coeffs, 3); }),
+           bench::nsPerCall([&]() { NcLibrary::AdaptFilter(&spc, &out, fhm, &coeffs, 3); }), failures);
+
+    HwSpectrum hwSpc, hwOut;
+    for (size_t i = 0; i < hwSpc.getSize(); i++) hwSpc[i] = i;
+    const FHM fhmCh = {0.95, 2};
+    report("AdaptFilter ch", worstAdaptHw,
+           bench::nsPerCall([&]() { reference::AdaptFilter(&hwSpc, &hwOut, fhmCh, nullptr, 3); }),
+           bench::nsPerCall([&]() { NcLibrary::AdaptFilter(&hwSpc, &hwOut, fhmCh, nullptr, 3); }), failures);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d filters differ from the direct sums by more than %g\n", failures, TOLERANCE);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * Check of ndt::solve_tc_from_Est_E2() against the fixed point iteration it replaced.
+ *
+ * The iteration ran up to 10000 steps and stopped once a step was below 1e-6. The closed form root
+ * must agree with it over random inputs, around the clog model of NcManager and with random
+ * polynomials:
+ * - where the iteration stopped, Converged and within the distance to the root that stopping rule
+ *   leaves, 1e-6 / (1 - |g'|) with g' the slope of the update at the root. Unless the iteration stopped
+ *   on a repelling fixed point (|g'| above 1), which a chaotic orbit hits by chance: NotConverged;
+ * - where it ran out of steps, NotConverged, unless it was still closing in on the root with |g'| above
+ *   0.99, too slowly to stop within 10000 steps. From t0 the quadratic update has no other attractor;
+ * - with both mu_ce ~0, InvalidInput and the clamped start value, as the iteration returned.
+ * The batch overload must give the results of the single one. The run then times the three.
+ *
+ * Exits with 1 when a result is off.
+ */
+
+#include "config.h"
+#include "tools/bench/bench.h"
+#include "util/ndt_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+const int RUNS              = 50000;
+const double STEP_TOLERANCE = 1e-6;
+const double SLOW_SLOPE     = 0.99;
+
+// Clog model of NcManager::runClog()
+const std::vector<double> CLOG_PARAMS = {-0.000896378402362090, 0.171065811466785, 1.84343479877323};
+
+struct Input {
+    double A, B;
+    std::vector<double> params;
+    double mu_ce1, mu_ce2, mu_pe1, mu_pe2, tp, t0;
+};
+
+struct Iterated {
+    double tc;
+    bool stopped; // Stopped on the step size, not after max_iter steps
+};
+
+// estimate_tc_from_Est_E2() as it was, the iteration also reports whether it stopped
+Iterated referenceEstimate(const Input& in) {
+    double tc_est = in.t0;
+
+    // Ensure tc_est is not negative (equivalent to MATLAB's if(tc_est<0) tc_est=0;)
+    if (tc_est < 0) {
+        tc_est = 0;
+    }
+
+    const int max_iter = 10000;
+    const double tol   = 1e-6; // Tolerance for convergence
+
+    double a1 = in.params[0];
+    double b1 = in.params[1];
+    double c1 = in.params[2];
+
+    for (int iter = 0; iter < max_iter; ++iter) {
+        double k1 = POLY(tc_est, a1, b1, c1);
+        double k2 = 1.0;
+
+        double numerator   = in.mu_ce1 * (k1 * in.A - in.mu_pe1 * in.tp) + in.mu_ce2 * (k2 * in.B - in.mu_pe2 * in.tp);
+        double denominator = std::pow(in.mu_ce1, 2) + std::pow(in.mu_ce2, 2);
+
+        // Avoid division by zero if denominator is too small
+        if (std::abs(denominator) < 1e-12) {
+            return {tc_est, true};
+        }
+
+        double tc_new = numerator / denominator;
+
+        if (std::abs(tc_new - tc_est) < tol) {
+            return {tc_est, true};
+        }
+
+        tc_est = tc_new; // Update estimate for next iteration
+    }
+
+    return {tc_est, false};
+}
+
+ndt::TcEstimate solve(const Input& in) {
+    return ndt::solve_tc_from_Est_E2(in.A, in.B, in.params, in.mu_ce1, in.mu_ce2, in.mu_pe1, in.mu_pe2, in.tp, in.t0);
+}
+
+// |g'| of the update at t
+double slope(const Input& in, double t) {
+    const double denominator = in.mu_ce1 * in.mu_ce1 + in.mu_ce2 * in.mu_ce2;
+    return std::abs(in.mu_ce1 * in.A * (2 * in.params[0] * t + in.params[1]) / denominator);
+}
+
+Input randomInput(int t, std::mt19937& rng) {
+    std::uniform_real_distribution<double> u(0, 1);
+    Input in;
+    const double scale = t % 3 ? 5 : 500;
+    in.A               = u(rng) * scale;
+    in.B               = u(rng) * scale;
+    in.mu_ce1          = 0.05 + u(rng) * 0.5;
+    in.mu_ce2          = 0.05 + u(rng) * 0.3;
+    in.mu_pe1          = 0.1 + u(rng) * 2;
+    in.mu_pe2          = 0.1 + u(rng);
+    in.tp              = u(rng) * (t % 4 ? 1 : 20);
+    in.t0              = t % 5 ? 0.5 : u(rng) * 40 - 5;
+    in.params          = t % 2 ? CLOG_PARAMS : std::vector<double>{(u(rng) - 0.5) * 0.2, (u(rng) - 0.5) * 3, u(rng) * 4};
+    if (t % 97 == 0) {
+        // Both mu_ce ~0, the update is undefined
+        in.mu_ce1 = 1e-8 * u(rng);
+        in.mu_ce2 = 0;
+    }
+    return in;
+}
+
+struct Counts {
+    int converged = 0, notConverged = 0, invalid = 0, repelling = 0, slow = 0, failures = 0;
+    double worst = 0; // Largest relative difference to a stopped iteration
+};
+
+void fail(Counts& counts, int t, const char* what, double iterated, const ndt::TcEstimate& solved) {
+    if (counts.failures++ < 10) {
+        fprintf(stderr, "run %d: %s, iterated %.9g, solved %.9g (status %d)\n", t, what, iterated, solved.tc,
+                solved.status);
+    }
+}
+
+void check(const Input& in, int t, const ndt::TcEstimate& solved, Counts& counts) {
+    const Iterated iterated = referenceEstimate(in);
+
+    const double denominator = in.mu_ce1 * in.mu_ce1 + in.mu_ce2 * in.mu_ce2;
+    if (denominator < 1e-12) {
+        counts.invalid++;
+        if (solved.status != ndt::TcEstimate::InvalidInput || solved.tc != iterated.tc) {
+            fail(counts, t, "not InvalidInput", iterated.tc, solved);
+        }
+        return;
+    }
+
+    if (iterated.stopped && slope(in, iterated.tc) > 1) {
+        counts.repelling++;
+        if (solved.status != ndt::TcEstimate::NotConverged) fail(counts, t, "converged to a repelling point", iterated.tc, solved);
+    } else if (iterated.stopped) {
+        counts.converged++;
+        if (solved.status != ndt::TcEstimate::Converged) {
+            fail(counts, t, "iteration stopped, solver did not converge", iterated.tc, solved);
+            return;
+        }
+        // Distance to the root left by stopping on a step of 1e-6, plus rounding
+        const double g     = slope(in, solved.tc);
+        const double bound = STEP_TOLERANCE / std::max(1 - g, 1e-3) + 1e-12 * std::max(1.0, std::abs(solved.tc));
+        const double diff  = std::abs(iterated.tc - solved.tc);
+        counts.worst       = std::max(counts.worst, diff / std::max(1.0, std::abs(solved.tc)));
+        if (!(diff <= bound)) fail(counts, t, "off the iterated value", iterated.tc, solved);
+    } else if (solved.status == ndt::TcEstimate::Converged && slope(in, solved.tc) > SLOW_SLOPE &&
+               std::abs(iterated.tc - solved.tc) < std::abs(std::max(in.t0, 0.0) - solved.tc)) {
+        counts.slow++;
+    } else {
+        counts.notConverged++;
+        if (solved.status != ndt::TcEstimate::NotConverged || !std::isnan(solved.tc)) {
+            fail(counts, t, "iteration ran out of steps, solver converged", iterated.tc, solved);
+        }
+    }
+}
+
+bool sameResult(const ndt::TcEstimate& a, const ndt::TcEstimate& b) {
+    return a.status == b.status && a.iterations == b.iterations && (a.tc == b.tc || (std::isnan(a.tc) && std::isnan(b.tc)));
+}
+
+} // namespace
+
+int main() {
+    Counts counts;
+    std::mt19937 rng(3);
+    for (int t = 0; t < RUNS; t++) {
+        const Input in = randomInput(t, rng);
+        check(in, t, solve(in), counts);
+
+        // The batch overload, with the pair among others
+        std::vector<double> A(8, in.A), B(8, in.B);
+        A[0] = in.A * 0.5;
+        std::vector<ndt::TcEstimate> batch(A.size());
+        ndt::solve_tc_from_Est_E2(A.data(), B.data(), A.size(), in.params, in.mu_ce1, in.mu_ce2, in.mu_pe1,
+                                  in.mu_pe2, in.tp, in.t0, batch.data());
+        for (size_t i = 0; i < A.size(); i++) {
+            Input pair = in;
+            pair.A     = A[i];
+            if (!sameResult(solve(pair), batch[i])) fail(counts, t, "batch differs", solve(pair).tc, batch[i]);
+        }
+    }
+
+    printf("tc_est, %d runs: %s\n", RUNS, counts.failures == 0 ? "ok" : "MISMATCH");
+    printf("iteration stopped %d (largest difference %.3g), on a repelling point %d, ran out of steps %d, too slow %d, "
+           "invalid %d\n",
+           counts.converged, counts.worst, counts.repelling, counts.notConverged, counts.slow, counts.invalid);
+
+    const size_t n = 4096;
+    std::vector<double> A(n), B(n);
+    std::uniform_real_distribution<double> u(0, 5);
+    for (size_t i = 0; i < n; i++) {
+        A[i] = u(rng);
+        B[i] = u(rng);
+    }
+    std::vector<ndt::TcEstimate> out(n);
+    Input in = {0, 0, CLOG_PARAMS, 0.278, 0.138, 1.21, 0.196, 0.5, 0.5};
+
+    const double iteratedNs = bench::nsPerCall([&]() {
+        for (size_t i = 0; i < n; i++) {
+            in.A = A[i];
+            in.B = B[i];
+            bench::keep(referenceEstimate(in).tc);
+        }
+    });
+    const double singleNs = bench::nsPerCall([&]() {
+        for (size_t i = 0; i < n; i++) {
+            in.A = A[i];
+            in.B = B[i];
+            bench::keep(solve(in).tc);
+        }
+    });
+    const double batchNs = bench::nsPerCall([&]() {
+        ndt::solve_tc_from_Est_E2(A.data(), B.data(), n, CLOG_PARAMS, 0.278, 0.138, 1.21, 0.196, 0.5, 0.5,
+                                  out.data());
+        bench::keep(out[n - 1].tc);
+    });
+    printf("per pair: iterated %.1f ns, closed form %.1f ns, batch %.1f ns\n", iteratedNs / n, singleNs / n,
+           batchNs / n);
+
+    return counts.failures > 0 ? 1 : 0;
+}
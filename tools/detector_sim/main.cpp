@@ -0,0 +1,397 @@
+/**
+ * Detector simulator.
+ *
+ * Opens a pseudo terminal and speaks the detector serial protocol on it, so the
+ * application can be pointed at the printed slave device instead of real hardware:
+ *   A4 : stop streaming, no answer
+ *   GS : answer with a GcPackage ("GD")
+ *   A2 : start streaming Package frames ("UUD0")
+ *   CL : update the calibration channels reported by GS, no answer
+ *   PD : power off, stop streaming
+ *
+ * Frames are generated from a source spectrum shape with Poisson noise, so frame rate,
+ * count rate and pile-up can be pushed far beyond what is safe with real sources.
+ */
+
+#include "component/DetectorProtocol.h"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace nucare;
+
+namespace {
+
+constexpr int HW_CHANNELS = 2048;
+constexpr size_t MAX_PENDING_OUTPUT = sizeof(Package) * 8;
+constexpr double REALTIME_TICK = 0.00002; // Seconds per realtime unit of Package::Payload
+
+struct Options {
+    double frameRate = 1.0;     // Frames per second
+    double cps = 1000.0;        // Count rate of the generated spectrum
+    double realtime = 0;        // Realtime reported per frame, 0 means 1 / frameRate
+    int pileup = 0;
+    int gc = 1000;
+    int detectorCode = 0x0C;    // NaI 3x3
+    int ch32 = 22;
+    int ch662 = 441;
+    int chK40 = 974;
+    double temperature = 25.0;
+    std::string serial = "SIM001";
+    std::string spectrumFile;
+    std::string link;
+    unsigned seed = 0;
+};
+
+volatile sig_atomic_t g_running = 1;
+
+void onSignal(int) { g_running = 0; }
+
+void usage(const char* app) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --rate <hz>          Frames per second (default 1)\n"
+            "  --cps <n>            Count rate of the generated spectrum (default 1000)\n"
+            "  --realtime <s>       Realtime reported per frame (default 1 / rate)\n"
+            "  --pileup <n>         Pile-up count reported per frame (default 0)\n"
+            "  --spectrum <file>    Source spectrum shape, 2048 numbers separated by commas or spaces\n"
+            "  --gc <n>             Gain reported by GS (default 1000)\n"
+            "  --detector-code <n>  Detector code reported by GS (default 12, NaI 3x3)\n"
+            "  --serial <text>      Serial number reported by GS, 6 characters (default SIM001)\n"
+            "  --link <path>        Create a symlink to the slave device\n"
+            "  --seed <n>           Random seed (default: time based)\n",
+            app);
+}
+
+bool parseOptions(int argc, char** argv, Options& opt) {
+    static const option longOptions[] = {
+        {"rate", required_argument, nullptr, 'r'},     {"cps", required_argument, nullptr, 'c'},
+        {"realtime", required_argument, nullptr, 't'}, {"pileup", required_argument, nullptr, 'p'},
+        {"spectrum", required_argument, nullptr, 's'}, {"gc", required_argument, nullptr, 'g'},
+        {"detector-code", required_argument, nullptr, 'd'}, {"serial", required_argument, nullptr, 'n'},
+        {"link", required_argument, nullptr, 'l'},     {"seed", required_argument, nullptr, 'e'},
+        {"help", no_argument, nullptr, 'h'},           {nullptr, 0, nullptr, 0}};
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'r': opt.frameRate = atof(optarg); break;
+            case 'c': opt.cps = atof(optarg); break;
+            case 't': opt.realtime = atof(optarg); break;
+            case 'p': opt.pileup = atoi(optarg); break;
+            case 's': opt.spectrumFile = optarg; break;
+            case 'g': opt.gc = atoi(optarg); break;
+            case 'd': opt.detectorCode = strtol(optarg, nullptr, 0); break;
+            case 'n': opt.serial = optarg; break;
+            case 'l': opt.link = optarg; break;
+            case 'e': opt.seed = strtoul(optarg, nullptr, 0); break;
+            default: return false;
+        }
+    }
+
+    if (opt.frameRate <= 0 || opt.cps < 0) {
+        fprintf(stderr, "Rate must be positive and cps not negative\n");
+        return false;
+    }
+    if (opt.realtime <= 0) opt.realtime = 1.0 / opt.frameRate;
+    return true;
+}
+
+// Default shape: exponential continuum with Cs-137 and K-40 photopeaks
+std::vector<double> defaultShape(const Options& opt) {
+    std::vector<double> shape(HW_CHANNELS);
+    auto peak = [](double ch, double center, double fwhmRatio) {
+        double sigma = std::max(center * fwhmRatio / 2.355, 1.0);
+        return exp(-0.5 * (ch - center) * (ch - center) / (sigma * sigma));
+    };
+
+    for (int i = 0; i < HW_CHANNELS; i++) {
+        shape[i] = exp(-i / 300.0) + 0.8 * peak(i, opt.ch662, 0.07) + 0.1 * peak(i, opt.chK40, 0.06);
+    }
+    return shape;
+}
+
+bool loadShape(const std::string& path, std::vector<double>& shape) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    shape.clear();
+    std::string token;
+    while (in >> token) {
+        size_t start = 0;
+        while (start < token.size()) {
+            size_t end = token.find(',', start);
+            if (end == std::string::npos) end = token.size();
+            if (end > start) shape.push_back(atof(token.substr(start, end - start).c_str()));
+            start = end + 1;
+        }
+    }
+    return shape.size() == HW_CHANNELS;
+}
+
+class Simulator
+{
+public:
+    Simulator(int fd, const Options& opt, std::vector<double> shape)
+        : m_fd(fd), m_opt(opt), m_rng(opt.seed ? opt.seed : std::random_device()()) {
+        double total = 0;
+        for (auto v : shape) total += std::max(v, 0.0);
+        m_expected.resize(HW_CHANNELS);
+        for (int i = 0; i < HW_CHANNELS; i++) {
+            m_expected[i] = total > 0 ? std::max(shape[i], 0.0) / total * opt.cps * opt.realtime : 0;
+        }
+    }
+
+    void run() {
+        using Clock = std::chrono::steady_clock;
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_opt.frameRate));
+        auto nextFrame = Clock::now() + period;
+        auto lastReport = Clock::now();
+
+        while (g_running) {
+            int timeoutMs = -1;
+            if (m_streaming) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame - Clock::now()).count();
+                timeoutMs = std::max<long long>(wait, 0);
+            }
+            if (!m_pending.empty()) timeoutMs = timeoutMs < 0 ? 10 : std::min(timeoutMs, 10);
+
+            pollfd pfd = {m_fd, POLLIN, 0};
+            if (!m_pending.empty()) pfd.events |= POLLOUT;
+            if (poll(&pfd, 1, timeoutMs < 0 ? 1000 : timeoutMs) < 0) {
+                if (errno == EINTR) continue;
+                perror("poll");
+                break;
+            }
+
+            if (pfd.revents & POLLIN) readCommands();
+            flush();
+
+            auto now = Clock::now();
+            if (m_restart) {
+                // Answer A2 right away, the application waits for any data after it
+                m_restart = false;
+                nextFrame = now;
+            }
+            if (m_streaming) {
+                // Catch up when frames are late, but never burst more than one second worth
+                int burst = 0;
+                while (now >= nextFrame && burst++ < std::max(1, (int) m_opt.frameRate)) {
+                    sendFrame();
+                    nextFrame += period;
+                }
+                if (now >= nextFrame) nextFrame = now + period;
+            }
+
+            if (now - lastReport >= std::chrono::seconds(5)) {
+                lastReport = now;
+                fprintf(stderr, "frames sent: %llu, dropped: %llu, clamped channels: %llu\n", m_framesSent,
+                        m_framesDropped, m_clampedChannels);
+            }
+        }
+    }
+
+private:
+    int m_fd;
+    Options m_opt;
+    std::mt19937 m_rng;
+    std::vector<double> m_expected;
+    std::vector<char> m_input;
+    std::vector<char> m_pending;
+    bool m_streaming = false;
+    bool m_restart = false;
+    unsigned long long m_framesSent = 0;
+    unsigned long long m_framesDropped = 0;
+    unsigned long long m_clampedChannels = 0;
+
+    void readCommands() {
+        char buf[256];
+        ssize_t n = read(m_fd, buf, sizeof(buf));
+        if (n <= 0) return;
+        m_input.insert(m_input.end(), buf, buf + n);
+
+        size_t pos = 0;
+        while (m_input.size() - pos >= 2) {
+            const char* cmd = m_input.data() + pos;
+            if (cmd[0] == 'A' && cmd[1] == '4') {
+                fprintf(stderr, "A4: stop\n");
+                m_streaming = false;
+                m_pending.clear();
+                pos += 2;
+            } else if (cmd[0] == 'A' && cmd[1] == '2') {
+                fprintf(stderr, "A2: start streaming\n");
+                m_streaming = true;
+                m_restart   = true;
+                pos += 2;
+            } else if (cmd[0] == 'G' && cmd[1] == 'S') {
+                fprintf(stderr, "GS: detector info\n");
+                sendInfo();
+                pos += 2;
+            } else if (cmd[0] == 'P' && cmd[1] == 'D') {
+                fprintf(stderr, "PD: power off\n");
+                m_streaming = false;
+                pos += 2;
+            } else if (cmd[0] == 'C' && cmd[1] == 'L') {
+                if (m_input.size() - pos < sizeof(UpdateCalibReq)) break; // Wait for the whole request
+                applyCalib(cmd);
+                pos += sizeof(UpdateCalibReq);
+            } else {
+                pos++; // Resynchronize on unknown bytes
+            }
+        }
+        m_input.erase(m_input.begin(), m_input.begin() + pos);
+    }
+
+    void applyCalib(const char* data) {
+        uint16_t values[5];
+        memcpy(values, data + 2, sizeof(values)); // gain, temperature, ch32, ch662, chK40
+        m_opt.ch32  = be16toh(values[2]);
+        m_opt.ch662 = be16toh(values[3]);
+        m_opt.chK40 = be16toh(values[4]);
+        fprintf(stderr, "CL: calibration %d, %d, %d\n", m_opt.ch32, m_opt.ch662, m_opt.chK40);
+    }
+
+    void sendInfo() {
+        GcPackage pkg;
+        memset(&pkg, 0, sizeof(pkg));
+        auto& p = *reinterpret_cast<GcPackage::Payload*>(pkg.Bytes);
+        memcpy(p.header, INFO_HEADER, sizeof(p.header));
+        p.gain            = htobe16(m_opt.gc);
+        p.k40Ch           = htobe16(m_opt.chK40);
+        p.detectorCode    = htobe16(m_opt.detectorCode);
+        p.ch32Kev         = htobe16(m_opt.ch32);
+        p.ch662Kev        = htobe16(m_opt.ch662);
+        p.temperatureFlag = 'T';
+        p.temperature     = rawTemperature();
+        memset(p.serial, ' ', sizeof(p.serial));
+        memcpy(p.serial, m_opt.serial.data(), std::min(m_opt.serial.size(), sizeof(p.serial)));
+        memcpy(p.tail, PACKAGE_TAIL, sizeof(p.tail));
+        queue(pkg.Bytes, sizeof(pkg.Bytes));
+    }
+
+    void sendFrame() {
+        if (m_pending.size() + sizeof(Package) > MAX_PENDING_OUTPUT) {
+            m_framesDropped++; // Reader is not keeping up, like a full UART FIFO
+            return;
+        }
+
+        Package pkg;
+        memset(&pkg, 0, sizeof(pkg));
+        auto& p = *reinterpret_cast<Package::Payload*>(pkg.Bytes);
+        memcpy(p.header, PACKAGE_HEADER, sizeof(p.header));
+
+        uint16_t channels[HW_CHANNELS];
+        for (int i = 0; i < HW_CHANNELS; i++) {
+            unsigned long count = 0;
+            if (m_expected[i] > 0) count = std::poisson_distribution<unsigned long>(m_expected[i])(m_rng);
+            if (count / std::max(m_opt.realtime, 1.0) > 15000) m_clampedChannels++;
+            channels[i] = htobe16((uint16_t) std::min<unsigned long>(count, 0xFFFF));
+        }
+        memcpy(pkg.Bytes + sizeof(p.header), channels, sizeof(channels));
+
+        p.offset1[0]   = '3';
+        p.offset1[1]   = '3';
+        p.realtime     = htobe64((uint64_t) llround(m_opt.realtime / REALTIME_TICK)) >> 16;
+        p.pileup       = htobe16(m_opt.pileup);
+        p.detectorCode = htobe16(m_opt.detectorCode);
+        p.gc           = htobe16(m_opt.gc);
+        p.ch32kev      = htobe16(m_opt.ch32);
+        p.ch662kev     = htobe16(m_opt.ch662);
+        p.ch1460kev    = htobe16(m_opt.chK40);
+        p.tempOutside  = htobe16(rawTemperature());
+        memcpy(p.tail + 18, PACKAGE_TAIL, sizeof(PACKAGE_TAIL));
+
+        queue(pkg.Bytes, sizeof(pkg.Bytes));
+        m_framesSent++;
+    }
+
+    // Inverse of the conversion in the application: temperature = raw * 330 / 4096 - 60
+    uint16_t rawTemperature() const { return (uint16_t) lround((m_opt.temperature + 60) * 4096 / 330); }
+
+    void queue(const char* data, size_t size) {
+        m_pending.insert(m_pending.end(), data, data + size);
+        flush();
+    }
+
+    void flush() {
+        while (!m_pending.empty()) {
+            ssize_t n = write(m_fd, m_pending.data(), m_pending.size());
+            if (n <= 0) break; // EAGAIN, retried when the PTY becomes writable
+            m_pending.erase(m_pending.begin(), m_pending.begin() + n);
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<double> shape;
+    if (opt.spectrumFile.empty()) {
+        shape = defaultShape(opt);
+    } else if (!loadShape(opt.spectrumFile, shape)) {
+        fprintf(stderr, "Spectrum file %s must contain %d values\n", opt.spectrumFile.c_str(), HW_CHANNELS);
+        return 1;
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char* slaveName = ptsname(master);
+
+    // Keep a slave descriptor open so the master does not see EIO between client sessions
+    int slave = open(slaveName, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror("open slave");
+        return 1;
+    }
+    termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (!opt.link.empty()) {
+        unlink(opt.link.c_str());
+        if (symlink(slaveName, opt.link.c_str()) != 0) perror("symlink");
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    printf("%s\n", slaveName);
+    fflush(stdout);
+    fprintf(stderr, "Detector simulator on %s: %.2f frames/s, %.0f cps, realtime %.3f s, pileup %d\n", slaveName,
+            opt.frameRate, opt.cps, opt.realtime, opt.pileup);
+
+    Simulator(master, opt, shape).run();
+
+    if (!opt.link.empty()) unlink(opt.link.c_str());
+    close(slave);
+    close(master);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include "AnalysisContext.h"
+#include "util/NcLibrary.h"
+#include "util/PeakSearch.h"
+
+using namespace nucare;
+
+AnalysisContext::AnalysisContext(const Coeffcients& coeff, const FWHM& fwhm, const InterCoeff& interCoeff,
+                                 double ratio)
+    : m_coeff(coeff), m_fwhm(fwhm), m_ratio(ratio)
+{
+    PeakSearch::TransferFunct(m_tf, fwhm, coeff);
+    NcLibrary::BinToCh(m_tf, m_binToCh);
+    PeakSearch::BGErosionPasses(m_binToCh, interCoeff, coeff, m_erosionPasses);
+
+    m_rebin       = RebinOperator::rebinning(m_tf.dataConst(), BINSIZE, CHSIZE);
+    m_returnRebin = RebinOperator::returnRebinning(m_tf.dataConst(), BINSIZE, CHSIZE);
+    m_hwToChannel = RebinOperator::convert(ratio, HW_CHSIZE, CHSIZE);
+}
@@ -0,0 +1,60 @@
+#ifndef ANALYSISCONTEXT_H
+#define ANALYSISCONTEXT_H
+
+#include "model/Spectrum.h"
+#include "model/Types.h"
+#include "util/RebinOperator.h"
+#include <array>
+
+namespace nucare {
+
+/**
+ * Tables of the spectrum analysis which only depend on the calibration: transfer function, bin to
+ * channel map, BGErosion depth of every bin and the rebinning operators. Built once per calibration by
+ * DetectorProperty::getAnalysisContext() and shared read only between the analysis threads.
+ */
+class AnalysisContext
+{
+public:
+    AnalysisContext(const Coeffcients& coeff, const FWHM& fwhm, const InterCoeff& interCoeff, double ratio);
+
+    AnalysisContext(const AnalysisContext&)            = delete;
+    AnalysisContext& operator=(const AnalysisContext&) = delete;
+
+    bool matches(const Coeffcients& coeff, const FWHM& fwhm, double ratio) const {
+        return m_coeff == coeff && m_fwhm == fwhm && m_ratio == ratio;
+    }
+
+    const Coeffcients& coefficients() const { return m_coeff; }
+    const FWHM& fwhm() const { return m_fwhm; }
+    double ratio() const { return m_ratio; }
+
+    // Width of every bin in channels, see PeakSearch::TransferFunct()
+    const BinSpectrum& transferFunction() const { return m_tf; }
+    // Channel of every bin, see NcLibrary::BinToCh()
+    const BinSpectrum& binToChannel() const { return m_binToCh; }
+    // Erosion passes BGErosion applies to every bin
+    const std::array<int, BINSIZE>& erosionPasses() const { return m_erosionPasses; }
+
+    // NcLibrary::ReBinning() of a channel spectrum with transferFunction()
+    const RebinOperator& rebinning() const { return m_rebin; }
+    // PeakSearch::ReturnReBinning() of a bin spectrum with transferFunction()
+    const RebinOperator& returnRebinning() const { return m_returnRebin; }
+    // HwSpectrum::convertSpectrum() to a channel spectrum with the calibration ratio
+    const RebinOperator& hwToChannel() const { return m_hwToChannel; }
+
+private:
+    Coeffcients m_coeff;
+    FWHM m_fwhm;
+    double m_ratio;
+    BinSpectrum m_tf;
+    BinSpectrum m_binToCh;
+    std::array<int, BINSIZE> m_erosionPasses;
+    RebinOperator m_rebin;
+    RebinOperator m_returnRebin;
+    RebinOperator m_hwToChannel;
+};
+
+} // namespace nucare
+
+#endif // ANALYSISCONTEXT_H
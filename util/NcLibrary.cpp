@@ -561,6 +561,50 @@ double NcLibrary::energyToFWHM(const double energy, const FWHM &fwhm)
     return fwhm[0] * sqrt(energy) + fwhm[1];
 }
 
+const NcLibrary::AdaptWindows& NcLibrary::adaptFilterWindows(size_t n, const FHM& fhm, const Coeffcients* coeffs)
+{
+    // One table per detector calibration in use, a handful at most
+    constexpr size_t MAX_TABLES = 4;
+    static thread_local std::vector<AdaptWindows> tables;
+
+    bool byChannel = coeffs == nullptr;
+    for (auto& t : tables) {
+        if (t.size == n && t.byChannel == byChannel && t.fhm == fhm && (byChannel || t.coeffs == *coeffs)) {
+            return t;
+        }
+    }
+
+    if (tables.size() >= MAX_TABLES) tables.erase(tables.begin());
+    tables.emplace_back();
+    auto& t     = tables.back();
+    t.size      = n;
+    t.byChannel = byChannel;
+    t.fhm       = fhm;
+    if (coeffs) t.coeffs = *coeffs;
+
+    double Ratio      = 1; //=1: meaning: Peak-FWHM:Peak+FWHM
+    double temp_wind0 = byChannel ? energyToFWHM(n, fhm) : channelToFWHM(n, fhm, *coeffs);
+    double temp_wind  = round(temp_wind0 * Ratio);
+    if (temp_wind <= 0) temp_wind = 1;
+
+    const int limit = (int) (byChannel ? n : CHSIZE);
+    for (int j = t.first; j < n - temp_wind; j++) {
+        double wnd0 = byChannel ? energyToFWHM(j + 1, fhm) : channelToFWHM(j + 1, fhm, *coeffs);
+        int wnd     = (int) (wnd0 * Ratio);
+
+        if (wnd % 2 == 0) {
+            wnd = wnd + 1;
+        }
+        int wnd_half = (int) floor(wnd / 2.0);
+
+        t.lo.push_back(std::max(0, j - wnd_half));
+        t.hi.push_back(std::min(j + wnd_half + 1, limit));
+        t.wnd.push_back(wnd);
+    }
+
+    return t;
+}
+
 double NcLibrary::Get_Roi_window_by_energy(double energy) {
 
     if (energy > 2200) {
@@ -625,38 +669,36 @@ int NcLibrary::ROIAnalysis(Spectrum *spc, const Threshold& roiThshold)
 {
     ///////////
     try {
-        nucare::uint N = spc->getSize();
         auto data = spc->data();
+        const int first = roiThshold.first;
+        const int last  = roiThshold.second;
+        const int count = last - first + 1;
         double MAX = 0;
         double AVG = 0;
         double SUM = 0;
         double Base_Pyuncha = 0;
-        list<double> roiSPC;
-        list<double> Pyuncha;
 
-        for (int i = roiThshold.first; i <= roiThshold.second; i++) {
-            roiSPC.push_back(data[i]);
+        // Mean and maximum of the ROI
+        for (int i = first; i <= last; i++) {
             SUM += data[i];
             if (data[i] > MAX) {
                 MAX = data[i];
             }
         }
-        AVG = SUM / roiSPC.size();
+        AVG = SUM / count;
 
-        for (int i = roiThshold.first; i <= roiThshold.second; i++) {
+        // RMS deviation from the ROI mean, in percent of the ROI maximum
+        for (int i = first; i <= last; i++) {
             double bunsan_per = ((AVG - data[i]) / MAX) * 100;
-            Pyuncha.push_back(bunsan_per * bunsan_per);
-
             Base_Pyuncha += bunsan_per * bunsan_per;
         }
-        AVG = Base_Pyuncha / roiSPC.size();
+        AVG = Base_Pyuncha / count;
         Base_Pyuncha = sqrt(AVG);
 
         if (Base_Pyuncha < 17)
             return 0;
         /////////
-        double sst[N];
-        memcpy(sst, data, sizeof(sst));
+        auto sst = data;
 
         double y2max = 0;
         double xmax = 0;
@@ -712,7 +754,6 @@ double NcLibrary::CalcROIK40(const Spectrum* spc, FWHM& fwhm, Coeffcients& coeff
             double theshold2 = (int) energyToChannel(En_thshold2, coeffs);
 
             AdaptFilter(spc, &ChSpecSmoo, fwhm, &coeffs, 3);
-            double SumCnt = 0.0;
             if (theshold2 > (double)(N - 1)) {
                 theshold2 = (double)(N - 1);
             }
@@ -722,10 +763,10 @@ double NcLibrary::CalcROIK40(const Spectrum* spc, FWHM& fwhm, Coeffcients& coeff
             }
 //            theshold1 = max(0.0, theshold1);
 
-            for(int i = (int)theshold1; i <= (int)theshold2; ++i) {
+            double SumCnt = 0.0;
+            for (int i = (int) theshold1; i <= (int) theshold2; ++i) {
                 SumCnt += ChSpecSmoo[i];
             }
-
             return SumCnt;
         }
     } else {
@@ -1585,11 +1626,16 @@ double NcLibrary::confidenceCal(double Found_Peak_Energy, double Iso_Peak_Energy
 }
 
 double NcLibrary::Calculate_PeakUncertainty(Spectrum& Spc, double BGSum, int ROI_L, int ROI_R) {
-    double U = 0, G = 0;
-
+    // A single window, summed directly
+    double G = 0;
     for (int i = ROI_L; i <= ROI_R; i++) {
         G = G + Spc[i];
     }
+    return Calculate_PeakUncertainty(G, BGSum, ROI_L, ROI_R);
+}
+
+double NcLibrary::Calculate_PeakUncertainty(double G, double BGSum, int ROI_L, int ROI_R) {
+    double U = 0;
 
     double W = ROI_R - ROI_L + 1;
     W=2;
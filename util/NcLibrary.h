@@ -80,8 +80,23 @@ public:
 
     static double fwhm_eff(Spectrum* smoothSpc, int Peak_Channel, const Coeffcients& coeffs, bool Energy);
 
+    // prefix[k] = data[0] + ... + data[k - 1], prefix holds n + 1 values
+    template <class T>
+    static void prefixSum(const T* data, size_t n, double* prefix)
+    {
+        double sum = 0;
+        prefix[0]  = 0;
+        for (size_t k = 0; k < n; k++) {
+            sum += data[k];
+            prefix[k + 1] = sum;
+        }
+    }
+
     /**
      * @brief smoothSpectrum Smooth spectrum before find its peaks.
+     * Window sums come from a prefix sum of the previous pass, so a pass costs O(N) whatever the
+     * window widths. The result differs from summing every window directly only by rounding, at
+     * most a few N * DBL_EPSILON * (total counts) / window.
      * @param spc           Input Spectrum to be smooth
      * @param smoothParam   Smooth paramter
      * @param out           Output result
@@ -89,8 +104,7 @@ public:
     template <class Spectrum_t>
     static void smoothSpectrum(Spectrum_t& spc, Spectrum_t& out, const std::pair<double, double>& smoothPar)
     {
-        auto chSize = out.getSize();
-        Spectrum_t temp;
+        const int chSize = (int) out.getSize();
 
         //HH200: NaI 2", CHSIZE:
         double aval = smoothPar.first;
@@ -105,38 +119,32 @@ public:
         int NoSmooth = 2;
         double temp_wind = round(aval * chSize + bval);
 
-        double sum1 = 0;
         int wnd = 0;
         int wnd_half = 0;
 
         out.setAcqTime(spc.getAcqTime());
         out.setRealTime(spc.getRealTime());
 
-        std::copy(spc.begin(), spc.end(), temp.begin());
+        static thread_local std::vector<double> prefix;
+        prefix.resize(chSize + 1);
 
+        auto dataOut = out.data();
         for (int nosmoo = 1; nosmoo <= NoSmooth; nosmoo++) {
-            if (nosmoo > 1) {
-                std::copy(out.begin(), out.end(), temp.begin());
-            }
-            for (int j = 3; j < chSize - temp_wind; j++) {
-                sum1 = 0;
+            // Taken before any write, out may be spc
+            prefixSum(nosmoo > 1 ? dataOut : spc.dataConst(), chSize, prefix.data());
 
+            for (int j = 3; j < chSize - temp_wind; j++) {
                 wnd = (int) floor(aval * (j + 1) + bval);
 
-                if (wnd < 0) {
-                    out[j] = temp[j];
-                }
                 if (wnd % 2 == 0) {
                     wnd = wnd + 1;
                 }
-                wnd_half = (int) floor(wnd / 2);
+                wnd_half = wnd / 2;
 
-                for (int k = j - wnd_half; k <= j + wnd_half; k++) {
-                    if (k >= 0 && k < chSize)
-                        sum1 = sum1 + temp[k];
-                }
+                int lo = std::max(j - wnd_half, 0);
+                int hi = std::min(j + wnd_half + 1, chSize);
 
-                out[j] = sum1 / wnd;
+                dataOut[j] = (hi > lo ? prefix[hi] - prefix[lo] : 0) / wnd;
             }
         }
     }
@@ -148,9 +156,30 @@ public:
 
     static std::pair<double, double> Get_Roi_window_by_energy_used_FWHM(double en, const FWHM& FWHMCoeff, const Coeffcients& coeff, const double Ratio);
     static std::pair<double, double> Get_Roi_window_by_energy_used_FWHM(double en, DetectorProperty* prop);
+    // Windows of AdaptFilter(): channel first + i is the sum of [lo[i], hi[i]) divided by wnd[i]
+    struct AdaptWindows {
+        size_t size        = 0;
+        bool byChannel     = false;
+        FHM fhm            = {};
+        Coeffcients coeffs = {};
+
+        int first = 3;
+        std::vector<int> lo;
+        std::vector<int> hi;
+        std::vector<double> wnd;
+    };
+
+    /**
+     * Window table of AdaptFilter() for a spectrum of n channels, so the FWHM of every channel is
+     * computed once per calibration instead of on every pass. The last few tables of the calling
+     * thread are kept; the reference is valid until the next call from the same thread.
+     */
+    static const AdaptWindows& adaptFilterWindows(size_t n, const FHM& fhm, const Coeffcients* coeffs);
+
     /**
      * @brief AdaptFilter Adapt Filter spectrum. If coeffs is NULL, perform fhm as FWHM for channel,
-     * otherwise perform FWHM as for energy
+     * otherwise perform FWHM as for energy. Each pass is O(N) using a prefix sum and the window table
+     * of adaptFilterWindows(), within rounding of summing every window directly.
      * @param in
      * @param out
      * @param fhm
@@ -160,65 +189,34 @@ public:
     template<class Spectrum_t>
     static void AdaptFilter(const Spectrum_t* in, Spectrum_t* out, const FHM& fhm, const Coeffcients* coeffs = nullptr, const nucare::uint repeat = 3) {
         using Channel = typename Spectrum_t::Channel;
-        bool byChannel = coeffs == nullptr;
-        auto n = in->getSize();
         if (in == nullptr || out == nullptr)
             NC_THROW_ARG_ERROR("Invalid parameter for AdaptFilter_FWHM_In_Ch");
+        auto n = in->getSize();
 
-        double Ratio = 1; //=1: meaning: Peak-FWHM:Peak+FWHM
-        double temp_wind0 = byChannel ? energyToFWHM(n, fhm)
-                                      : channelToFWHM(n, fhm, *coeffs);
-        double temp_wind = round(temp_wind0 * Ratio);
-        if (temp_wind <= 0) temp_wind = 1;
+        const AdaptWindows& windows = adaptFilterWindows(n, fhm, coeffs);
+        const int count             = (int) windows.wnd.size();
+        const int* lo               = windows.lo.data();
+        const int* hi               = windows.hi.data();
+        const double* wnd           = windows.wnd.data();
 
-        Channel data[n];
+        static thread_local std::vector<double> prefix;
+        prefix.resize(n + 1);
 
-        auto dataIn = in->dataConst();
         auto dataOut = out->data();
-
-        memcpy(data, dataIn, n * sizeof(Channel));
+        prefixSum(in->dataConst(), n, prefix.data());
         memset(dataOut, 0, n * sizeof(Channel));
 
         for (nucare::uint nosmoo = 1; nosmoo <= repeat; nosmoo++)
         {
             if (nosmoo > 1)
             {
-                memcpy(data, dataOut, n * sizeof(Channel));
+                prefixSum(dataOut, n, prefix.data());
             }
 
-            double sum1 = 0;
-            double wnd0 = 0;
-            int wnd_half = 0;
-            int wnd = 0;
-
-            for (nucare::uint j = 3; j < n - temp_wind; j++)
+            Channel* res = dataOut + windows.first;
+            for (int i = 0; i < count; i++)
             {
-                sum1 = 0;
-                wnd0 = byChannel ? energyToFWHM(j + 1, fhm)
-                                 : channelToFWHM(j + 1, fhm, *coeffs);
-
-                wnd = (int)(wnd0 * Ratio);
-
-                //wnd = (int)(floor(aval * (j + 1) + bval));
-
-                if (wnd < 0)
-                {
-                    dataOut[j] = data[j];
-                }
-                if (wnd % 2 == 0)
-                {
-                    wnd = wnd + 1;
-                }
-                wnd_half = (int)(floor(wnd / 2.0));
-                nucare::uint start = std::max(0, (int) j - wnd_half);
-                nucare::uint end = std::min(j + wnd_half + 1, byChannel ? n : CHSIZE);
-
-                for (nucare::uint k = start; k < end; k++)
-                {
-                    sum1 += data[k];
-                }
-
-                dataOut[j] = sum1 / (double)wnd;
+                res[i] = (hi[i] > lo[i] ? prefix[hi[i]] - prefix[lo[i]] : 0) / wnd[i];
             }
         }
     }
@@ -460,6 +458,8 @@ public:
     static double confidenceCal(double Found_Peak_Energy, double Iso_Peak_Energy);
 
     static double Calculate_PeakUncertainty(Spectrum& Spc, double BGSum, int ROI_L, int ROI_R);
+    // Same with the gross counts G of the ROI already summed
+    static double Calculate_PeakUncertainty(double G, double BGSum, int ROI_L, int ROI_R);
 
     static double Calculate_EffUncertainty(double en, DetectorProperty* prop);
 
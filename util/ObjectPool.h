@@ -0,0 +1,103 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nucare {
+
+/**
+ * Thread-safe free list of reusable objects. acquire() hands out a shared_ptr whose
+ * deleter puts the object back into the pool instead of freeing it, so long running
+ * acquisition stops churning the heap. Objects released after the pool is destroyed
+ * are simply deleted.
+ */
+template <typename T>
+class ObjectPool
+{
+public:
+    typedef std::function<void(T&)> Recycler;
+
+    struct Stats {
+        size_t inUse;     // Objects currently handed out
+        size_t idle;      // Objects waiting in the free list
+        size_t highWater; // Maximum of inUse since the pool was created
+        uint64_t created; // Objects allocated from the heap
+    };
+
+    /**
+     * @param maxIdle   Free list size, extra objects returned above it are deleted
+     * @param recycle   Called on every returned object before it is reused
+     */
+    explicit ObjectPool(size_t maxIdle = 8, Recycler recycle = nullptr)
+        : m_state(std::make_shared<State>(maxIdle, std::move(recycle))) {}
+
+    ObjectPool(const ObjectPool&)            = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    std::shared_ptr<T> acquire() {
+        std::unique_ptr<T> obj;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            if (!m_state->idle.empty()) {
+                obj = std::move(m_state->idle.back());
+                m_state->idle.pop_back();
+            }
+            m_state->inUse++;
+            m_state->highWater = std::max(m_state->highWater, m_state->inUse);
+            if (!obj) m_state->created++;
+        }
+
+        if (!obj) obj.reset(new T());
+        return std::shared_ptr<T>(obj.release(), Release{m_state});
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        return Stats{m_state->inUse, m_state->idle.size(), m_state->highWater, m_state->created};
+    }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<T>> idle;
+        size_t maxIdle;
+        Recycler recycle;
+        size_t inUse     = 0;
+        size_t highWater = 0;
+        uint64_t created = 0;
+
+        State(size_t maxIdle, Recycler recycle) : maxIdle(maxIdle), recycle(std::move(recycle)) {
+            idle.reserve(maxIdle);
+        }
+    };
+
+    struct Release {
+        std::weak_ptr<State> state;
+
+        void operator()(T* ptr) const {
+            std::unique_ptr<T> obj(ptr);
+            auto s = state.lock();
+            if (!s) return;
+
+            if (s->recycle) s->recycle(*obj);
+
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->inUse--;
+            if (s->idle.size() < s->maxIdle) {
+                s->idle.push_back(std::move(obj));
+            }
+        }
+    };
+
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace nucare
+
+#endif // OBJECTPOOL_H
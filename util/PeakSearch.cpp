@@ -2,6 +2,8 @@
 #include "util/util.h"
 #include "NcLibrary.h"
 #include "model/DetectorProp.h"
+#include "util/SpectrumKernels.h"
+#include "util/AnalysisContext.h"
 //#include "Model/NcPeak.h"
 
 #include <math.h>
@@ -52,153 +54,160 @@ double nucare::PeakSearch::CalStdDevSpc(const Spectrum *doseSpc, const Threshold
     return std_dev;
 }
 
-std::list<int> nucare::PeakSearch::PeakSearch_V1(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
-                                                 const double thshold, const Threshold& thsholdK40,
-                                                 const Threshold& theshold1,
-                                                 const int MaxDist2Peaks)
-{
-    // TODO I don't like this idea when allocate too much this array size, change it pls
-    int peaklist[NO_MAX_K40] = {0};
-    int templist[NO_MAX_K40] = {0};
-    auto data = in->dataConst();
-    std::list<int> ret;
-
-    //1st Step: Calculate Standard deviation
-    double Std_dev = CalStdDevSpc(in, thsholdK40);
+namespace {
 
+// Search window of PeakSearch_V1(): channel range, peak shape offsets and minimum peak height
+struct PeakWindow {
+    int first;
+    int last;
+    int ch2, ch3, ch4;
+    double minValue;
+};
 
-    if (Std_dev > 17)
-    {
+PeakWindow makePeakWindow(const double* data, const Threshold& theshold1, const FWHM& fwhm, const Coeffcients& coeff,
+                          const double thshold)
+{
+    PeakWindow w;
+    w.first = (int) theshold1.first;
+    w.last  = (int) theshold1.second;
 
-        // Finding Max value
-        int IndexMax = nucare::indexOfMax(data, theshold1.first, theshold1.second);
+    // Finding Max value
+    int IndexMax = nucare::indexOfMax(data, theshold1.first, theshold1.second);
 
-        double MAX = data[IndexMax];
+    double MAX = data[IndexMax];
 
-        double PeakAvg = (theshold1.first + theshold1.second) / 2.0;
+    double PeakAvg = (theshold1.first + theshold1.second) / 2.0;
 
-        //double FWHM_Peak = FWHM[0]*Math.sqrt(PeakAvg) + FWHM[1]; //%% fwhm = 2.355 sigma
+    //double FWHM_Peak = FWHM[0]*Math.sqrt(PeakAvg) + FWHM[1]; //%% fwhm = 2.355 sigma
 
-        // New Calculation FWHM (2020.01.29) FWHM (ch)=a x sqrt(En) +b
-        double FWHM_Peak= NcLibrary::channelToFWHM(PeakAvg, fwhm, coeff);
+    // New Calculation FWHM (2020.01.29) FWHM (ch)=a x sqrt(En) +b
+    double FWHM_Peak= NcLibrary::channelToFWHM(PeakAvg, fwhm, coeff);
 
-        //%% To >95 % density, then - 2sigma to 2 sigma.
-        //Reference link: https://www.mathsisfun.com/definitions/standard-normal-distribution.html
+    //%% To >95 % density, then - 2sigma to 2 sigma.
+    //Reference link: https://www.mathsisfun.com/definitions/standard-normal-distribution.html
 
-        double PeakMinWidth = 4.0 / 2.355 * FWHM_Peak;  //%% To >95 % density, then - 2sigma to 2 sigma.
+    double PeakMinWidth = 4.0 / 2.355 * FWHM_Peak;  //%% To >95 % density, then - 2sigma to 2 sigma.
 
-        //double PeakMinWidth = 40;
+    //double PeakMinWidth = 40;
 
-        double halfWidth = (PeakMinWidth / 2.0) * 0.8;
-        double quarterWidth = halfWidth / 2.0;
+    double halfWidth = (PeakMinWidth / 2.0) * 0.8;
+    double quarterWidth = halfWidth / 2.0;
 
 //        int ch1 = (int) round(halfWidth);
-        int ch2 = (int) round(halfWidth - quarterWidth / 2.0);
-        int ch3 = (int) round(quarterWidth);
-        int ch4 = (int) round(quarterWidth - quarterWidth / 2.0);
+    w.ch2 = (int) round(halfWidth - quarterWidth / 2.0);
+    w.ch3 = (int) round(quarterWidth);
+    w.ch4 = (int) round(quarterWidth - quarterWidth / 2.0);
 
-        int peakCount = 0;
-
-        double thshold_val = thshold * MAX;
+    w.minValue = thshold * MAX;
+    return w;
+}
 
-        for (int  i = (int)theshold1.first; i <=(int) theshold1.second; i++)
-        {
-            if (data[i] > thshold_val)
-            {
-                if (data[i - ch2] < data[i - ch3] && data[i + ch2] < data[i + ch3])
-                {
-                    if (data[i - ch3] < data[i - ch4] && data[i + ch3] < data[i + ch4])
-                    {
-                        if (data[i - ch4] < data[i] && data[i + ch4] < data[i])
-                        {
-                            if (peakCount < NO_MAX_K40)
-                            {
-                                templist[peakCount] = i;
-                                peakCount = peakCount + 1;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+bool isPeakShape(const double* data, int i, const PeakWindow& w)
+{
+    return data[i - w.ch2] < data[i - w.ch3] && data[i + w.ch2] < data[i + w.ch3]
+           && data[i - w.ch3] < data[i - w.ch4] && data[i + w.ch3] < data[i + w.ch4]
+           && data[i - w.ch4] < data[i] && data[i + w.ch4] < data[i];
+}
 
+// Select For True Peak Energy: keeps the highest candidate of every run closer than MaxDist2Peaks
+std::vector<int> selectPeaks(const double* data, const int* templist, int peakCount, const int MaxDist2Peaks)
+{
+    std::vector<int> ret;
 
+    int ind = 0;
 
-        // Select For True Peak Energy
-        //Modify function in here
+    double maxval = 0;
+    int maxch = 0;
+    int index0 = 0;
 
-        int realPeakCount=0;
+    for (int i = 0; i < peakCount ; i++)
+    {
+        //maxch = templist[i];
+        //maxval = ChSpec[maxch];
 
-        int ind = 0;
+        index0 = templist[i];
+        maxval = data[index0];
+        maxch = i;
 
-        double maxval = 0;
-        int maxch = 0;
-        int index0 = 0;
 
-        for (int i = 0; i < peakCount ; i++)
+        if(i>0 && i<=ind-1)
         {
-            //maxch = templist[i];
-            //maxval = ChSpec[maxch];
-
-            index0 = templist[i];
-            maxval = data[index0];
-            maxch = i;
-
-
-            if(i>0 && i<=ind-1)
-            {
-                continue;
-            }
+            continue;
+        }
 
-            int j=0;
+        int j=0;
 
-            for (j = i + 1; j < peakCount - 1; j++)
+        for (j = i + 1; j < peakCount - 1; j++)
+        {
+            if (abs((long) (templist[j] - templist[j + 1])) <= MaxDist2Peaks)
             {
-                if (abs((long) (templist[j] - templist[j + 1])) <= MaxDist2Peaks)
-                {
-                    index0 = templist[j];
+                index0 = templist[j];
 
-                    if (maxval < data[index0])
-                    {
-                        maxval = data[index0];
-                        maxch = j;
-                    }
-                }
-                else
+                if (maxval < data[index0])
                 {
-                    break;
+                    maxval = data[index0];
+                    maxch = j;
                 }
             }
-            ind = j + 1;
-
-            peaklist[realPeakCount] = templist[maxch];
-            realPeakCount = realPeakCount + 1;
-
-            if (ind == peakCount-1)
+            else
             {
                 break;
             }
         }
+        ind = j + 1;
 
-        //
-        if (realPeakCount > 0)
-        {
-            for (int i = 0; i < realPeakCount; i++)
-            {
-                ret.push_back(peaklist[i]);
-            }
+        ret.push_back(templist[maxch]);
 
+        if (ind == peakCount-1)
+        {
+            break;
         }
-
     }
 
     return ret;
 }
 
+} // namespace
+
+std::vector<int> nucare::PeakSearch::PeakSearch_V1(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
+                                                   const double thshold, const Threshold& thsholdK40,
+                                                   const Threshold& theshold1,
+                                                   const int MaxDist2Peaks)
+{
+    auto data = in->dataConst();
+
+    //1st Step: Calculate Standard deviation
+    double Std_dev = CalStdDevSpc(in, thsholdK40);
+
+    if (!(Std_dev > 17)) return {};
+
+    auto w = makePeakWindow(data, theshold1, fwhm, coeff, thshold);
+
+    int templist[NO_MAX_K40] = {0};
+    int peakCount = 0;
+
+    for (int i = w.first; i <= w.last && peakCount < NO_MAX_K40; i++)
+    {
+        if (data[i] > w.minValue && isPeakShape(data, i, w))
+        {
+            templist[peakCount] = i;
+            peakCount = peakCount + 1;
+        }
+    }
 
+    return selectPeaks(data, templist, peakCount, MaxDist2Peaks);
+}
 
-std::list<int> PeakSearch::PeakSearch_Hight(const Spectrum *in, const FWHM &fwhm, const Coeffcients &coeff, const double thshold, const Threshold &k40Thshold)
+std::vector<int> PeakSearch::PeakSearch_Hight(const Spectrum *in, const FWHM &fwhm, const Coeffcients &coeff, const double thshold, const Threshold &k40Thshold)
 {
+    constexpr int NO_WINDOWS = 3;
+    auto data = in->dataConst();
+
+    // Same for every window, so computed once
+    double Std_dev = CalStdDevSpc(in, k40Thshold);
+
+    if (!(Std_dev > 17)) return {};
+
     double PeakAvg = (k40Thshold.first + k40Thshold.second) / 2.0;
 
     double FWHM_K40 = fwhm[0] * sqrt(PeakAvg) + fwhm[1];
@@ -215,16 +224,44 @@ std::list<int> PeakSearch::PeakSearch_Hight(const Spectrum *in, const FWHM &fwhm
     sigThreshold2.first = round(PeakAvg - Width_3Sig / 2.0);
     sigThreshold2.second = round(PeakAvg + Width_3Sig / 2.0);
 
-    auto ret = PeakSearch_V1(in, fwhm, coeff, thshold, k40Thshold, sigThreshold1);
-
-    if (ret.empty()) {
-        ret = PeakSearch_V1(in, fwhm, coeff, thshold, k40Thshold, sigThreshold2);
+    // 2 sigma, 3 sigma then the whole K40 ROI, the first one with a peak wins
+    const PeakWindow windows[NO_WINDOWS] = {
+        makePeakWindow(data, sigThreshold1, fwhm, coeff, thshold),
+        makePeakWindow(data, sigThreshold2, fwhm, coeff, thshold),
+        makePeakWindow(data, k40Thshold, fwhm, coeff, thshold),
+    };
+
+    int first = windows[0].first, last = windows[0].last;
+    for (auto& w : windows) {
+        first = std::min(first, w.first);
+        last  = std::max(last, w.last);
+    }
 
-        if (ret.empty()) {
-            ret = PeakSearch_V1(in, fwhm, coeff, thshold, k40Thshold, k40Thshold);
+    // One scan collects the candidates of every window. The windows share their center, so the shape
+    // test is usually the same and only evaluated again when the offsets differ
+    int templist[NO_WINDOWS][NO_MAX_K40];
+    int peakCount[NO_WINDOWS] = {0};
+
+    for (int i = first; i <= last; i++) {
+        const PeakWindow* tested = nullptr;
+        bool shape               = false;
+        for (int k = 0; k < NO_WINDOWS; k++) {
+            auto& w = windows[k];
+            if (i < w.first || i > w.last || peakCount[k] >= NO_MAX_K40 || !(data[i] > w.minValue)) continue;
+
+            if (!tested || w.ch2 != tested->ch2 || w.ch3 != tested->ch3 || w.ch4 != tested->ch4) {
+                tested = &w;
+                shape  = isPeakShape(data, i, w);
+            }
+            if (shape) templist[k][peakCount[k]++] = i;
         }
     }
 
+    std::vector<int> ret;
+    for (int k = 0; k < NO_WINDOWS && ret.empty(); k++) {
+        ret = selectPeaks(data, templist[k], peakCount[k], 1);
+    }
+
     return ret;
 }
 
@@ -729,7 +766,8 @@ void PeakSearch::TransferFunct(double* out, const int len,
 // 2
 {
 
-    Spectrum fit1;
+    // Every channel is rewritten below, reuse the buffer between calls
+    static thread_local Spectrum fit1;
     auto chSize = fit1.getSize();
 
     double x = 0;
@@ -761,16 +799,15 @@ void PeakSearch::TransferFunct(double* out, const int len,
     }
 
     // normalize
-    for (int i = 0; i < BINSIZE; i++) {
-        out[i] = out[i] / sum1 * (double)(CHSIZE);
-    }
+    kernel::scale(out, out, (double) CHSIZE / sum1, BINSIZE);
 }
 
 template<>
 void PeakSearch::TransferFunct(BinSpectrum& out, const FWHM& fwhm, const Coeffcients& coeff) {
     using Channel = typename BinSpectrum::Channel;
 
-    Spectrum fit1;
+    // Every channel is rewritten below, reuse the buffer between calls
+    static thread_local Spectrum fit1;
     auto chSize = fit1.getSize();
 
     Channel x = 0;
@@ -802,11 +839,50 @@ void PeakSearch::TransferFunct(BinSpectrum& out, const FWHM& fwhm, const Coeffci
     }
 
     // normalize
-    for (int i = 0; i < out.getSize(); i++) {
-        out[i] = out[i] / sum1 * CHSIZE;
+    out.scale(CHSIZE / sum1);
+}
+
+namespace {
+
+constexpr int BG_EROSION_MAX_ITER = 70; // Defined: MaxNoIter=70+1
+
+// bgBinOut[i] = MSBinSpec eroded passes[i] times, passes in [2, MaxIter - 1]. Only the current
+// erosion level is kept, every bin is picked up once its own pass count is reached.
+void erodeBins(const double* MSBinSpec, const int* passes, double* bgBinOut)
+{
+    const int MaxIter = BG_EROSION_MAX_ITER;
+
+    // Bins ordered by pass count
+    int first[MaxIter + 1] = {0};
+    int order[BINSIZE];
+    for (int i = 0; i < BINSIZE; i++) {
+        first[passes[i]]++;
+    }
+    for (int pass = 0, start = 0; pass <= MaxIter; pass++) {
+        int count   = first[pass];
+        first[pass] = start;
+        start += count;
+    }
+    int lastPass = 0;
+    for (int i = 0; i < BINSIZE; i++) {
+        order[first[passes[i]]++] = i;
+        lastPass = max(lastPass, passes[i]);
+    }
+
+    double data[BINSIZE];
+    memcpy(data, MSBinSpec, sizeof(data));
+
+    int next = 0;
+    for (int pass = 1; pass <= lastPass; pass++) {
+        kernel::erode4(data, BINSIZE);
+        for (; next < BINSIZE && passes[order[next]] == pass; next++) {
+            bgBinOut[order[next]] = data[order[next]];
+        }
     }
 }
 
+} // namespace
+
 void PeakSearch::BGErosion(double* MSBinSpec, const double* IterCoeff, double* bgBinOut, double* TF,
                                  const Coeffcients& coeff) {
     double a4 = IterCoeff[0];
@@ -824,37 +900,12 @@ void PeakSearch::BGErosion(double* MSBinSpec, const double* IterCoeff, double* b
     double x = 0;
     int noiter = 0;
 
-    int MaxIter = 70; // Defined: MaxNoIter=70+1
-
-    double DataEro[MaxIter][BINSIZE];
-    for (int i = 0; i < MaxIter; i++)
-    {
-        memcpy(DataEro[i], MSBinSpec, BINSIZE * sizeof(double));
-    }
-
-    // 1st :Erosion and then save array
-    double tmp;
-    for (int iter = 0; iter < MaxIter - 1; iter++)
-    {
-        for (int i = 0; i < BINSIZE; i++)
-        {
-            if (i >= 4 && i <= BINSIZE - 5)
-            {
-                tmp = (DataEro[iter][i - 4] + DataEro[iter][i + 4]) / 2;
-                if (DataEro[iter][i] > tmp)
-                {
-                    DataEro[iter][i] = tmp;
-                }
-                // DataEro[iter+1][i] = DataEro[iter][i];
-            }
-            DataEro[iter + 1][i] = DataEro[iter][i];
-        }
-
-    }
+    int MaxIter = BG_EROSION_MAX_ITER;
 
     // 2 step:
 
     array<double, BINSIZE> CHArray; // BinSpec[BINSIZE]
+    int passes[BINSIZE];
 
     NcLibrary::BintoCh(TF, CHArray.data());
 
@@ -883,12 +934,14 @@ void PeakSearch::BGErosion(double* MSBinSpec, const double* IterCoeff, double* b
         if (noiter > MaxIter - 1)
             noiter = MaxIter - 1;
 
-        bgBinOut[ind] = DataEro[noiter - 1][ind];
+        passes[ind] = noiter;
     }
 
+    erodeBins(MSBinSpec, passes, bgBinOut);
 }
 
-void PeakSearch::BGErosion(const BinSpectrum &MSBinSpec, const InterCoeff& IterCoeff, BinSpectrum &bgBinOut, const BinSpectrum &TF, const Coeffcients &coeff)
+void PeakSearch::BGErosionPasses(const BinSpectrum& CHArray, const InterCoeff& IterCoeff, const Coeffcients& coeff,
+                                 std::array<int, BINSIZE>& passes)
 {
     auto a4 = IterCoeff[0];
     auto a3 = IterCoeff[1];
@@ -900,44 +953,10 @@ void PeakSearch::BGErosion(const BinSpectrum &MSBinSpec, const InterCoeff& IterC
     auto b1 = IterCoeff[6];
     auto b0 = IterCoeff[7];
 
+    const int MaxIter = BG_EROSION_MAX_ITER;
 
     Energy x = 0;
     int noiter = 0;
-
-    int MaxIter = 70; // Defined: MaxNoIter=70+1
-
-    Energy DataEro[MaxIter][BINSIZE];
-    for (int i = 0; i < MaxIter; i++)
-    {
-        memcpy(DataEro[i], MSBinSpec.dataConst(), BINSIZE * sizeof(Energy));
-    }
-
-    // 1st :Erosion and then save array
-    Energy tmp;
-    for (int iter = 0; iter < MaxIter - 1; iter++)
-    {
-        for (int i = 0; i < BINSIZE; i++)
-        {
-            if (i >= 4 && i <= BINSIZE - 5)
-            {
-                tmp = (DataEro[iter][i - 4] + DataEro[iter][i + 4]) / 2;
-                if (DataEro[iter][i] > tmp)
-                {
-                    DataEro[iter][i] = tmp;
-                }
-                // DataEro[iter+1][i] = DataEro[iter][i];
-            }
-            DataEro[iter + 1][i] = DataEro[iter][i];
-        }
-
-    }
-
-    // 2 step:
-
-    BinSpectrum CHArray; // BinSpec[BINSIZE]
-
-    NcLibrary::BinToCh(TF, CHArray);
-
     double noiter1;
 
     // iterosion
@@ -963,9 +982,26 @@ void PeakSearch::BGErosion(const BinSpectrum &MSBinSpec, const InterCoeff& IterC
         if (noiter > MaxIter - 1)
             noiter = MaxIter - 1;
 
-        bgBinOut[ind] = DataEro[noiter - 1][ind];
+        passes[ind] = noiter;
     }
+}
+
+void PeakSearch::BGErosion(const BinSpectrum &MSBinSpec, const InterCoeff& IterCoeff, BinSpectrum &bgBinOut, const BinSpectrum &TF, const Coeffcients &coeff)
+{
+    static thread_local BinSpectrum CHArray; // BinSpec[BINSIZE]
+    CHArray.reset();
+
+    NcLibrary::BinToCh(TF, CHArray);
+
+    std::array<int, BINSIZE> passes;
+    BGErosionPasses(CHArray, IterCoeff, coeff, passes);
 
+    erodeBins(MSBinSpec.dataConst(), passes.data(), bgBinOut.data());
+}
+
+void PeakSearch::BGErosion(const BinSpectrum& MSBinSpec, BinSpectrum& bgBinOut, const AnalysisContext& ctx)
+{
+    erodeBins(MSBinSpec.dataConst(), ctx.erosionPasses().data(), bgBinOut.data());
 }
 
 void PeakSearch::ReturnReBinning(double* BinSpec, double* TF, double* ChOut) {
@@ -1181,87 +1217,21 @@ void PeakSearch::ReturnReBinning(const BinSpectrum &BinSpec, const BinSpectrum &
 }
 
 void PeakSearch::BGSubtration(double* MSChSpec, double* ReBinChSpec, Spectrum* PPChSpecOut, const SmoothP& smooth ) {
-    Spectrum spc_sub_NB;
-    auto data = spc_sub_NB.data();
-    double tmp = 0;
-    for (nucare::uint i = 0; i < CHSIZE; i++) {
-        tmp = MSChSpec[i] - ReBinChSpec[i];
-        if (tmp < 0)
-            tmp = 0;
-        data[i] = tmp;
-    }
+    static thread_local Spectrum spc_sub_NB;
+    kernel::subtractClamp0(spc_sub_NB.data(), MSChSpec, ReBinChSpec, CHSIZE);
 
     // smooth function
     NcLibrary::smoothSpectrum(spc_sub_NB, *PPChSpecOut, smooth);
 }
 
 void PeakSearch::BGSubtration(const Spectrum &MSChSpec, const Spectrum &ReBinChSpec, Spectrum *PPChSpecOut, const SmoothP &smooth) {
-    Spectrum spc_sub_NB;
-    auto data = spc_sub_NB.data();
-    Energy tmp = 0;
-    for (int i = 0; i < CHSIZE; i++) {
-        tmp = MSChSpec[i] - ReBinChSpec[i];
-        if (tmp < 0)
-            tmp = 0;
-        data[i] = tmp;
-    }
+    static thread_local Spectrum spc_sub_NB;
+    kernel::subtractClamp0(spc_sub_NB.data(), MSChSpec.dataConst(), ReBinChSpec.dataConst(), CHSIZE);
 
     // smooth function
     NcLibrary::smoothSpectrum(spc_sub_NB, *PPChSpecOut, smooth);
 }
 
-void PeakSearch::GenDSpecrum(Spectrum& PPChSpec, Spectrum& reBinChSpec, double* DChSpecOut, DetectorProperty* prop,
-                                   bool isMeasurement) {
-
-    isMeasurement = false;
-    //int CHSIZE = 2048;
-    Spectrum bg_est;
-    Spectrum D;
-
-    NcLibrary::smoothSpectrum(reBinChSpec, bg_est, prop->getSmoothParams());
-    double fwhm, W, A, C, S;
-    int W_half, lowchn, highchn;
-    for (nucare::uint i = 0; i < CHSIZE - 2; i++) {
-        if (reBinChSpec[i] > 0) {
-            D[i] = 0;
-            DChSpecOut[i] = 0;
-
-            if (i >= 0 && i < CHSIZE - 2)
-            {
-                //	fwhm = FWHMCoeff[0] * Math.sqrt((double) (i + 1)) + FWHMCoeff[1];
-
-                fwhm = NcLibrary::channelToFWHM(i + 1, prop->getFWHM(), prop->getCoeffcients());
-
-                W = fwhm;
-                W_half = (int) round(W / 2);
-
-                if (W_half > 0) {
-                    lowchn = i - W_half;
-                    highchn = i + W_half;
-
-                    if (lowchn > 0 && highchn < (int) CHSIZE) {
-                        A = 0;
-                        C = 0;
-                        for (int j = lowchn; j < highchn + 1; j++) {
-                            A = A + PPChSpec[j];
-                            C = C + bg_est[j];
-
-                        }
-
-                        if (C > 1) {
-                            S = sqrt(C / W) * W;
-                            D[i] = (A - S) * (A - S) / ((C + S) * W);
-                        }
-                    }
-                }
-            }
-
-            DChSpecOut[i] = D[i];
-        }
-
-    }
-}
-
 //void PeakSearch::SearchROI_N(Spectrum& Spc, std::list<NcPeak>& PeakInfo, DetectorProperty* prop) {
 ////    int NoPeak = PeakInfo.size();
 //    int ROI_L, ROI_R;
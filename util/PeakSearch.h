@@ -5,6 +5,7 @@
 #include "model/Spectrum.h"
 //#include "Model/Isotopes.h"
 #include <list>
+#include <vector>
 
 //class NcPeak;
 
@@ -12,6 +13,7 @@
 namespace nucare {
 
 class DetectorProperty;
+class AnalysisContext;
 
 class PeakSearch
 {
@@ -21,17 +23,18 @@ public:
     /**
      * @brief PeakSearch_V1 Searching for K40 list peak, mostly used for calibration function with newer method
      */
-    static std::list<int> PeakSearch_V1(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
-                                        const double thshold, const Threshold& thsholdK40,
-                                        const Threshold& theshold1,
-                                        const int MaxDist2Peaks = 1);
+    static std::vector<int> PeakSearch_V1(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
+                                          const double thshold, const Threshold& thsholdK40,
+                                          const Threshold& theshold1,
+                                          const int MaxDist2Peaks = 1);
 
     /**
-     * @brief PeakSearch_Hight  Searching for K40 list peak, call to @ref PeakSearch_V1 3 times, with different
-     * sigma threshold to get value. => Hight performance, but more precise
+     * @brief PeakSearch_Hight  Searching for K40 list peak, same as @ref PeakSearch_V1 on a 2 sigma, then 3 sigma
+     * window and then the whole K40 ROI, returning the first non empty result. The deviation check and the
+     * candidate scan are shared by the three windows. => Hight performance, but more precise
      */
-    static std::list<int> PeakSearch_Hight(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
-                                         const double thshold, const Threshold& k40Thshold);
+    static std::vector<int> PeakSearch_Hight(const Spectrum* in, const FWHM& fwhm, const Coeffcients& coeff,
+                                           const double thshold, const Threshold& k40Thshold);
 
 //    static std::list<NcPeak> FindPeak_Beta(Spectrum& PPSpec, Spectrum& DChSpec, repository::DetectorProperty* prop);
 
@@ -70,6 +73,18 @@ public:
                                      const Coeffcients& coeff);
     static void BGErosion(const BinSpectrum& MSBinSpec, const InterCoeff& IterCoeff, BinSpectrum& out,
                           const BinSpectrum& TF, const Coeffcients& coeff);
+    /**
+     * @brief BGErosion with the transfer function and erosion depths precomputed in ctx
+     */
+    static void BGErosion(const BinSpectrum& MSBinSpec, BinSpectrum& out, const AnalysisContext& ctx);
+
+    /**
+     * @brief BGErosionPasses Number of erosion passes of every bin, from the energy of its channel
+     * @param CHArray   Channel of every bin, @ref NcLibrary::BinToCh
+     * @param passes    Output, times every bin is eroded, in [2, 69]
+     */
+    static void BGErosionPasses(const BinSpectrum& CHArray, const InterCoeff& IterCoeff, const Coeffcients& coeff,
+                                std::array<int, BINSIZE>& passes);
 
     /**
      * @brief ReturnReBinning
@@ -83,9 +98,6 @@ public:
     static void BGSubtration(double* MSChSpec, double* ReBinChSpec, Spectrum* PPChSpecOut, const SmoothP& smooth );
     static void BGSubtration(const Spectrum& MSChSpec, const Spectrum& ReBinChSpec, Spectrum* PPChSpecOut, const SmoothP& smooth);
 
-    static void GenDSpecrum(Spectrum& PPChSpec, Spectrum& reBinChSpec, double* DChSpecOut, DetectorProperty* prop,
-                                       bool isMeasurement);
-
 //    static void SearchROI_N(Spectrum& Spc, std::list<NcPeak>& PeakInfo, repository::DetectorProperty* prop);
 
 //    static void NetCount_N(SPC_DATA& Spc, std::list<NcPeak>& PeakInfo, repository::DetectorProperty* prop);
@@ -0,0 +1,293 @@
+#include "RebinOperator.h"
+
+#include <cmath>
+
+using namespace nucare;
+
+RebinOperator::RebinOperator(size_t inSize, size_t outSize) : m_inSize(inSize), m_outSize(outSize)
+{
+    m_rowOut.reserve(outSize);
+    m_rowStart.reserve(outSize + 1);
+    m_cols.reserve(outSize * 4);
+    m_weights.reserve(outSize * 4);
+}
+
+void RebinOperator::beginRow(int out)
+{
+    m_curOut   = out;
+    m_curValid = out >= 0 && out < (int) m_outSize;
+}
+
+void RebinOperator::add(int col, double weight)
+{
+    // The state machines can step past the input at the end, such rows are dropped
+    if (col < 0 || col >= (int) m_inSize) m_curValid = false;
+    if (!m_curValid) return;
+
+    m_cols.push_back(col);
+    m_weights.push_back(weight);
+}
+
+void RebinOperator::endRow()
+{
+    if (m_curValid) {
+        m_rowOut.push_back(m_curOut);
+        m_rowStart.push_back((int) m_cols.size());
+    } else {
+        m_cols.resize(m_rowStart.back());
+        m_weights.resize(m_rowStart.back());
+    }
+    m_curValid = false;
+}
+
+void RebinOperator::apply(const double* in, double* out) const
+{
+    const int* col   = m_cols.data();
+    const double* w  = m_weights.data();
+    const int* start = m_rowStart.data();
+
+    for (size_t r = 0; r < m_rowOut.size(); r++) {
+        int k   = start[r];
+        int end = start[r + 1];
+
+        double acc = k < end ? w[k] * in[col[k]] : 0;
+        for (k++; k < end; k++) {
+            acc += w[k] * in[col[k]];
+        }
+        out[m_rowOut[r]] = acc;
+    }
+}
+
+RebinOperator RebinOperator::rebinning(const double* widths, size_t outSize, size_t inSize, bool clearRows)
+{
+    // Mirrors NcLibrary::ReBinning(), recording the terms instead of adding them up. ReBinning()
+    // reuses sum1 for the counts of a wide bin, here it stays the used part of channel ind_chn
+    RebinOperator op(inSize, outSize);
+
+    bool first = true;
+    double Z = 0, sum1 = 0, sum2 = 0, z_flt = 0, z_flt_pre = 0, ztmp = 0;
+    int ind_chn = 0;
+    const int last = (int) inSize - 1;
+
+    int z_int = 0;
+    for (int i = 0; i < (int) outSize; i++) {
+        Z = widths[i];
+        op.beginRow(i);
+
+        if (Z < 1) {
+            sum1 = sum1 + Z;
+            sum2 = 0;
+
+            if (sum1 > 1) {
+                ind_chn = ind_chn + 1;
+                sum2 = sum1 - 1;
+                op.add(ind_chn - 1, Z - sum2);
+                op.add(ind_chn, sum2);
+                sum1 = sum2;
+            } else {
+                sum2 = Z;
+                op.add(ind_chn, sum2);
+            }
+
+        } else if (Z > 1) {
+            if (first == true) {
+                first = false;
+                z_int = (int) floor(Z);
+                z_flt = Z - z_int;
+
+                if (ind_chn + z_int + 1 > last) {
+                    if (clearRows) op.endRow();
+                    break;
+                }
+
+                for (int j = 1; j <= z_int; j++) {
+                    op.add(ind_chn + j, 1);
+                }
+                op.add(ind_chn + z_int + 1, z_flt);
+
+                ind_chn = ind_chn + z_int + 1;
+                z_flt_pre = 1 - z_flt;
+                sum1 = z_flt;
+            } else {
+                ztmp = Z - z_flt_pre;
+
+                z_int = (int) floor(ztmp);
+
+                if (z_int >= 1) {
+                    z_flt = ztmp - z_int;
+
+                    if (ind_chn + z_int + 1 > last) {
+                        if (clearRows) op.endRow();
+                        break;
+                    }
+
+                    op.add(ind_chn, z_flt_pre);
+                    for (int j = 1; j <= z_int; j++) {
+                        op.add(ind_chn + j, 1);
+                    }
+                    op.add(ind_chn + z_int + 1, z_flt);
+
+                    ind_chn = ind_chn + z_int + 1;
+                    z_flt_pre = 1 - z_flt;
+                    sum1 = z_flt;
+
+                } else {
+                    z_flt = Z - z_flt_pre;
+
+                    if (ind_chn + z_int + 1 > last) {
+                        if (clearRows) op.endRow();
+                        break;
+                    }
+
+                    op.add(ind_chn, z_flt_pre);
+                    op.add(ind_chn + 1, z_flt);
+                    z_flt_pre = 1 - z_flt;
+                    ind_chn = ind_chn + 1;
+                    sum1 = z_flt;
+                }
+            }
+        } else if (Z == 1) {
+            if (ind_chn < (int) inSize) {
+                op.add(ind_chn, 1);
+                ind_chn = ind_chn + 1;
+            } else if (!clearRows) {
+                op.beginRow(-1); // Not written
+            }
+        } else if (!clearRows) {
+            op.beginRow(-1); // NaN width, not written
+        }
+
+        op.endRow();
+    }
+
+    return op;
+}
+
+RebinOperator RebinOperator::returnRebinning(const double* TF, size_t binSize, size_t chSize)
+{
+    // Mirrors PeakSearch::ReturnReBinning(), recording the terms instead of adding them up
+    RebinOperator op(binSize, chSize);
+
+    double sumz1 = 0, sumz2 = 0, sumz3 = 0, z = 0;
+    int cnt = 0, ind_chn = 0, i = 0;
+    bool First = true, First1 = true;
+    const int n = (int) binSize;
+
+    int z_int = 0;
+    double z_pre_w = 0, z_pre = 0, z_cur = 0, z_res = 0;
+
+    while (true) {
+        cnt = 0;
+        if (TF[i] < 1) {
+            while (true) {
+                // Ran off the transfer function before a full channel, nothing more to map
+                if (i + cnt >= n) return op;
+
+                z = TF[i + cnt];
+                sumz1 = sumz1 + z;
+
+                if (sumz1 >= 1) {
+                    break;
+                }
+                cnt = cnt + 1;
+            }
+
+            sumz2 = (z - (sumz1 - 1)) / z;
+
+            op.beginRow(ind_chn);
+            if (First == true) {
+                First = false;
+            } else {
+                op.add(i - 1, sumz3);
+            }
+            for (int j = i; j <= (i + cnt - 1); j++) {
+                op.add(j, 1);
+            }
+            op.add(i + cnt, sumz2);
+            op.endRow();
+
+            sumz3 = (sumz1 - 1) / z;
+
+            sumz1 = sumz1 - 1;
+            ind_chn = ind_chn + 1;
+            i = i + cnt + 1;
+
+            if (i > n - 1) {
+                break;
+            }
+        } else {
+
+            z = TF[i];
+
+            if (First1 == true) {
+                First1 = false;
+                z_int = (int) floor(z);
+                z_pre_w = z - z_int;
+                z_pre = z_pre_w / z;
+
+                op.beginRow(ind_chn);
+                op.add(i, 1 / z);
+                op.endRow();
+                ind_chn = ind_chn + 1;
+                i = i + 1;
+            } else {
+                z_cur = 1 - z_pre_w;
+
+                op.beginRow(ind_chn);
+                op.add(i - 1, z_pre);
+                op.add(i, z_cur / z);
+                op.endRow();
+                z_res = z - z_cur;
+
+                if (z_res > 1) {
+                    z_int = (int) floor(z_res);
+
+                    for (int j = 1; j <= z_int; j++) {
+                        ind_chn = ind_chn + 1;
+
+                        if (i > n - 1) {
+                            break;
+                        }
+
+                        op.beginRow(ind_chn);
+                        op.add(i, 1 / z);
+                        op.endRow();
+                    }
+
+                    z_pre_w = z - z_cur - z_int;
+                    z_pre = z_pre_w / z;
+                } else {
+                    z_pre_w = z_res;
+                    z_pre = z_pre_w / z;
+                }
+                ind_chn = ind_chn + 1;
+            }
+            i = i + 1;
+        }
+
+        if (i > n - 1) {
+            break;
+        }
+    }
+
+    return op;
+}
+
+RebinOperator RebinOperator::convert(double ratio, size_t inSize, size_t outSize)
+{
+    if (ratio > 1) {
+        std::vector<double> widths(outSize, ratio);
+        return rebinning(widths.data(), outSize, inSize, true);
+    }
+
+    // No rebinning, convertSpectrum() only truncates into a smaller spectrum
+    RebinOperator op(inSize, outSize);
+    if (outSize < inSize) {
+        for (int i = 0; i < (int) outSize; i++) {
+            op.beginRow(i);
+            op.add(i, 1);
+            op.endRow();
+        }
+    }
+    return op;
+}
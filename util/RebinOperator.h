@@ -0,0 +1,71 @@
+#ifndef REBINOPERATOR_H
+#define REBINOPERATOR_H
+
+#include <cstddef>
+#include <vector>
+
+namespace nucare {
+
+/**
+ * Rebinning between two channel grids compiled into a sparse matrix (CSR): every written output
+ * channel is a short weighted sum of input channels. The overlap state machines of the rebinning
+ * functions run once when the operator is built, apply() is a plain multiply-add loop.
+ *
+ * Outputs match the functions they are built from, except that an all zero sum may come out as +0
+ * where the original gives -0 or the reverse. Two cases the originals get wrong are not copied:
+ * ReBinning() lets the counts of a wide bin leak into the overlap of a following narrow one, the
+ * operator keeps the overlap (transfer functions widen monotonically, so it never happens there),
+ * and output channels the originals would compute from past the end of the input are not written.
+ */
+class RebinOperator
+{
+public:
+    RebinOperator() = default;
+
+    /**
+     * Same mapping as NcLibrary::ReBinning(): output channel i covers widths[i] input channels.
+     * @param clearRows Also zero the output channel where the input runs out, like
+     *                  Spectrum_t::convertSpectrum() does
+     */
+    static RebinOperator rebinning(const double* widths, size_t outSize, size_t inSize, bool clearRows = false);
+
+    // Same mapping as PeakSearch::ReturnReBinning(), bins of width TF[i] back to channels
+    static RebinOperator returnRebinning(const double* TF, size_t binSize, size_t chSize);
+
+    // Same mapping as Spectrum_t::convertSpectrum() with a calibration ratio
+    static RebinOperator convert(double ratio, size_t inSize, size_t outSize);
+
+    /**
+     * out[row] = sum of weight * in[col] for every written output channel, the others are left
+     * untouched. in must hold inSize() values, out outSize().
+     */
+    void apply(const double* in, double* out) const;
+
+    size_t inSize() const { return m_inSize; }
+    size_t outSize() const { return m_outSize; }
+    // Number of output channels written by apply()
+    size_t rows() const { return m_rowOut.size(); }
+
+private:
+    RebinOperator(size_t inSize, size_t outSize);
+
+    void beginRow(int out);
+    void add(int col, double weight);
+    void endRow();
+
+    size_t m_inSize  = 0;
+    size_t m_outSize = 0;
+
+    std::vector<int> m_rowOut;         // Output channel of every row
+    std::vector<int> m_rowStart = {0}; // Terms of row r are [m_rowStart[r], m_rowStart[r + 1])
+    std::vector<int> m_cols;
+    std::vector<double> m_weights;
+
+    // Row being built
+    int m_curOut    = 0;
+    bool m_curValid = false;
+};
+
+} // namespace nucare
+
+#endif // REBINOPERATOR_H
@@ -0,0 +1,135 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace nucare {
+
+/**
+ * Fixed-capacity circular byte buffer. Data is written straight into the free
+ * region, looked up in place and consumed by moving the read index, so nothing is
+ * reallocated or shifted on the receive path.
+ */
+template <size_t Capacity>
+class RingBuffer
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    RingBuffer() : m_head(0), m_size(0) {}
+
+    RingBuffer(const RingBuffer&)            = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    size_t size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    size_t freeSpace() const { return Capacity - m_size; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    void clear() {
+        m_head = 0;
+        m_size = 0;
+    }
+
+    // Contiguous free region for the next write, len is 0 when the buffer is full
+    char* writeRegion(size_t& len) {
+        const size_t tail = (m_head + m_size) & MASK;
+        len               = std::min(Capacity - tail, Capacity - m_size);
+        return m_data + tail;
+    }
+
+    void commit(size_t n) { m_size += std::min(n, freeSpace()); }
+
+    size_t write(const char* src, size_t n) {
+        size_t written = 0;
+        while (written < n) {
+            size_t len = 0;
+            char* dst  = writeRegion(len);
+            if (len == 0) break;
+
+            len = std::min(len, n - written);
+            memcpy(dst, src + written, len);
+            commit(len);
+            written += len;
+        }
+        return written;
+    }
+
+    char at(size_t offset) const { return m_data[(m_head + offset) & MASK]; }
+
+    // Pointer to the first n bytes when they are stored contiguously, nullptr otherwise
+    const char* contiguousData(size_t n) const {
+        if (n > m_size || m_head + n > Capacity) return nullptr;
+        return m_data + m_head;
+    }
+
+    // Copy the first n bytes without consuming them
+    void peek(char* dst, size_t n) const {
+        n                = std::min(n, m_size);
+        const size_t len = std::min(n, Capacity - m_head);
+        memcpy(dst, m_data + m_head, len);
+        memcpy(dst + len, m_data, n - len);
+    }
+
+    size_t read(char* dst, size_t n) {
+        n = std::min(n, m_size);
+        peek(dst, n);
+        consume(n);
+        return n;
+    }
+
+    void consume(size_t n) {
+        n = std::min(n, m_size);
+        m_head = (m_head + n) & MASK;
+        m_size -= n;
+        if (m_size == 0) m_head = 0; // Keep the next frame contiguous when possible
+    }
+
+    // Offset of the first occurrence of pattern, or npos. Candidates are located with memchr
+    // on each contiguous segment, so the scan runs at memchr speed over noise.
+    size_t find(const char* pattern, size_t len) const {
+        if (len == 0 || len > m_size) return npos;
+
+        const size_t last = m_size - len;
+        size_t offset     = 0;
+        while (offset <= last) {
+            const size_t phys   = (m_head + offset) & MASK;
+            const size_t segLen = std::min(Capacity - phys, last - offset + 1);
+            auto hit            = static_cast<const char*>(memchr(m_data + phys, pattern[0], segLen));
+            if (!hit) {
+                offset += segLen;
+                continue;
+            }
+
+            const size_t candidate = offset + (hit - (m_data + phys));
+            if (matchesAt(candidate, pattern, len)) return candidate;
+            offset = candidate + 1;
+        }
+        return npos;
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    char m_data[Capacity];
+    size_t m_head;
+    size_t m_size;
+
+    bool matchesAt(size_t offset, const char* pattern, size_t len) const {
+        for (size_t i = 1; i < len; i++) {
+            if (at(offset + i) != pattern[i]) return false;
+        }
+        return true;
+    }
+};
+
+template <size_t Capacity>
+constexpr size_t RingBuffer<Capacity>::npos;
+
+} // namespace nucare
+
+#endif // RINGBUFFER_H
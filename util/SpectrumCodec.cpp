@@ -0,0 +1,163 @@
+#include "SpectrumCodec.h"
+
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+using namespace nucare;
+
+namespace {
+
+const char MAGIC[] = {'\0', 'S'};
+const int HEADER   = 4; // Magic, version, encoding
+
+// Counts above this are not exact as a double anyway
+const double MAX_EXACT = 9007199254740992.0; // 2^53
+
+void putVarint(QByteArray& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.append(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.append(static_cast<char>(v));
+}
+
+bool getVarint(const uchar*& p, const uchar* end, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uchar b = *p++;
+        v |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool isCount(double v)
+{
+    // -0 is kept as a raw double so it round trips with its sign
+    return std::fabs(v) <= MAX_EXACT && v == std::floor(v) && !(v == 0 && std::signbit(v));
+}
+
+// Header and value count, p is left on the first value
+bool readHeader(const QByteArray& bytes, const uchar*& p, const uchar*& end, uint8_t& encoding, uint64_t& n)
+{
+    if (bytes.size() < HEADER || bytes[0] != MAGIC[0] || bytes[1] != MAGIC[1]) return false;
+    if (static_cast<uint8_t>(bytes[2]) != SpectrumCodec::VERSION) return false;
+
+    encoding = static_cast<uint8_t>(bytes[3]);
+    p        = reinterpret_cast<const uchar*>(bytes.constData()) + HEADER;
+    end      = reinterpret_cast<const uchar*>(bytes.constData()) + bytes.size();
+    return getVarint(p, end, n);
+}
+
+} // namespace
+
+QByteArray SpectrumCodec::encode(const double* data, size_t n)
+{
+    bool counts = true;
+    for (size_t i = 0; i < n && counts; i++) {
+        counts = isCount(data[i]);
+    }
+
+    QByteArray out;
+    out.reserve(HEADER + 10 + (counts ? 2 * n : 8 * n));
+    out.append(MAGIC, sizeof(MAGIC));
+    out.append(static_cast<char>(VERSION));
+    out.append(static_cast<char>(counts ? DELTA_VARINT : RAW_DOUBLE));
+    putVarint(out, n);
+
+    if (counts) {
+        int64_t prev = 0;
+        for (size_t i = 0; i < n; i++) {
+            const int64_t v     = static_cast<int64_t>(data[i]);
+            const int64_t delta = v - prev;
+            putVarint(out, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+            prev = v;
+        }
+    } else {
+        const int offset = out.size();
+        out.resize(offset + static_cast<int>(8 * n));
+        uchar* dst = reinterpret_cast<uchar*>(out.data()) + offset;
+        for (size_t i = 0; i < n; i++) {
+            quint64 bits;
+            std::memcpy(&bits, &data[i], sizeof(bits));
+            qToLittleEndian(bits, dst + 8 * i);
+        }
+    }
+
+    return out;
+}
+
+QByteArray SpectrumCodec::magic()
+{
+    return QByteArray(MAGIC, sizeof(MAGIC));
+}
+
+bool SpectrumCodec::isEncoded(const QByteArray& bytes)
+{
+    return bytes.size() >= HEADER && bytes[0] == MAGIC[0] && bytes[1] == MAGIC[1];
+}
+
+bool SpectrumCodec::decode(const QByteArray& bytes, double* out, size_t n)
+{
+    const uchar *p, *end;
+    uint8_t encoding;
+    uint64_t count;
+    if (!readHeader(bytes, p, end, encoding, count) || count != n) return false;
+
+    if (encoding == RAW_DOUBLE) {
+        if (static_cast<uint64_t>(end - p) != 8 * count) return false;
+        for (size_t i = 0; i < n; i++) {
+            const quint64 bits = qFromLittleEndian<quint64>(p + 8 * i);
+            std::memcpy(&out[i], &bits, sizeof(bits));
+        }
+        return true;
+    }
+
+    if (encoding == DELTA_VARINT) {
+        int64_t prev = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t z;
+            if (!getVarint(p, end, z)) return false;
+            prev += static_cast<int64_t>((z >> 1) ^ (~(z & 1) + 1));
+            out[i] = static_cast<double>(prev);
+        }
+        return p == end;
+    }
+
+    return false;
+}
+
+bool SpectrumCodec::decode(const QByteArray& bytes, std::vector<double>& out)
+{
+    const uchar *p, *end;
+    uint8_t encoding;
+    uint64_t count;
+    // Every value takes at least one byte, this bounds the size before allocating
+    if (!readHeader(bytes, p, end, encoding, count) || count > static_cast<uint64_t>(end - p)) return false;
+
+    out.resize(count);
+    return decode(bytes, out.data(), out.size());
+}
+
+bool SpectrumCodec::decodeText(const QByteArray& text, std::vector<double>& out)
+{
+    out.clear();
+    if (text.isEmpty()) return false;
+
+    out.reserve(text.count(',') + 1);
+    int begin = 0;
+    while (true) {
+        int comma = text.indexOf(',', begin);
+        if (comma < 0) comma = text.size();
+
+        bool ok;
+        out.push_back(text.mid(begin, comma - begin).trimmed().toDouble(&ok));
+        if (!ok) return false;
+
+        if (comma == text.size()) return true;
+        begin = comma + 1;
+    }
+}
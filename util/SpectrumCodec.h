@@ -0,0 +1,79 @@
+#ifndef SPECTRUMCODEC_H
+#define SPECTRUMCODEC_H
+
+#include "model/Spectrum.h"
+#include <QByteArray>
+#include <QVariant>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace nucare {
+
+/**
+ * Binary format of the spectra stored in the database, replacing the comma joined decimal text of
+ * Spectrum_t::toString().
+ *
+ * Layout: a 0x00 byte (never the first byte of the legacy text), 'S', the format version, the
+ * encoding, the number of values as a varint, then the values. Spectra holding only integer counts
+ * are stored as zigzag varints of the difference to the previous channel, usually one or two bytes a
+ * channel; anything else as raw little-endian doubles. Both round trip exactly.
+ */
+class SpectrumCodec
+{
+public:
+    enum Encoding : uint8_t {
+        RAW_DOUBLE   = 0,
+        DELTA_VARINT = 1,
+    };
+
+    static constexpr uint8_t VERSION = 1;
+
+    static QByteArray encode(const double* data, size_t n);
+
+    template <size_t N>
+    static QByteArray encode(const Spectrum_t<double, N>& spc) {
+        return encode(spc.dataConst(), N);
+    }
+
+    // First bytes of every encode() output
+    static QByteArray magic();
+
+    // Whether bytes start with the header of encode(), otherwise it is legacy text
+    static bool isEncoded(const QByteArray& bytes);
+
+    // Decode exactly n values into out, false if bytes is malformed or holds another size
+    static bool decode(const QByteArray& bytes, double* out, size_t n);
+    static bool decode(const QByteArray& bytes, std::vector<double>& out);
+
+    // Comma joined decimal text written by Spectrum_t::toString()
+    static bool decodeText(const QByteArray& text, std::vector<double>& out);
+
+    /**
+     * Spectrum of a database column, either encode() output or legacy text.
+     * @return nullptr if the column is empty, malformed or not N channels
+     */
+    template <size_t N>
+    static Spectrum_t<double, N>* pDecode(const QVariant& column) {
+        const QByteArray bytes = column.toByteArray();
+        if (bytes.isEmpty()) return nullptr;
+
+        std::unique_ptr<Spectrum_t<double, N>> ret(new Spectrum_t<double, N>());
+        if (isEncoded(bytes)) {
+            if (!decode(bytes, ret->data(), N)) return nullptr;
+        } else {
+            static thread_local std::vector<double> values;
+            if (!decodeText(bytes, values) || values.size() != N) return nullptr;
+            std::copy(values.begin(), values.end(), ret->data());
+        }
+        ret->update();
+
+        return ret.release();
+    }
+};
+
+} // namespace nucare
+
+#endif // SPECTRUMCODEC_H
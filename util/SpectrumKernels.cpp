@@ -0,0 +1,424 @@
+#include "SpectrumKernels.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NC_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace nucare {
+namespace kernel {
+
+namespace {
+
+// raw may be null, rawSum is only touched when it is not
+typedef double (*DecodeFn)(const uint8_t*, double*, uint32_t*, uint64_t*, size_t, double, double);
+
+inline double decodeScalarAt(const uint8_t* in, double* out, uint32_t* raw, uint64_t* rawSum, size_t begin, size_t n,
+                             double scale, double maxCount) {
+    double sum = 0;
+    for (size_t i = begin; i < n; i++) {
+        uint32_t value = (in[2 * i] << 8) | in[2 * i + 1];
+        double count   = value / scale;
+        if (count > maxCount) {
+            count = 0;
+            value = 0;
+        }
+        out[i] = count;
+        sum += count;
+        if (raw) {
+            raw[i] = value;
+            *rawSum += value;
+        }
+    }
+    return sum;
+}
+
+double decodeScalar(const uint8_t* in, double* out, uint32_t* raw, uint64_t* rawSum, size_t n, double scale,
+                    double maxCount) {
+    return decodeScalarAt(in, out, raw, rawSum, 0, n, scale, maxCount);
+}
+
+void accumulateScalar(double* dst, const double* src, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] += src[i];
+}
+
+void accumulateU32Scalar(uint32_t* dst, const uint32_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] += src[i];
+}
+
+void axpyScalar(double* dst, const double* x, double a, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] += a * x[i];
+}
+
+void subtractClamp0Scalar(double* dst, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double v = a[i] - b[i];
+        dst[i]   = v < 0 ? 0 : v;
+    }
+}
+
+void scaleScalar(double* dst, const double* src, double factor, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = src[i] * factor;
+}
+
+// Erosion of x[begin, end), the neighbours 4 away must be inside x
+void erode4ScalarAt(double* x, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        double tmp = (x[i - 4] + x[i + 4]) / 2;
+        if (x[i] > tmp) x[i] = tmp;
+    }
+}
+
+void erode4Scalar(double* x, size_t n) {
+    if (n > 8) erode4ScalarAt(x, 4, n - 4);
+}
+
+double sumScalar(const double* in, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) sum += in[i];
+    return sum;
+}
+
+uint64_t sumU32Scalar(const uint32_t* in, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += in[i];
+    return sum;
+}
+
+// Zero the raw counts of the lanes flagged in the mask, the ones clamped as corrupted
+inline void dropRawLanes(uint32_t* raw, uint64_t* rawSum, unsigned mask) {
+    for (unsigned lane = 0; mask; lane++, mask >>= 1) {
+        if (mask & 1) {
+            *rawSum -= raw[lane];
+            raw[lane] = 0;
+        }
+    }
+}
+
+#ifdef NC_KERNEL_X86
+
+__attribute__((target("sse2"))) inline __m128d clampSse2(__m128d v, __m128d vmax, unsigned& mask, int shift) {
+    __m128d over = _mm_cmpgt_pd(v, vmax);
+    mask |= _mm_movemask_pd(over) << shift;
+    return _mm_andnot_pd(over, v);
+}
+
+__attribute__((target("sse2")))
+double decodeSse2(const uint8_t* in, double* out, uint32_t* raw, uint64_t* rawSum, size_t n, double scale,
+                  double maxCount) {
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128d vdiv  = _mm_set1_pd(scale);
+    const __m128d vmax  = _mm_set1_pd(maxCount);
+    __m128d acc         = _mm_setzero_pd();
+    __m128i rawAcc      = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+        words         = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+        __m128i lo    = _mm_unpacklo_epi16(words, zero);
+        __m128i hi    = _mm_unpackhi_epi16(words, zero);
+
+        unsigned over = 0;
+        __m128d d0    = clampSse2(_mm_div_pd(_mm_cvtepi32_pd(lo), vdiv), vmax, over, 0);
+        __m128d d1    = clampSse2(_mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0x4E)), vdiv), vmax, over, 2);
+        __m128d d2    = clampSse2(_mm_div_pd(_mm_cvtepi32_pd(hi), vdiv), vmax, over, 4);
+        __m128d d3    = clampSse2(_mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0x4E)), vdiv), vmax, over, 6);
+
+        _mm_storeu_pd(out + i, d0);
+        _mm_storeu_pd(out + i + 2, d1);
+        _mm_storeu_pd(out + i + 4, d2);
+        _mm_storeu_pd(out + i + 6, d3);
+        acc = _mm_add_pd(acc, _mm_add_pd(_mm_add_pd(d0, d1), _mm_add_pd(d2, d3)));
+
+        if (raw) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(raw + i), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(raw + i + 4), hi);
+            // 16 bit counts, a 32 bit lane cannot overflow before 32768 blocks
+            rawAcc = _mm_add_epi32(rawAcc, _mm_add_epi32(lo, hi));
+            if (((i / 8) & 0x7FFF) == 0x7FFF) {
+                uint32_t parts[4];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(parts), rawAcc);
+                *rawSum += (uint64_t) parts[0] + parts[1] + parts[2] + parts[3];
+                rawAcc = _mm_setzero_si128();
+            }
+            if (over) dropRawLanes(raw + i, rawSum, over);
+        }
+    }
+
+    if (raw) {
+        uint32_t parts[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(parts), rawAcc);
+        *rawSum += (uint64_t) parts[0] + parts[1] + parts[2] + parts[3];
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1] + decodeScalarAt(in, out, raw, rawSum, i, n, scale, maxCount);
+}
+
+__attribute__((target("avx2"))) inline __m256d clampAvx2(__m256d v, __m256d vmax, unsigned& mask, int shift) {
+    __m256d over = _mm256_cmp_pd(v, vmax, _CMP_GT_OQ);
+    mask |= _mm256_movemask_pd(over) << shift;
+    return _mm256_andnot_pd(over, v);
+}
+
+__attribute__((target("avx2")))
+double decodeAvx2(const uint8_t* in, double* out, uint32_t* raw, uint64_t* rawSum, size_t n, double scale,
+                  double maxCount) {
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256d vdiv = _mm256_set1_pd(scale);
+    const __m256d vmax = _mm256_set1_pd(maxCount);
+    __m256d acc        = _mm256_setzero_pd();
+    __m256i rawAcc     = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+        words         = _mm256_shuffle_epi8(words, swap);
+        __m256i lo    = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(words));
+        __m256i hi    = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(words, 1));
+        unsigned over = 0;
+
+        __m256d d0 = clampAvx2(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(lo)), vdiv), vmax, over, 0);
+        __m256d d1 = clampAvx2(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(lo, 1)), vdiv), vmax, over, 4);
+        __m256d d2 = clampAvx2(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(hi)), vdiv), vmax, over, 8);
+        __m256d d3 = clampAvx2(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(hi, 1)), vdiv), vmax, over, 12);
+
+        _mm256_storeu_pd(out + i, d0);
+        _mm256_storeu_pd(out + i + 4, d1);
+        _mm256_storeu_pd(out + i + 8, d2);
+        _mm256_storeu_pd(out + i + 12, d3);
+        acc = _mm256_add_pd(acc, _mm256_add_pd(_mm256_add_pd(d0, d1), _mm256_add_pd(d2, d3)));
+
+        if (raw) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(raw + i), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(raw + i + 8), hi);
+            // 16 bit counts, a 32 bit lane cannot overflow before 32768 blocks
+            rawAcc = _mm256_add_epi32(rawAcc, _mm256_add_epi32(lo, hi));
+            if (((i / 16) & 0x7FFF) == 0x7FFF) {
+                uint32_t parts[8];
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), rawAcc);
+                for (auto part : parts) *rawSum += part;
+                rawAcc = _mm256_setzero_si256();
+            }
+            if (over) dropRawLanes(raw + i, rawSum, over);
+        }
+    }
+
+    if (raw) {
+        uint32_t parts[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(parts), rawAcc);
+        for (auto part : parts) *rawSum += part;
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + decodeScalarAt(in, out, raw, rawSum, i, n, scale, maxCount);
+}
+
+__attribute__((target("avx2,fma")))
+void accumulateAvx2(double* dst, const double* src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d a0 = _mm256_add_pd(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i));
+        __m256d a1 = _mm256_add_pd(_mm256_loadu_pd(dst + i + 4), _mm256_loadu_pd(src + i + 4));
+        _mm256_storeu_pd(dst + i, a0);
+        _mm256_storeu_pd(dst + i + 4, a1);
+    }
+    accumulateScalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+void accumulateU32Avx2(uint32_t* dst, const uint32_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi32(d, s));
+    }
+    accumulateU32Scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+void axpyAvx2(double* dst, const double* x, double a, size_t n) {
+    const __m256d va = _mm256_set1_pd(a);
+    size_t i         = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d r0 = _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(dst + i));
+        __m256d r1 = _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(dst + i + 4));
+        _mm256_storeu_pd(dst + i, r0);
+        _mm256_storeu_pd(dst + i + 4, r1);
+    }
+    axpyScalar(dst + i, x + i, a, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+void subtractClamp0Avx2(double* dst, const double* a, const double* b, size_t n) {
+    const __m256d zero = _mm256_setzero_pd();
+    size_t i           = 0;
+    for (; i + 4 <= n; i += 4) {
+        // max(0, v) keeps -0 and NaN like the scalar "v < 0 ? 0 : v"
+        __m256d v = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        _mm256_storeu_pd(dst + i, _mm256_max_pd(zero, v));
+    }
+    subtractClamp0Scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+void scaleAvx2(double* dst, const double* src, double factor, size_t n) {
+    const __m256d vf = _mm256_set1_pd(factor);
+    size_t i         = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(src + i), vf));
+    }
+    scaleScalar(dst + i, src + i, factor, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+double sumAvx2(const double* in, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i     = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(in + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(in + i + 4));
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumScalar(in + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+uint64_t sumU32Avx2(const uint32_t* in, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i    = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        acc       = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+        acc       = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumU32Scalar(in + i, n - i);
+}
+
+// Lanes i..i+3 only read x[i-4..i-1], finished by the previous step, and x[i+4..i+7], not
+// eroded yet, so a 4 wide step gives the scalar result. min(tmp, x) keeps x when either is NaN,
+// like "if (x > tmp) x = tmp", and halving by * 0.5 is exact.
+__attribute__((target("avx2,fma")))
+void erode4Avx2(double* x, size_t n) {
+    if (n <= 8) return;
+
+    const __m256d half = _mm256_set1_pd(0.5);
+    const size_t end   = n - 4;
+    size_t i           = 4;
+    // The previous step stays in a register, no reload of what was just stored
+    __m256d prev = _mm256_loadu_pd(x);
+    for (; i + 4 <= end; i += 4) {
+        __m256d tmp = _mm256_mul_pd(_mm256_add_pd(prev, _mm256_loadu_pd(x + i + 4)), half);
+        prev        = _mm256_min_pd(tmp, _mm256_loadu_pd(x + i));
+        _mm256_storeu_pd(x + i, prev);
+    }
+    erode4ScalarAt(x, i, end);
+}
+
+// Same as erode4Avx2 with 2 lanes
+__attribute__((target("sse2")))
+void erode4Sse2(double* x, size_t n) {
+    if (n <= 8) return;
+
+    const __m128d half = _mm_set1_pd(0.5);
+    const size_t end   = n - 4;
+    size_t i           = 4;
+    for (; i + 2 <= end; i += 2) {
+        __m128d tmp = _mm_mul_pd(_mm_add_pd(_mm_loadu_pd(x + i - 4), _mm_loadu_pd(x + i + 4)), half);
+        _mm_storeu_pd(x + i, _mm_min_pd(tmp, _mm_loadu_pd(x + i)));
+    }
+    erode4ScalarAt(x, i, end);
+}
+
+#endif // NC_KERNEL_X86
+
+struct Dispatch {
+    DecodeFn decode;
+    void (*accumulate)(double*, const double*, size_t);
+    void (*accumulateU32)(uint32_t*, const uint32_t*, size_t);
+    void (*axpy)(double*, const double*, double, size_t);
+    void (*subtractClamp0)(double*, const double*, const double*, size_t);
+    void (*scale)(double*, const double*, double, size_t);
+    void (*erode4)(double*, size_t);
+    double (*sum)(const double*, size_t);
+    uint64_t (*sumU32)(const uint32_t*, size_t);
+    const char* isa;
+
+    Dispatch()
+        : decode(decodeScalar), accumulate(accumulateScalar), accumulateU32(accumulateU32Scalar), axpy(axpyScalar),
+          subtractClamp0(subtractClamp0Scalar), scale(scaleScalar), erode4(erode4Scalar), sum(sumScalar),
+          sumU32(sumU32Scalar), isa("scalar") {
+#ifdef NC_KERNEL_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            decode         = decodeAvx2;
+            accumulate     = accumulateAvx2;
+            accumulateU32  = accumulateU32Avx2;
+            axpy           = axpyAvx2;
+            subtractClamp0 = subtractClamp0Avx2;
+            scale          = scaleAvx2;
+            erode4         = erode4Avx2;
+            sum            = sumAvx2;
+            sumU32         = sumU32Avx2;
+            isa            = "avx2";
+        } else if (__builtin_cpu_supports("sse2")) {
+            decode = decodeSse2;
+            erode4 = erode4Sse2;
+            isa    = "sse2";
+        }
+#endif
+    }
+};
+
+const Dispatch& dispatch() {
+    static const Dispatch d;
+    return d;
+}
+
+} // namespace
+
+double decodeBe16Counts(const void* in, double* out, size_t n, double scale, double maxCount) {
+    return dispatch().decode(static_cast<const uint8_t*>(in), out, nullptr, nullptr, n, scale, maxCount);
+}
+
+double decodeBe16Counts(const void* in, double* out, uint32_t* raw, uint64_t& rawSum, size_t n, double scale,
+                        double maxCount) {
+    rawSum = 0;
+    return dispatch().decode(static_cast<const uint8_t*>(in), out, raw, &rawSum, n, scale, maxCount);
+}
+
+void accumulate(double* dst, const double* src, size_t n) { dispatch().accumulate(dst, src, n); }
+
+void accumulate(uint32_t* dst, const uint32_t* src, size_t n) { dispatch().accumulateU32(dst, src, n); }
+
+void axpy(double* dst, const double* x, double a, size_t n) { dispatch().axpy(dst, x, a, n); }
+
+void subtractClamp0(double* dst, const double* a, const double* b, size_t n) {
+    dispatch().subtractClamp0(dst, a, b, n);
+}
+
+void scale(double* dst, const double* src, double factor, size_t n) { dispatch().scale(dst, src, factor, n); }
+
+void erode4(double* x, size_t n) { dispatch().erode4(x, n); }
+
+double sum(const double* in, size_t n) { return dispatch().sum(in, n); }
+
+uint64_t sum(const uint32_t* in, size_t n) { return dispatch().sumU32(in, n); }
+
+const char* activeIsa() { return dispatch().isa; }
+
+} // namespace kernel
+} // namespace nucare
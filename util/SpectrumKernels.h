@@ -0,0 +1,57 @@
+#ifndef SPECTRUMKERNELS_H
+#define SPECTRUMKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Hot spectrum loops with SIMD implementations. The best implementation for the
+ * running CPU (AVX2 with FMA, SSE2 or plain C++) is picked once, on first use.
+ * Element-wise kernels accept dst aliasing one of the inputs. Results may differ
+ * between implementations in the last bits, sums are added in a different order.
+ */
+namespace nucare {
+namespace kernel {
+
+/**
+ * Decode n big-endian uint16 counts into out[i] = count / scale. Values above maxCount
+ * are treated as corrupted and set to 0. Returns the sum of the decoded channels.
+ */
+double decodeBe16Counts(const void* in, double* out, size_t n, double scale, double maxCount);
+
+/**
+ * Same as above and also stores the integer counts into raw, corrupted channels zeroed the
+ * same way, in the same pass. rawSum receives the sum of raw.
+ */
+double decodeBe16Counts(const void* in, double* out, uint32_t* raw, uint64_t& rawSum, size_t n, double scale,
+                        double maxCount);
+
+// dst[i] += src[i]
+void accumulate(double* dst, const double* src, size_t n);
+void accumulate(uint32_t* dst, const uint32_t* src, size_t n);
+
+// dst[i] += a * x[i], fused multiply-add when available
+void axpy(double* dst, const double* x, double a, size_t n);
+
+// dst[i] = max(a[i] - b[i], 0)
+void subtractClamp0(double* dst, const double* a, const double* b, size_t n);
+
+// dst[i] = src[i] * factor
+void scale(double* dst, const double* src, double factor, size_t n);
+
+/**
+ * One erosion pass in place, left to right: x[i] = min(x[i], (x[i - 4] + x[i + 4]) / 2) for
+ * 4 <= i < n - 4. x[i - 4] is already eroded when x[i] is computed. Exact in every implementation.
+ */
+void erode4(double* x, size_t n);
+
+double sum(const double* in, size_t n);
+uint64_t sum(const uint32_t* in, size_t n);
+
+// Name of the implementation selected for this CPU, for logging
+const char* activeIsa();
+
+} // namespace kernel
+} // namespace nucare
+
+#endif // SPECTRUMKERNELS_H
@@ -0,0 +1,78 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace nucare {
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * The producer never blocks: when the queue is full tryPush() fails and the item is
+ * counted as dropped, so a slow consumer can not stall the producer.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscQueue() : m_head(0), m_tail(0), m_pushed(0), m_dropped(0) {}
+
+    SpscQueue(const SpscQueue&)            = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side
+    bool tryPush(T&& item) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) >= Capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_slots[tail & (Capacity - 1)] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer side
+    bool tryPop(T& out) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        auto& slot = m_slots[head & (Capacity - 1)];
+        out        = std::move(slot);
+        slot       = T();
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Statistics, safe to read from any thread
+    size_t depth() const {
+        // Head first: the tail can only move ahead of it afterwards
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+    static constexpr size_t capacity() { return Capacity; }
+    uint64_t pushedCount() const { return m_pushed.load(std::memory_order_relaxed); }
+    uint64_t droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::array<T, Capacity> m_slots;
+
+    // Keep the producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+    std::atomic<uint64_t> m_pushed;
+    std::atomic<uint64_t> m_dropped;
+};
+
+} // namespace nucare
+
+#endif // SPSCQUEUE_H
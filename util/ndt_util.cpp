@@ -1,166 +1,287 @@
 #include "ndt_util.h"
 #include "util/nc_exception.h"
+#include "util/util.h"
 #include "config.h"
 
+#include <algorithm>
 #include <cmath>
 using namespace nucare;
 
-double ndt::Mass_Attenuation_coefficient_Iron(const Energy En, const Material material) {
-    // Mass attenuation coefficient data (cm2/g)
-    std::vector<Energy> mass_abs_coef;
+namespace {
+
+// Point of a NIST mass attenuation table: photon energy (keV), mass attenuation coefficient (cm2/g).
+// An absorption edge is two points at the same energy, below then above the edge.
+struct AttenuationPoint {
+    double keV;
+    double mu;
+};
+
+constexpr AttenuationPoint IRON_TABLE[] = {
+    {1.0, 9.09E+03},     {1.5, 3.40E+03},     {2.0, 1.63E+03},     {3.0, 5.58E+02},     {4.0, 2.57E+02},
+    {5.0, 1.40E+02},     {6.0, 8.48E+01},     {7.11, 5.32E+01},    {7.11, 4.08E+02},    {8.0, 3.06E+02},
+    {10.0, 1.71E+02},    {15.0, 5.71E+01},    {20.0, 2.57E+01},    {30.0, 8.18E+00},    {40.0, 3.63E+00},
+    {50.0, 1.96E+00},    {60.0, 1.21E+00},    {80.0, 5.95E-01},    {100.0, 3.72E-01},   {150.0, 1.96E-01},
+    {200.0, 1.46E-01},   {300.0, 1.10E-01},   {400.0, 9.40E-02},   {500.0, 8.41E-02},   {600.0, 7.70E-02},
+    {800.0, 6.70E-02},   {1000.0, 6.00E-02},  {1250.0, 5.35E-02},  {1500.0, 4.88E-02},  {2000.0, 4.27E-02},
+    {3000.0, 3.62E-02},  {4000.0, 3.31E-02},  {5000.0, 3.15E-02},  {6000.0, 3.06E-02},  {8000.0, 2.99E-02},
+    {10000.0, 2.99E-02}, {15000.0, 3.09E-02}, {20000.0, 3.22E-02},
+};
+
+constexpr AttenuationPoint ALUMINUM_TABLE[] = {
+    {1.0, 1.19E+03},     {1.5, 4.02E+02},     {1.56, 3.62E+02},    {1.56, 3.96E+03},    {2.0, 2.26E+03},
+    {3.0, 7.88E+02},     {4.0, 3.61E+02},     {5.0, 1.93E+02},     {6.0, 1.15E+02},     {8.0, 5.03E+01},
+    {10.0, 2.62E+01},    {15.0, 7.96E+00},    {20.0, 3.44E+00},    {30.0, 1.13E+00},    {40.0, 5.69E-01},
+    {50.0, 3.68E-01},    {60.0, 2.78E-01},    {80.0, 2.02E-01},    {100.0, 1.70E-01},   {150.0, 1.38E-01},
+    {200.0, 1.22E-01},   {300.0, 1.04E-01},   {400.0, 9.28E-02},   {500.0, 8.45E-02},   {600.0, 7.80E-02},
+    {800.0, 6.84E-02},   {1000.0, 6.15E-02},  {1250.0, 5.50E-02},  {1500.0, 5.01E-02},  {2000.0, 4.32E-02},
+    {3000.0, 3.54E-02},  {4000.0, 3.11E-02},  {5000.0, 2.84E-02},  {6000.0, 2.66E-02},  {8000.0, 2.44E-02},
+    {10000.0, 2.32E-02}, {15000.0, 2.20E-02}, {20000.0, 2.17E-02},
+};
 
-    // Energy data in MeV
-    std::vector<Energy> Mev;
+// From 10 keV, above the K edge
+constexpr AttenuationPoint COPPER_TABLE[] = {
+    {10.0, 2.16E+02},    {15.0, 7.41E+01},    {20.0, 3.38E+01},    {30.0, 1.09E+01},    {40.0, 4.86E+00},
+    {50.0, 2.61E+00},    {60.0, 1.59E+00},    {80.0, 7.63E-01},    {100.0, 4.58E-01},   {150.0, 2.22E-01},
+    {200.0, 1.56E-01},   {300.0, 1.12E-01},   {400.0, 9.41E-02},   {500.0, 8.36E-02},   {600.0, 7.63E-02},
+    {800.0, 6.61E-02},   {1000.0, 5.90E-02},  {1250.0, 5.26E-02},  {1500.0, 4.80E-02},  {2000.0, 4.21E-02},
+    {3000.0, 3.60E-02},  {4000.0, 3.32E-02},  {5000.0, 3.18E-02},  {6000.0, 3.11E-02},  {8000.0, 3.07E-02},
+    {10000.0, 3.10E-02}, {15000.0, 3.25E-02}, {20000.0, 3.41E-02},
+};
 
+// From 10 keV, with the L and K edges
+constexpr AttenuationPoint LEAD_TABLE[] = {
+    {10.0, 1.31E+02},    {13.04, 6.70E+01},   {13.04, 1.62E+02},   {15.0, 1.12E+02},    {15.2, 1.08E+02},
+    {15.2, 1.49E+02},    {15.86, 1.34E+02},   {15.86, 1.55E+02},   {20.0, 8.64E+01},    {30.0, 3.03E+01},
+    {40.0, 1.44E+01},    {50.0, 8.04E+00},    {60.0, 5.02E+00},    {80.0, 2.42E+00},    {88.0, 1.91E+00},
+    {88.0, 7.68E+00},    {100.0, 5.55E+00},   {150.0, 2.01E+00},   {200.0, 9.99E-01},   {300.0, 4.03E-01},
+    {400.0, 2.32E-01},   {500.0, 1.61E-01},   {600.0, 1.25E-01},   {800.0, 8.87E-02},   {1000.0, 7.10E-02},
+    {1250.0, 5.88E-02},  {1500.0, 5.22E-02},  {2000.0, 4.61E-02},  {3000.0, 4.23E-02},  {4000.0, 4.20E-02},
+    {5000.0, 4.27E-02},  {6000.0, 4.39E-02},  {8000.0, 4.68E-02},  {10000.0, 4.97E-02}, {15000.0, 5.66E-02},
+    {20000.0, 6.21E-02},
+};
+
+struct AttenuationTable {
+    const AttenuationPoint* begin;
+    const AttenuationPoint* end;
+};
+
+template <size_t N>
+constexpr AttenuationTable tableOf(const AttenuationPoint (&points)[N])
+{
+    return {points, points + N};
+}
+
+AttenuationTable attenuationTable(Material material)
+{
     switch (material) {
     case IRON:
-        mass_abs_coef = {
-            9.09E+03, 3.40E+03, 1.63E+03, 5.58E+02, 2.57E+02, 1.40E+02, 8.48E+01,
-            5.32E+01, 4.08E+02, 3.06E+02, 1.71E+02, 5.71E+01, 2.57E+01, 8.18E+00,
-            3.63E+00, 1.96E+00, 1.21E+00, 5.95E-01, 3.72E-01, 1.96E-01, 1.46E-01,
-            1.10E-01, 9.40E-02, 8.41E-02, 7.70E-02, 6.70E-02, 6.00E-02, 5.35E-02,
-            4.88E-02, 4.27E-02, 3.62E-02, 3.31E-02, 3.15E-02, 3.06E-02, 2.99E-02,
-            2.99E-02, 3.09E-02, 3.22E-02
-        };
-        Mev = {
-                1.00E-03, 1.50E-03, 2.00E-03, 3.00E-03, 4.00E-03, 5.00E-03, 6.00E-03,
-                7.11E-03, 7.11E-03, 8.00E-03, 1.00E-02, 1.50E-02, 2.00E-02, 3.00E-02,
-                4.00E-02, 5.00E-02, 6.00E-02, 8.00E-02, 1.00E-01, 1.50E-01, 2.00E-01,
-                3.00E-01, 4.00E-01, 5.00E-01, 6.00E-01, 8.00E-01, 1.00E+00, 1.25E+00,
-                1.50E+00, 2.00E+00, 3.00E+00, 4.00E+00, 5.00E+00, 6.00E+00, 8.00E+00,
-                1.00E+01, 1.50E+01, 2.00E+01
-            };
-        break;
+        return tableOf(IRON_TABLE);
     case ALUMINUM:
-        mass_abs_coef = {
-            1.19E+03, 4.02E+02, 3.62E+02, 3.96E+03, 2.26E+03, 7.88E+02, 3.61E+02,
-            1.93E+02, 1.15E+02, 5.03E+01, 2.62E+01, 7.96E+00, 3.44E+00, 1.13E+00,
-            5.69E-01, 3.68E-01, 2.78E-01, 2.02E-01, 1.70E-01, 1.38E-01, 1.22E-01,
-            1.04E-01, 9.28E-02, 8.45E-02, 7.80E-02, 6.84E-02, 6.15E-02, 5.50E-02,
-            5.01E-02, 4.32E-02, 3.54E-02, 3.11E-02, 2.84E-02, 2.66E-02, 2.44E-02,
-            2.32E-02, 2.20E-02, 2.17E-02
-        };
-        Mev = {
-            1.00E-03, 1.50E-03, 1.56E-03, 1.56E-03, 2.00E-03, 3.00E-03, 4.00E-03,
-            5.00E-03, 6.00E-03, 8.00E-03, 1.00E-02, 1.50E-02, 2.00E-02, 3.00E-02,
-            4.00E-02, 5.00E-02, 6.00E-02, 8.00E-02, 1.00E-01, 1.50E-01, 2.00E-01,
-            3.00E-01, 4.00E-01, 5.00E-01, 6.00E-01, 8.00E-01, 1.00E+00, 1.25E+00,
-            1.50E+00, 2.00E+00, 3.00E+00, 4.00E+00, 5.00E+00, 6.00E+00, 8.00E+00,
-            1.00E+01, 1.50E+01, 2.00E+01
-        };
-        break;
+        return tableOf(ALUMINUM_TABLE);
+    case COPPER:
+        return tableOf(COPPER_TABLE);
+    case LEAD:
+        return tableOf(LEAD_TABLE);
     }
+    NC_THROW_ALG_ERROR("Unknown material.");
+}
 
-    // Convert energy data from MeV to KeV
-    std::vector<double> KeV(Mev.size());
-    for (size_t i = 0; i < Mev.size(); ++i) {
-        KeV[i] = Mev[i] * 1000.0;
-    }
+double interpolateAttenuation(const Energy En, const Material material)
+{
+    auto table = attenuationTable(material);
 
     // Find the insertion point for En using binary search
-    auto it = std::lower_bound(KeV.begin(), KeV.end(), En);
-    size_t ind = std::distance(KeV.begin(), it);
+    auto it = std::lower_bound(table.begin, table.end, En,
+                               [](const AttenuationPoint& p, Energy e) { return p.keV < e; });
 
     // Handle edge cases
-    if (ind == 0) {
-        if (En < KeV[0]) {
-             NC_THROW_ALG_ERROR("Energy (En) is below the lowest data point.");
+    if (it == table.begin) {
+        if (!(En >= table.begin->keV)) {
+            NC_THROW_ALG_ERROR("Energy (En) is below the lowest data point.");
         }
-        return mass_abs_coef[0]; // En == KeV[0]
+        return it->mu; // En == lowest energy
     }
-    if (ind == KeV.size()) {
+    if (it == table.end) {
         NC_THROW_ALG_ERROR("Energy (En) is above the highest data point.");
     }
 
     // If En matches an exact data point
-    if (En == KeV[ind]) {
-        return mass_abs_coef[ind];
+    if (En == it->keV) {
+        return it->mu;
     }
 
-    // Perform linear interpolation
-    Energy x1 = KeV[ind - 1];
-    Energy x2 = KeV[ind];
-    Energy y1 = mass_abs_coef[ind - 1];
-    Energy y2 = mass_abs_coef[ind];
+    // Attenuation is close to a power law between two points, interpolate linearly in log-log
+    auto lo  = it - 1;
+    double t = std::log(En / lo->keV) / std::log(it->keV / lo->keV);
+    return lo->mu * std::exp(t * std::log(it->mu / lo->mu));
+}
+
+} // namespace
 
-    Energy a = (y1 - y2) / (x1 - x2); // Slope
-    Energy b = y1 - a * x1;           // Intercept
+double ndt::Mass_Attenuation_coefficient(const Energy En, const Material material) {
+    // The source lines of a profile rarely change, keep the last few results of this thread
+    struct Entry {
+        Material material;
+        Energy En;
+        double mu;
+    };
+    constexpr int CACHE_SIZE = 8;
+    static thread_local Entry cache[CACHE_SIZE];
+    static thread_local int cached = 0, next = 0;
 
-    return a * En + b;
+    for (int i = 0; i < cached; i++) {
+        if (cache[i].material == material && cache[i].En == En) return cache[i].mu;
+    }
+
+    double mu   = interpolateAttenuation(En, material);
+    cache[next] = {material, En, mu};
+    next        = (next + 1) % CACHE_SIZE;
+    cached      = std::min(cached + 1, CACHE_SIZE);
+    return mu;
 }
 
-/**
- * @brief Estimates tc_est iteratively based on given parameters and mu values.
- *
- * This function performs an iterative calculation to refine the estimate of tc_est.
- * It uses a linear update rule derived from the provided input parameters.
- *
- * @param A A double value used in the numerator calculation.
- * @param B A double value used in the numerator calculation.
- * @param params A std::vector<double> containing polynomial coefficients (a1, b1, c1).
- * Expected to have at least 3 elements.
- * @param mu_ce1 A double value for mu_ce1.
- * @param mu_ce2 A double value for mu_ce2.
- * @param mu_pe1 A double value for mu_pe1.
- * @param mu_pe2 A double value for mu_pe2.
- * @param tp A double value for tp.
- * @param tc_est_initial The initial estimate for tc_est. It will be updated iteratively.
- * @return The refined estimate of tc_est after iteration, or the initial value if conditions are met.
- */
-double ndt::estimate_tc_from_Est_E2(double A, double B, const std::vector<double>& params,
-                               double mu_ce1, double mu_ce2,
-                               double mu_pe1, double mu_pe2,
-                               double tp, double tc_est_initial) {
+double ndt::Mass_Attenuation_coefficient_Iron(const Energy En, const Material material) {
+    return Mass_Attenuation_coefficient(En, material);
+}
 
-    double tc_est = tc_est_initial;
+namespace {
 
-    // Ensure tc_est is not negative (equivalent to MATLAB's if(tc_est<0) tc_est=0;)
-    if (tc_est < 0) {
-        tc_est = 0;
-    }
+// Below this the denominator of the update rule is treated as 0
+constexpr double MIN_DENOMINATOR = 1e-12;
+// Convergence tolerance of the fixed point iteration the estimate replaces
+constexpr double TC_TOLERANCE = 1e-6;
+constexpr int MAX_NEWTON_STEPS = 4;
 
-    const int max_iter = 10000;
-    const double tol = 1e-6; // Tolerance for convergence
+// Terms of the update rule not depending on A and B
+struct TcModel {
+    double a1, b1, c1;
+    double mu_ce1, mu_ce2;
+    double offset; // -(mu_ce1 * mu_pe1 + mu_ce2 * mu_pe2) * tp
+    double denominator;
+    double t0;
+};
 
-    // Extract polynomial coefficients from params vector
+TcModel makeTcModel(const std::vector<double>& params, double mu_ce1, double mu_ce2, double mu_pe1,
+                    double mu_pe2, double tp, double tc_est_initial)
+{
     // Ensure params has enough elements to avoid out-of-bounds access
-    // This assumes params has at least 3 elements for a1, b1, c1
     if (params.size() < 3) {
         NC_THROW_ALG_ERROR("Invalid paramter");
     }
-    double a1 = (params.size() > 0) ? params[0] : 0.0;
-    double b1 = (params.size() > 1) ? params[1] : 0.0;
-    double c1 = (params.size() > 2) ? params[2] : 0.0;
 
     // a2, b2, c2 are commented out in MATLAB and k2 is hardcoded to 1.
-    // double a2 = (params.size() > 3) ? params[3] : 0.0;
-    // double b2 = (params.size() > 4) ? params[4] : 0.0;
-    // double c2 = (params.size() > 5) ? params[5] : 0.0;
-
-    for (int iter = 0; iter < max_iter; ++iter) {
-        double k1 = POLY(tc_est, a1, b1, c1);
-        // k2 is hardcoded to 1 in your MATLAB code
-        double k2 = 1.0; // k2 = a2 * std::pow(tc_est, 2) + b2 * tc_est + c2;
-
-        double numerator = mu_ce1 * (k1 * A - mu_pe1 * tp) + mu_ce2 * (k2 * B - mu_pe2 * tp);
-        double denominator = std::pow(mu_ce1, 2) + std::pow(mu_ce2, 2);
-
-        // Avoid division by zero if denominator is too small
-        if (std::abs(denominator) < 1e-12) { // Use a small epsilon to check for near-zero
-            // Handle error: denominator is zero or near zero.
-            // This might indicate an issue with the input values or convergence.
-            // For now, break or return the current tc_est.
-            return tc_est;
-        }
+    TcModel m;
+    m.a1          = params[0];
+    m.b1          = params[1];
+    m.c1          = params[2];
+    m.mu_ce1      = mu_ce1;
+    m.mu_ce2      = mu_ce2;
+    m.offset      = -(mu_ce1 * mu_pe1 + mu_ce2 * mu_pe2) * tp;
+    m.denominator = mu_ce1 * mu_ce1 + mu_ce2 * mu_ce2;
+    // Ensure tc_est is not negative (equivalent to MATLAB's if(tc_est<0) tc_est=0;)
+    m.t0 = tc_est_initial < 0 ? 0 : tc_est_initial;
+    return m;
+}
 
-        double tc_new = numerator / denominator;
+ndt::TcEstimate solveTc(const TcModel& m, double A, double B)
+{
+    ndt::TcEstimate ret;
+    if (std::abs(m.denominator) < MIN_DENOMINATOR) {
+        ret.tc     = m.t0;
+        ret.status = ndt::TcEstimate::InvalidInput;
+        return ret;
+    }
+
+    // The update is g(t) = alpha * t^2 + beta * t + gamma
+    double alpha = m.mu_ce1 * A * m.a1 / m.denominator;
+    double beta  = m.mu_ce1 * A * m.b1 / m.denominator;
+    double gamma = (m.mu_ce1 * A * m.c1 + m.mu_ce2 * B + m.offset) / m.denominator;
+
+    double t0  = m.t0;
+    double g0  = (alpha * t0 + beta) * t0 + gamma;
+    ret.tc     = NAN;
+    ret.status = ndt::TcEstimate::NotConverged;
+
+    if (std::abs(g0 - t0) < TC_TOLERANCE) {
+        // The iteration stops right away
+        ret.tc     = t0;
+        ret.status = ndt::TcEstimate::Converged;
+        return ret;
+    }
+
+    // Fixed points: alpha * t^2 + p * t + gamma = 0. g' is 2 * alpha * t + beta, it sums to 2 over
+    // both roots, so at most one attracts the iteration.
+    double p = beta - 1;
+    double root;
+    if (alpha == 0) {
+        if (!(std::abs(beta) < 1)) return ret;
+        root = -gamma / p;
+    } else {
+        double disc = p * p - 4 * alpha * gamma;
+        if (!(disc >= 0)) return ret;
+
+        double q  = -0.5 * (p + std::copysign(std::sqrt(disc), p));
+        double r1 = q / alpha;
+        double r2 = q != 0 ? gamma / q : r1;
 
-        if (std::abs(tc_new - tc_est) < tol) {
-            break; // Converged
+        double repelling;
+        if (std::abs(2 * alpha * r1 + beta) < 1) {
+            root      = r1;
+            repelling = r2;
+        } else if (std::abs(2 * alpha * r2 + beta) < 1) {
+            root      = r2;
+            repelling = r1;
+        } else {
+            return ret;
         }
 
-        tc_est = tc_new; // Update estimate for next iteration
+        // The iteration converges from between the repelling point and its mirror about the vertex
+        double mirror = -beta / alpha - repelling;
+        if (!(t0 > std::min(repelling, mirror) && t0 < std::max(repelling, mirror))) return ret;
     }
 
-    return tc_est; // Return the final estimated value
+    for (int i = 0; i < MAX_NEWTON_STEPS; i++) {
+        double f     = (alpha * root + p) * root + gamma;
+        double slope = 2 * alpha * root + p;
+        if (f == 0 || slope == 0) break;
+
+        double step = f / slope;
+        root -= step;
+        ret.iterations++;
+        if (std::abs(step) <= 1e-15 * std::max(1.0, std::abs(root))) break;
+    }
+
+    ret.tc     = root;
+    ret.status = ndt::TcEstimate::Converged;
+    return ret;
+}
+
+} // namespace
+
+ndt::TcEstimate ndt::solve_tc_from_Est_E2(double A, double B, const std::vector<double>& params,
+                                          double mu_ce1, double mu_ce2,
+                                          double mu_pe1, double mu_pe2,
+                                          double tp, double tc_est_initial) {
+    return solveTc(makeTcModel(params, mu_ce1, mu_ce2, mu_pe1, mu_pe2, tp, tc_est_initial), A, B);
+}
+
+double ndt::estimate_tc_from_Est_E2(double A, double B, const std::vector<double>& params,
+                               double mu_ce1, double mu_ce2,
+                               double mu_pe1, double mu_pe2,
+                               double tp, double tc_est_initial) {
+    auto ret = solve_tc_from_Est_E2(A, B, params, mu_ce1, mu_ce2, mu_pe1, mu_pe2, tp, tc_est_initial);
+    if (ret.status == TcEstimate::NotConverged) {
+        nucare::logW() << "tc_est does not converge for A =" << A << ", B =" << B;
+    }
+    return ret.tc;
+}
+
+void ndt::solve_tc_from_Est_E2(const double* A, const double* B, size_t n, const std::vector<double>& params,
+                               double mu_ce1, double mu_ce2,
+                               double mu_pe1, double mu_pe2,
+                               double tp, double tc_est_initial, TcEstimate* out) {
+    auto model = makeTcModel(params, mu_ce1, mu_ce2, mu_pe1, mu_pe2, tp, tc_est_initial);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = solveTc(model, A[i], B[i]);
+    }
 }
@@ -8,18 +8,41 @@
 namespace ndt {
 
 /**
- * @brief Calculates the mass attenuation coefficient for Iron.
+ * @brief Calculates the mass attenuation coefficient of a material, interpolated log-log from the NIST
+ * table of the material. Results are cached per thread by material and energy.
  * @param En Photon energy in KeV.
  * @return Mass attenuation coefficient in cm2/g.
- * @throws std::out_of_range if En is outside the known data range.
+ * @throws NcException if En is outside the table of the material.
  */
+double Mass_Attenuation_coefficient(const Energy En, const Material material);
+
+// Former name of Mass_Attenuation_coefficient(), which handles every material
 double Mass_Attenuation_coefficient_Iron(const Energy En, const Material material);
 
 /**
- * @brief Estimates tc_est iteratively based on given parameters and mu values.
+ * @brief Result of the tc_est estimation, see solve_tc_from_Est_E2().
+ */
+struct TcEstimate {
+    enum Status {
+        Converged,    // tc is the value the fixed point iteration converges to
+        NotConverged, // The iteration from tc_est_initial diverges or has no real fixed point, tc is NaN
+        InvalidInput  // mu_ce1 and mu_ce2 are both ~0, tc is tc_est_initial
+    };
+
+    double tc      = 0;
+    Status status  = InvalidInput;
+    int iterations = 0; // Newton steps refining the closed form root
+};
+
+/**
+ * @brief Estimates tc_est based on given parameters and mu values.
  *
- * This function performs an iterative calculation to refine the estimate of tc_est.
- * It uses a linear update rule derived from the provided input parameters.
+ * The update rule tc_new = (mu_ce1 * (k1(tc) * A - mu_pe1 * tp) + mu_ce2 * (B - mu_pe2 * tp)) / (mu_ce1^2 + mu_ce2^2),
+ * with k1 the quadratic of params, is a quadratic in tc, so its fixed points are the roots of a quadratic.
+ * The root the iteration from tc_est_initial converges to is taken in closed form, then refined by Newton.
+ * The iteration stopped on a step below 1e-6, not at that distance to the root: its value was up to
+ * 1e-6 / (1 - |g'|) short of it, g' the slope of the update at the root. Up to 1e-5 relative where
+ * the update is flat, see tools/bench/tc_check.cpp.
  *
  * @param A A double value used in the numerator calculation.
  * @param B A double value used in the numerator calculation.
@@ -30,14 +53,33 @@ double Mass_Attenuation_coefficient_Iron(const Energy En, const Material materia
  * @param mu_pe1 A double value for mu_pe1.
  * @param mu_pe2 A double value for mu_pe2.
  * @param tp A double value for tp.
- * @param tc_est_initial The initial estimate for tc_est. It will be updated iteratively.
- * @return The refined estimate of tc_est after iteration, or the initial value if conditions are met.
+ * @param tc_est_initial Start of the iteration, clamped to 0 and above.
+ * @throws NcException if params has less than 3 elements.
+ */
+TcEstimate solve_tc_from_Est_E2(double A, double B, const std::vector<double>& params,
+                                double mu_ce1, double mu_ce2,
+                                double mu_pe1, double mu_pe2,
+                                double tp, double tc_est_initial);
+
+/**
+ * @brief Same as solve_tc_from_Est_E2(), returning only the estimate. NaN and a warning when it does
+ * not converge.
  */
 double estimate_tc_from_Est_E2(double A, double B, const std::vector<double>& params,
                                double mu_ce1, double mu_ce2,
                                double mu_pe1, double mu_pe2,
                                double tp, double tc_est_initial);
 
+/**
+ * @brief solve_tc_from_Est_E2() of the pairs (A[i], B[i]), i < n, sharing every other input. The terms
+ * not depending on A and B are computed once, for reprocessing recorded events or uncertainty sweeps.
+ * @param out Receives n results
+ */
+void solve_tc_from_Est_E2(const double* A, const double* B, size_t n, const std::vector<double>& params,
+                          double mu_ce1, double mu_ce2,
+                          double mu_pe1, double mu_pe2,
+                          double tp, double tc_est_initial, TcEstimate* out);
+
 }
 
 #endif // NDT_UTIL_H